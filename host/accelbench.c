@@ -0,0 +1,270 @@
+/*
+ * Morpheuz Sleep Monitor
+ *
+ * Copyright (c) 2013-2016 James Fowler
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/*
+ * Accelerometer batch kernel check and micro-benchmark. accel_batch_deviation in morpheuz.c
+ * is compared against the original two pass average-then-deviation code (kept here as the
+ * reference, run over the samples the vibration mask leaves) over random batches, and its
+ * activity and variance features against a plain two pass version of each. Then they are timed -
+ * the two pass deviation alone, the two pass deviation with the features worked out after it as
+ * above (the same results the single pass gives) and the single pass.
+ *
+ *   accelbench [batches]     (default 1000000)
+ *
+ * The watch app is built for size, so CFLAGS="-std=gnu99 -Os -g -Wall" is the closer comparison.
+ *
+ * Exits 1 if any batch differs.
+ */
+
+#include <time.h>
+
+#include "pebble_host.h"
+
+#define main host_app_main
+#include "morpheuz.h"
+#undef main
+
+#define BATCH 25
+#define POOL 1024
+
+/*
+ * Reference - accel_data_handler's arithmetic as it was
+ */
+static uint16_t ref_scale_accel(int16_t val) {
+  int16_t retval = 4000 + val;
+  if (retval < 0)
+    retval = 0;
+  return retval;
+}
+
+static void ref_do_axis(int16_t val, uint16_t *biggest, uint32_t avg) {
+  uint16_t val_scale = ref_scale_accel(val);
+  if (val_scale < avg)
+    val_scale = avg - val_scale;
+  else
+    val_scale -= avg;
+  if (val_scale > *biggest)
+    *biggest = val_scale;
+}
+
+static bool ref_deviation(AccelData *data, uint32_t num_samples, uint16_t *biggest) {
+  uint32_t avg_x = 0;
+  uint32_t avg_y = 0;
+  uint32_t avg_z = 0;
+  AccelData *dx = data;
+  for (uint32_t i = 0; i < num_samples; i++, dx++) {
+    if (dx->did_vibrate) {
+      return false;
+    }
+    avg_x += ref_scale_accel(dx->x);
+    avg_y += ref_scale_accel(dx->y);
+    avg_z += ref_scale_accel(dx->z);
+  }
+
+  avg_x /= num_samples;
+  avg_y /= num_samples;
+  avg_z /= num_samples;
+
+  *biggest = 0;
+  AccelData *d = data;
+  for (uint32_t i = 0; i < num_samples; i++, d++) {
+    ref_do_axis(d->x, biggest, avg_x);
+    ref_do_axis(d->y, biggest, avg_y);
+    ref_do_axis(d->z, biggest, avg_z);
+  }
+  return true;
+}
+
+/*
+ * Reference vibration mask - a vibrating sample and the VIBE_GUARD_SAMPLES after it are out,
+ * with the guard carried from batch to batch
+ */
+static uint32_t ref_mask(AccelData *data, uint32_t n, uint8_t *guard, bool *clean) {
+  uint32_t masked = 0;
+  for (uint32_t i = 0; i < n; i++) {
+    if (data[i].did_vibrate) {
+      *guard = VIBE_GUARD_SAMPLES;
+      clean[i] = false;
+    } else if (*guard > 0) {
+      (*guard)--;
+      clean[i] = false;
+    } else {
+      clean[i] = true;
+    }
+    masked += !clean[i];
+  }
+  return masked;
+}
+
+/*
+ * Reference features - sample to sample change over the floor between neighbouring clean
+ * samples, and variance of the kept samples as the mean squared distance from the average worked
+ * out in exact arithmetic
+ */
+static void ref_features(AccelData *data, uint32_t n, bool *clean, AccelData *kept, uint32_t n_kept, BatchFeatures *features) {
+  features->activity = 0;
+  for (uint32_t i = 1; i < n; i++) {
+    if (!clean[i] || !clean[i - 1])
+      continue;
+    int32_t change = abs(ref_scale_accel(data[i].x) - ref_scale_accel(data[i - 1].x)) + abs(ref_scale_accel(data[i].y) - ref_scale_accel(data[i - 1].y))
+                     + abs(ref_scale_accel(data[i].z) - ref_scale_accel(data[i - 1].z));
+    if (change > ACTIVITY_NOISE_FLOOR)
+      features->activity += change - ACTIVITY_NOISE_FLOOR;
+  }
+  features->variance = 0;
+  for (uint8_t axis = 0; axis < 3; axis++) {
+    int64_t sum = 0;
+    for (uint32_t i = 0; i < n_kept; i++)
+      sum += ref_scale_accel(axis == 0 ? kept[i].x : axis == 1 ? kept[i].y : kept[i].z);
+    // sum of (n * value - sum)^2 is n^3 times the variance
+    uint64_t squares = 0;
+    for (uint32_t i = 0; i < n_kept; i++) {
+      int64_t d = (int64_t) n_kept * ref_scale_accel(axis == 0 ? kept[i].x : axis == 1 ? kept[i].y : kept[i].z) - sum;
+      squares += d * d;
+    }
+    features->variance += squares / ((uint64_t) n_kept * n_kept * n_kept);
+  }
+}
+
+static uint32_t seed = 1;
+
+static uint32_t next_random() {
+  seed = seed * 1103515245 + 12345;
+  return seed >> 8;
+}
+
+/*
+ * Mix of batches: still on the table, moving on the wrist, anything an int16 can hold
+ * (which exercises the clamp and wrap in scale_accel), and the odd vibration
+ */
+static void random_batch(AccelData *data, uint32_t n) {
+  uint32_t kind = next_random() % 4;
+  int16_t spread = kind == 0 ? 8 : 2000;
+  for (uint32_t i = 0; i < n; i++) {
+    if (kind == 2) {
+      data[i].x = (int16_t) next_random();
+      data[i].y = (int16_t) next_random();
+      data[i].z = (int16_t) next_random();
+    } else {
+      data[i].x = (int16_t) (next_random() % (2 * spread + 1)) - spread;
+      data[i].y = (int16_t) (next_random() % (2 * spread + 1)) - spread;
+      data[i].z = -1000 + (int16_t) (next_random() % (2 * spread + 1)) - spread;
+    }
+    data[i].did_vibrate = kind == 3 && next_random() % 50 == 0;
+    data[i].timestamp = i * 100;
+  }
+}
+
+static double now_seconds() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int main(int argc, char *argv[]) {
+  uint32_t batches = argc > 1 ? strtoul(argv[1], NULL, 10) : 1000000;
+  AccelData batch[BATCH];
+  AccelData kept[BATCH];
+  bool clean[BATCH];
+  uint8_t expected_guard = 0;
+  uint8_t actual_guard = 0;
+  uint32_t mismatches = 0;
+  uint32_t masked = 0;
+
+  // Equivalence - every batch length the service can deliver
+  for (uint32_t b = 0; b < batches; b++) {
+    uint32_t n = 1 + b % BATCH;
+    uint16_t expected = 0xDEAD;
+    uint16_t actual = 0xDEAD;
+    BatchFeatures expected_features;
+    BatchFeatures actual_features;
+    random_batch(batch, n);
+    uint32_t expected_masked = ref_mask(batch, n, &expected_guard, clean);
+    uint32_t n_kept = 0;
+    for (uint32_t i = 0; i < n; i++) {
+      if (clean[i])
+        kept[n_kept++] = batch[i];
+    }
+    bool expected_ok = n_kept >= VIBE_MIN_CLEAN_SAMPLES && ref_deviation(kept, n_kept, &expected);
+    bool actual_ok = accel_batch_deviation(batch, n, &actual_guard, &actual, &actual_features);
+    masked += actual_features.masked;
+    if (expected_masked != actual_features.masked || expected_guard != actual_guard) {
+      if (mismatches++ < 10)
+        printf("mismatch batch %u n %u: masked %u guard %u expected %u/%u\n", b, n, actual_features.masked, actual_guard,
+               expected_masked, expected_guard);
+    } else if (expected_ok != actual_ok || (expected_ok && expected != actual)) {
+      if (mismatches++ < 10)
+        printf("mismatch batch %u n %u: expected %d/%u got %d/%u\n", b, n, expected_ok, expected, actual_ok, actual);
+    } else if (expected_ok) {
+      ref_features(batch, n, clean, kept, n_kept, &expected_features);
+      if (expected_features.activity != actual_features.activity || expected_features.variance != actual_features.variance) {
+        if (mismatches++ < 10)
+          printf("mismatch batch %u n %u: features expected %u/%u got %u/%u\n", b, n, expected_features.activity,
+                 expected_features.variance, actual_features.activity, actual_features.variance);
+      }
+    }
+  }
+  printf("equivalence: %u batches, %u mismatches (%u samples masked)\n", batches, mismatches, masked);
+
+  // Timing - a pool of full batches so it isn't all in one cache line
+  static AccelData pool[POOL][BATCH];
+  for (uint32_t p = 0; p < POOL; p++) {
+    random_batch(pool[p], BATCH);
+    for (uint32_t i = 0; i < BATCH; i++) {
+      pool[p][i].did_vibrate = false;
+    }
+  }
+  volatile uint32_t sink = 0;
+  uint16_t biggest;
+  BatchFeatures features;
+  uint8_t guard = 0;
+
+  double start = now_seconds();
+  for (uint32_t b = 0; b < batches; b++) {
+    ref_deviation(pool[b % POOL], BATCH, &biggest);
+    sink += biggest;
+  }
+  double ref_time = now_seconds() - start;
+
+  static bool all_clean[BATCH] = { [0 ... BATCH - 1] = true };
+  start = now_seconds();
+  for (uint32_t b = 0; b < batches; b++) {
+    ref_deviation(pool[b % POOL], BATCH, &biggest);
+    ref_features(pool[b % POOL], BATCH, all_clean, pool[b % POOL], BATCH, &features);
+    sink += biggest + features.variance;
+  }
+  double ref_features_time = now_seconds() - start;
+
+  start = now_seconds();
+  for (uint32_t b = 0; b < batches; b++) {
+    accel_batch_deviation(pool[b % POOL], BATCH, &guard, &biggest, &features);
+    sink += biggest;
+  }
+  double new_time = now_seconds() - start;
+
+  printf("two pass:            %.1f ns/batch\n", ref_time * 1e9 / batches);
+  printf("two pass + features: %.1f ns/batch\n", ref_features_time * 1e9 / batches);
+  printf("single pass:         %.1f ns/batch\n", new_time * 1e9 / batches);
+  return mismatches == 0 ? 0 : 1;
+}
@@ -0,0 +1,165 @@
+/*
+ * Morpheuz Sleep Monitor
+ *
+ * Copyright (c) 2013-2016 James Fowler
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/*
+ * Smart alarm statistics check. Runs generated nights through server_processing a minute at a
+ * time - with ignored segments, the clock going back and gaps - and after every minute compares
+ * the running sleep statistics and smart alarm threshold with a scan of all the points, which is
+ * how smart_alarm used to work them out.
+ *
+ *   alarmcheck [nights]     (default 200)
+ *
+ * Exits 1 if anything differs.
+ */
+
+#include "pebble_host.h"
+
+#define main host_app_main
+#include "morpheuz.h"
+#undef main
+
+#define START 1476657000
+
+static uint32_t seed = 1;
+static uint32_t nights;
+static uint32_t minutes;
+static uint32_t mismatches;
+
+static uint32_t next_random() {
+  seed = seed * 1103515245 + 12345;
+  return seed >> 8;
+}
+
+/*
+ * Average from every point up to and including highest_entry
+ */
+static int32_t scan_threshold(InternalData *data) {
+  bool sleeping = false;
+  int32_t total = 0;
+  int32_t novals = 0;
+  for (uint8_t i = 0; i <= data->highest_entry; i++) {
+    if (!get_ignore(data->ignore, i)) {
+      uint16_t value = get_point(data->points, i);
+      if (!sleeping && value <= AWAKE_ABOVE && i < data->highest_entry) {
+        sleeping = true;
+      }
+      if (sleeping) {
+        novals++;
+        total += value;
+      }
+    }
+  }
+  return novals > 0 ? total / novals : 0;
+}
+
+/*
+ * Statistics over the completed segments
+ */
+static void scan_stats(InternalData *data, SleepStats *stats) {
+  memset(stats, 0, sizeof(SleepStats));
+  for (uint8_t i = 0; i < data->highest_entry; i++) {
+    stats->completed++;
+    if (get_ignore(data->ignore, i)) {
+      continue;
+    }
+    uint16_t value = get_point(data->points, i);
+    if (!stats->sleeping && value <= AWAKE_ABOVE) {
+      stats->sleeping = true;
+      stats->onset = i;
+    }
+    if (stats->sleeping) {
+      stats->total += value;
+      stats->count++;
+    }
+  }
+}
+
+static void compare(uint32_t night, uint32_t minute) {
+  SleepStats expected;
+  SleepStats *actual = get_sleep_stats();
+  InternalData *data = get_internal_data();
+  scan_stats(data, &expected);
+  int32_t threshold = scan_threshold(data);
+  if (actual->completed != expected.completed || actual->sleeping != expected.sleeping || actual->onset != expected.onset
+      || actual->total != expected.total || actual->count != expected.count || smart_alarm_threshold() != threshold) {
+    if (mismatches++ < 10)
+      printf("night %u minute %u: threshold %d expected %d, completed %u expected %u\n", night, minute,
+             smart_alarm_threshold(), threshold, actual->completed, expected.completed);
+  }
+}
+
+/*
+ * Runs inside app_event_loop. The clock is moved with host_clock_set so none of the app's own
+ * timers or accelerometer batches run - every point comes from here.
+ */
+static void check_loop() {
+  for (uint32_t n = 0; n < nights; n++) {
+    time_t now = START + n * TWENTY_FOUR_HOURS_IN_SECONDS;
+    host_clock_set(now);
+    reset_sleep_period();
+    compare(n, 0);
+    uint32_t length = 360 + next_random() % 300;
+    uint32_t restless = 1 + next_random() % 4;
+    for (uint32_t m = 1; m <= length; m++) {
+      uint32_t step = next_random() % 100;
+      if (step == 0) {
+        now -= 60 * (next_random() % 60);
+      } else if (step == 1) {
+        now += 60 * (next_random() % 40);
+      } else {
+        now += 60;
+      }
+      host_clock_set(now);
+      uint32_t kind = next_random() % 10;
+      uint16_t point = kind < restless ? 1000 + next_random() % 3000 : kind < 6 ? next_random() % LIGHT_ABOVE : next_random() % 20;
+      // Ignore is sometimes set before the point, which after the clock goes back is a segment
+      // that has already been completed
+      bool ignore = next_random() % 30 == 0;
+      bool before = next_random() % 2;
+      if (ignore && before) {
+        set_ignore_on_current_time_segment();
+        compare(n, m);
+      }
+      server_processing(point);
+      if (ignore && !before) {
+        set_ignore_on_current_time_segment();
+      }
+      compare(n, m);
+      minutes++;
+    }
+  }
+}
+
+int main(int argc, char *argv[]) {
+  nights = argc > 1 ? strtoul(argv[1], NULL, 10) : 200;
+
+  host_persist_reset();
+  host_set_bluetooth(false);
+  host_clock_set(START);
+  host_set_event_loop(check_loop);
+  host_app_main();
+
+  printf("alarm: %u nights, %u minutes, %u mismatches\n", nights, minutes, mismatches);
+  return mismatches == 0 ? 0 : 1;
+}
@@ -0,0 +1,410 @@
+/*
+ * Morpheuz Sleep Monitor
+ *
+ * Copyright (c) 2013-2016 James Fowler
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/*
+ * Raw capture check. Runs a night on the host shim with raw capture switched on by the phone and
+ * the data logging spool draining at a set rate, then decodes everything delivered and checks it
+ * sample by sample against the source. Each sample is made from its own timestamp, so the source
+ * needs no record of what it handed out. Reports what capture costs an hour and whether it kept up.
+ *
+ *   capturecheck [-H hours] [-S seed] [-r bytes/s] [-b spool bytes] [-o minutes] [-w file]
+ *   capturecheck -d file
+ *
+ *   -H  hours to run (default 10.5)
+ *   -S  seed for the samples (default 1)
+ *   -r  data logging drain rate to the phone in bytes a second (default 1000)
+ *   -b  data logging spool on the watch in bytes (default 65536)
+ *   -o  phone out of range for the first so many minutes
+ *   -w  write the session as delivered, the same as a data logging download
+ *   -d  decode a session downloaded with "pebble data-logging" into a nightsim trace, "ms,x,y,z"
+ *       with ms from the first sample, on stdout
+ *
+ * Exits 1 if a decoded sample differs, the stream is broken, or the gaps and the drop counter
+ * don't agree.
+ */
+
+#include <getopt.h>
+
+#include "pebble_host.h"
+
+#define main host_app_main
+#include "morpheuz.h"
+#undef main
+
+#define MS_PER_MINUTE (60 * 1000)
+#define START "2016-10-16 22:30"
+#define DEFAULT_HOURS 10.5
+#define BATCH_MS (ACCEL_SAMPLES_PER_UPDATE * 100)
+
+typedef void (*SampleHandler)(uint64_t ms, int16_t x, int16_t y, int16_t z, bool did_vibrate, void *context);
+
+static uint32_t seed = 1;
+static uint64_t night_ms;
+static uint32_t away_minutes;
+static const char *write_name;
+
+/*
+ * Repeatable hash of a number
+ */
+static uint32_t mix(uint32_t value) {
+  value ^= seed * 0x9E3779B9;
+  value ^= value >> 16;
+  value *= 0x7FEB352D;
+  value ^= value >> 15;
+  value *= 0x846CA68B;
+  value ^= value >> 16;
+  return value;
+}
+
+/*
+ * The sample at a time - noise while still, now and then a few seconds of turning over, rarely
+ * a vibe. The odd full scale jump makes sure the widest deltas are tried.
+ */
+static void sample_at(uint64_t ms, AccelData *sample) {
+  uint32_t tenth = ms / 100;
+  uint32_t burst = mix(ms / 3000 + 0x10000000);
+  int16_t movement = burst % 100 < 4 ? (int16_t) (burst >> 8) % 2000 : 0;
+  uint32_t noise = mix(tenth);
+  sample->x = (int16_t) (noise % 9) - 4 + movement;
+  sample->y = (int16_t) ((noise >> 8) % 9) - 4 - movement / 2;
+  sample->z = -1000 + (int16_t) ((noise >> 16) % 9) - 4 + movement / 3;
+  if (noise % 5000 == 0) {
+    sample->x = (noise >> 12) & 1 ? INT16_MAX : INT16_MIN;
+  }
+  sample->did_vibrate = mix(tenth / 20 + 0x20000000) % 500 == 0;
+}
+
+static void source(AccelData *data, uint32_t num_samples, void *context) {
+  for (uint32_t i = 0; i < num_samples; i++) {
+    sample_at(data[i].timestamp, &data[i]);
+  }
+}
+
+/*
+ * The phone turns capture on with the version ack, as app.js does with "rawcapture" set
+ */
+static AppMessageResult phone_handler(DictionaryIterator *iter, void *context) {
+  if (dict_find(iter, KEY_VERSION) != NULL) {
+    Tuplet reply[] = { TupletInteger(KEY_CTRL, CTRL_VERSION_DONE | CTRL_LAZARUS | CTRL_RAW_CAPTURE) };
+    host_phone_send_tuplets(reply, 1);
+  }
+  return APP_MSG_OK;
+}
+
+/*
+ * Runs inside app_event_loop - out of range for a while, then the rest of the night
+ */
+static void night_loop() {
+  reset_sleep_period();
+  host_clock_run_until_ms(host_clock_now_ms() + (uint64_t) away_minutes * MS_PER_MINUTE);
+  host_set_bluetooth(true);
+  host_clock_run_until_ms(host_clock_now_ms() + night_ms - (uint64_t) away_minutes * MS_PER_MINUTE);
+  raw_capture_set(false);
+}
+
+/*
+ * Reading a capture stream - the pages of a session without their headers
+ */
+typedef struct {
+  uint8_t *bytes;
+  size_t length;
+  size_t pos;
+} Stream;
+
+static bool get_uint(Stream *stream, uint8_t size, uint32_t *value) {
+  if (stream->pos + size > stream->length)
+    return false;
+  *value = 0;
+  for (uint8_t i = 0; i < size; i++) {
+    *value |= (uint32_t) stream->bytes[stream->pos++] << (i * 8);
+  }
+  return true;
+}
+
+static bool get_delta(Stream *stream, int32_t *delta) {
+  uint32_t value = 0;
+  for (uint8_t shift = 0; shift < 35; shift += 7) {
+    if (stream->pos >= stream->length)
+      return false;
+    uint8_t byte = stream->bytes[stream->pos++];
+    value |= (uint32_t) (byte & 0x7F) << shift;
+    if ((byte & 0x80) == 0) {
+      *delta = (int32_t) (value >> 1) ^ -(int32_t) (value & 1);
+      return true;
+    }
+  }
+  return false;
+}
+
+/*
+ * One capture's records. A record cut short at the end is the capture's last pages not getting
+ * out before it stopped - it is left off and counted.
+ */
+static bool decode_stream(Stream *stream, SampleHandler handler, void *context, uint32_t *cut_short) {
+  uint32_t count, flags, vibrate, seconds, ms, span_ms, x, y, z;
+  AccelData batch[ACCEL_SAMPLES_PER_UPDATE];
+  while (get_uint(stream, sizeof(uint8_t), &count) && count != 0) {
+    if (count > ACCEL_SAMPLES_PER_UPDATE) {
+      fprintf(stderr, "bad record at %zu\n", stream->pos - 1);
+      return false;
+    }
+    vibrate = 0;
+    if (!get_uint(stream, sizeof(uint8_t), &flags) || ((flags & 1) && !get_uint(stream, sizeof(uint32_t), &vibrate))
+        || !get_uint(stream, sizeof(uint32_t), &seconds) || !get_uint(stream, sizeof(uint16_t), &ms)
+        || !get_uint(stream, sizeof(uint16_t), &span_ms) || !get_uint(stream, sizeof(uint16_t), &x)
+        || !get_uint(stream, sizeof(uint16_t), &y) || !get_uint(stream, sizeof(uint16_t), &z)) {
+      (*cut_short)++;
+      return true;
+    }
+    batch[0].x = x;
+    batch[0].y = y;
+    batch[0].z = z;
+    for (uint8_t i = 1; i < count; i++) {
+      int32_t dx, dy, dz;
+      if (!get_delta(stream, &dx) || !get_delta(stream, &dy) || !get_delta(stream, &dz)) {
+        (*cut_short)++;
+        return true;
+      }
+      batch[i].x = batch[i - 1].x + dx;
+      batch[i].y = batch[i - 1].y + dy;
+      batch[i].z = batch[i - 1].z + dz;
+    }
+    uint64_t first_ms = (uint64_t) seconds * 1000 + ms;
+    for (uint8_t i = 0; i < count; i++) {
+      uint64_t at_ms = first_ms + (count > 1 ? (uint64_t) span_ms * i / (count - 1) : 0);
+      handler(at_ms, batch[i].x, batch[i].y, batch[i].z, (vibrate >> i) & 1, context);
+    }
+  }
+  return true;
+}
+
+/*
+ * Decode a session's pages, handing each sample on. Each time the sequence starts again at 0 a
+ * new capture begins. Returns pages decoded or -1 if broken.
+ */
+static int32_t decode(const uint8_t *bytes, size_t length, SampleHandler handler, void *context, uint16_t *dropped,
+                      uint32_t *cut_short) {
+  if (length % RAW_PAGE_SIZE != 0) {
+    fprintf(stderr, "session is %zu bytes, not whole pages\n", length);
+    return -1;
+  }
+  int32_t pages = length / RAW_PAGE_SIZE;
+  Stream stream;
+  memset(&stream, 0, sizeof(stream));
+  stream.bytes = malloc(length + 1);
+  uint32_t expected_seq = 0;
+  bool ok = true;
+  for (int32_t p = 0; p <= pages && ok; p++) {
+    const uint8_t *page = bytes + (size_t) p * RAW_PAGE_SIZE;
+    uint32_t seq = p < pages ? page[0] | (page[1] << 8) : 0;
+    if (p > 0 && seq == 0) {
+      ok = decode_stream(&stream, handler, context, cut_short);
+      stream.length = 0;
+      stream.pos = 0;
+    } else if (seq != expected_seq) {
+      fprintf(stderr, "page %d seq %u expected %u\n", p, seq, expected_seq);
+      ok = false;
+    }
+    if (p < pages) {
+      *dropped = page[2] | (page[3] << 8);
+      memcpy(stream.bytes + stream.length, page + 4, RAW_PAGE_SIZE - 4);
+      stream.length += RAW_PAGE_SIZE - 4;
+      expected_seq = seq + 1;
+    }
+  }
+  free(stream.bytes);
+  return ok ? pages : -1;
+}
+
+/*
+ * Check against the source - batches are whole so a gap in time is a dropped batch. Samples the
+ * shim flags for the app's own vibes are counted rather than failed.
+ */
+typedef struct {
+  uint64_t first_ms;
+  uint64_t last_ms;
+  uint32_t samples;
+  uint32_t mismatches;
+  uint32_t gap_batches;
+  uint32_t app_vibes;
+} CheckState;
+
+static void check_sample(uint64_t ms, int16_t x, int16_t y, int16_t z, bool did_vibrate, void *context) {
+  CheckState *state = context;
+  AccelData expected;
+  sample_at(ms, &expected);
+  if (did_vibrate && !expected.did_vibrate) {
+    state->app_vibes++;
+    expected.did_vibrate = true;
+  }
+  if (x != expected.x || y != expected.y || z != expected.z || did_vibrate != expected.did_vibrate) {
+    if (state->mismatches++ < 10)
+      printf("sample at %llu: %d,%d,%d,%d expected %d,%d,%d,%d\n", (unsigned long long) ms, x, y, z, did_vibrate, expected.x,
+             expected.y, expected.z, expected.did_vibrate);
+  }
+  if (state->samples == 0) {
+    state->first_ms = ms;
+  } else if (ms <= state->last_ms) {
+    if (state->mismatches++ < 10)
+      printf("sample at %llu out of order\n", (unsigned long long) ms);
+  } else if (ms - state->last_ms > BATCH_MS / ACCEL_SAMPLES_PER_UPDATE) {
+    state->gap_batches += (ms - state->last_ms) / BATCH_MS;
+  }
+  state->last_ms = ms;
+  state->samples++;
+}
+
+/*
+ * Trace output, offsets from the first sample
+ */
+static void print_sample(uint64_t ms, int16_t x, int16_t y, int16_t z, bool did_vibrate, void *context) {
+  uint64_t *first_ms = context;
+  if (*first_ms == 0)
+    *first_ms = ms;
+  printf("%llu,%d,%d,%d\n", (unsigned long long) (ms - *first_ms), x, y, z);
+}
+
+static int decode_file(const char *name) {
+  FILE *f = fopen(name, "rb");
+  if (f == NULL) {
+    perror(name);
+    return 1;
+  }
+  uint8_t *bytes = NULL;
+  size_t length = 0;
+  size_t got;
+  uint8_t buffer[4096];
+  while ((got = fread(buffer, 1, sizeof(buffer), f)) > 0) {
+    bytes = realloc(bytes, length + got);
+    memcpy(bytes + length, buffer, got);
+    length += got;
+  }
+  fclose(f);
+  uint64_t first_ms = 0;
+  uint16_t dropped = 0;
+  uint32_t cut_short = 0;
+  int32_t pages = decode(bytes, length, print_sample, &first_ms, &dropped, &cut_short);
+  free(bytes);
+  if (pages < 0)
+    return 1;
+  fprintf(stderr, "%d pages, %u batches dropped, %u cut short\n", pages, dropped, cut_short);
+  return 0;
+}
+
+static void usage() {
+  fprintf(stderr, "usage: capturecheck [-H hours] [-S seed] [-r bytes/s] [-b spool bytes] [-o minutes] [-w file] | -d file\n");
+  exit(2);
+}
+
+int main(int argc, char *argv[]) {
+  double hours = DEFAULT_HOURS;
+  uint32_t drain_rate = 1000;
+  uint32_t spool_bytes = 64 * 1024;
+  int opt;
+
+  while ((opt = getopt(argc, argv, "H:S:r:b:o:w:d:")) != -1) {
+    switch (opt) {
+      case 'H':
+        hours = atof(optarg);
+        break;
+      case 'S':
+        seed = strtoul(optarg, NULL, 10);
+        break;
+      case 'r':
+        drain_rate = strtoul(optarg, NULL, 10);
+        break;
+      case 'b':
+        spool_bytes = strtoul(optarg, NULL, 10);
+        break;
+      case 'o':
+        away_minutes = strtoul(optarg, NULL, 10);
+        break;
+      case 'w':
+        write_name = optarg;
+        break;
+      case 'd':
+        return decode_file(optarg);
+      default:
+        usage();
+    }
+  }
+
+  setenv("TZ", "UTC", 1);
+  tzset();
+  struct tm tm_start;
+  memset(&tm_start, 0, sizeof(tm_start));
+  sscanf(START, "%d-%d-%d %d:%d", &tm_start.tm_year, &tm_start.tm_mon, &tm_start.tm_mday, &tm_start.tm_hour, &tm_start.tm_min);
+  tm_start.tm_year -= 1900;
+  tm_start.tm_mon -= 1;
+
+  #ifndef ENABLE_RAW_CAPTURE
+  printf("no raw capture on this platform\n");
+  return 0;
+  #endif
+
+  night_ms = (uint64_t) (hours * 60 * MS_PER_MINUTE);
+  if ((uint64_t) away_minutes * MS_PER_MINUTE > night_ms)
+    usage();
+  host_clock_set(mktime(&tm_start));
+  host_accel_set_source(source, NULL);
+  host_data_logging_set_spool(spool_bytes, drain_rate);
+  host_set_bluetooth(away_minutes == 0);
+  host_phone_set_handler(phone_handler, NULL);
+  host_set_event_loop(night_loop);
+  host_stats_reset();
+
+  host_app_main();
+
+  size_t length;
+  const uint8_t *bytes = host_data_logging_bytes(RAW_CAPTURE_TAG, &length);
+  if (write_name != NULL) {
+    FILE *f = fopen(write_name, "wb");
+    if (f == NULL || fwrite(bytes, 1, length, f) != length) {
+      perror(write_name);
+      return 1;
+    }
+    fclose(f);
+  }
+  CheckState state;
+  memset(&state, 0, sizeof(state));
+  uint16_t last_page_dropped = 0;
+  uint32_t cut_short = 0;
+  int32_t pages = decode(bytes, length, check_sample, &state, &last_page_dropped, &cut_short);
+  if (pages < 0)
+    return 1;
+
+  uint32_t dropped = raw_capture_dropped();
+  double captured_hours = (state.last_ms - state.first_ms) / (60.0 * MS_PER_MINUTE);
+  printf("accel batches %u samples %u\n", host_stats.accel_batches, host_stats.accel_samples);
+  printf("captured %u samples in %d pages (%zu bytes, %.2f bytes a sample, %.0f bytes an hour)\n", state.samples, pages, length,
+         state.samples > 0 ? (double) length / state.samples : 0, captured_hours > 0 ? length / captured_hours : 0);
+  uint64_t lost = host_clock_now_ms() > state.last_ms + BATCH_MS ? (host_clock_now_ms() - state.last_ms) / BATCH_MS : 0;
+  printf("data logging full %u, spool max %u of %u, batches dropped %u (gaps %u), lost at the end %llu (cut short %u)\n",
+         host_stats.dlog_full, host_stats.dlog_spool_max, spool_bytes, dropped, state.gap_batches,
+         (unsigned long long) lost, cut_short);
+  printf("samples vibrating %u for the app's vibes, mismatches %u\n", state.app_vibes, state.mismatches);
+
+  // Batches dropped at the very end leave no gap to see
+  return state.mismatches != 0 || state.samples == 0 || state.gap_batches > dropped || (lost == 0 && state.gap_batches != dropped) ? 1 : 0;
+}
@@ -0,0 +1,112 @@
+/*
+ * Morpheuz Sleep Monitor
+ *
+ * Copyright (c) 2013-2016 James Fowler
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/*
+ * Dial table check and micro-benchmark. Every point in dial_tables.h is compared with what
+ * draw_marks in analogue.c works out with sin_lookup/cos_lookup for the same position and ring
+ * (kept here as the reference), then both are timed over the minute marks.
+ *
+ *   dialcheck [rounds]     (default 100000)
+ *
+ * Exits 1 if any point differs - regenerate with gen_dial_tables.py if analogue.h has changed.
+ */
+
+#include <time.h>
+
+#include "pebble_host.h"
+
+#define main host_app_main
+#include "morpheuz.h"
+#undef main
+#include "analogue.h"
+#include "dial_tables.h"
+
+#define DIAL_SIZE 144
+#define POSITIONS (1440 / DIAL_STEP)
+
+static const int dial_ring_inset[DIAL_RINGS] = { MIN, HOUR, CLOCK };
+
+/*
+ * Reference - draw_marks' arithmetic for one end of a mark
+ */
+static GPoint ref_point(GPoint center, int inset, int i) {
+  const int16_t pixels = DIAL_SIZE / 2 - inset;
+  int32_t second_angle = (TRIG_MAX_ANGLE * i / 1440);
+  int32_t minus_cos = -cos_lookup(second_angle);
+  int32_t plus_sin = sin_lookup(second_angle);
+  GPoint point;
+  point.y = (int16_t) (minus_cos * (int32_t) pixels / TRIG_MAX_RATIO) + center.y;
+  point.x = (int16_t) (plus_sin * (int32_t) pixels / TRIG_MAX_RATIO) + center.x;
+  return point;
+}
+
+static double now_seconds() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int main(int argc, char *argv[]) {
+  uint32_t rounds = argc > 1 ? strtoul(argv[1], NULL, 10) : 100000;
+  const GPoint center = GPoint(DIAL_SIZE / 2, DIAL_SIZE / 2);
+  uint32_t mismatches = 0;
+
+  for (uint8_t ring = 0; ring < DIAL_RINGS; ring++) {
+    for (uint8_t position = 0; position < POSITIONS; position++) {
+      GPoint expected = ref_point(center, dial_ring_inset[ring], position * DIAL_STEP);
+      GPoint actual = dial_point(center, ring, position);
+      if (expected.x != actual.x || expected.y != actual.y) {
+        if (mismatches++ < 10)
+          printf("mismatch ring %u position %u: expected %d,%d got %d,%d\n", ring, position, expected.x, expected.y, actual.x, actual.y);
+      }
+    }
+  }
+  printf("equivalence: %u points, %u mismatches\n", DIAL_RINGS * POSITIONS, mismatches);
+
+  // Timing - the minute marks, both ends, as the dial draws them
+  volatile int32_t sink = 0;
+  double start = now_seconds();
+  for (uint32_t r = 0; r < rounds; r++) {
+    for (int i = 0; i < 1440; i += MINUTE_STEP) {
+      GPoint inner = ref_point(center, MIN, i);
+      GPoint outer = ref_point(center, CLOCK, i);
+      sink += inner.x + outer.y;
+    }
+  }
+  double ref_time = now_seconds() - start;
+
+  start = now_seconds();
+  for (uint32_t r = 0; r < rounds; r++) {
+    for (int i = 0; i < 1440; i += MINUTE_STEP) {
+      GPoint inner = dial_point(center, DIAL_RING_MIN, i / DIAL_STEP);
+      GPoint outer = dial_point(center, DIAL_RING_CLOCK, i / DIAL_STEP);
+      sink += inner.x + outer.y;
+    }
+  }
+  double table_time = now_seconds() - start;
+
+  printf("trig:  %.1f ns/dial\n", ref_time * 1e9 / rounds);
+  printf("table: %.1f ns/dial\n", table_time * 1e9 / rounds);
+  return mismatches == 0 ? 0 : 1;
+}
@@ -0,0 +1,69 @@
+#!/usr/bin/env python
+#
+# Morpheuz Sleep Monitor
+#
+# Generates the headers the Pebble SDK would normally build from package.json
+# (message keys, resource ids and app info) so src/*.c compiles on the host.
+#
+# Usage: gen_auto.py <package.json> <resources dir> <platform> <output dir>
+#
+
+import json
+import os
+import sys
+
+
+def main():
+    package_json, resources_dir, platform, out_dir = sys.argv[1:5]
+
+    with open(package_json) as f:
+        package = json.load(f)
+    pebble = package['pebble']
+
+    if not os.path.isdir(out_dir):
+        os.makedirs(out_dir)
+
+    # Message keys - the SDK numbers these from 10000 in declaration order
+    with open(os.path.join(out_dir, 'message_keys.auto.h'), 'w') as f:
+        f.write('#pragma once\n\n')
+        for i, key in enumerate(pebble['messageKeys']):
+            f.write('#define MESSAGE_KEY_%s %d\n' % (key, 10000 + i))
+
+    # Resources for this platform only, color variants where they exist
+    media = []
+    for res in pebble['resources']['media']:
+        targets = res.get('targetPlatforms')
+        if targets is not None and platform not in targets:
+            continue
+        path = os.path.join(resources_dir, res['file'])
+        if platform != 'aplite':
+            stem, ext = os.path.splitext(path)
+            if os.path.exists(stem + '~color' + ext):
+                path = stem + '~color' + ext
+        media.append((res['name'], os.path.abspath(path)))
+
+    with open(os.path.join(out_dir, 'resource_ids.auto.h'), 'w') as f:
+        f.write('#pragma once\n\n')
+        f.write('typedef enum {\n  INVALID_RESOURCE = 0,\n')
+        for name, _ in media:
+            f.write('  RESOURCE_ID_%s,\n' % name)
+        f.write('} ResourceId;\n')
+
+    version = package['version'].split('.')
+    with open(os.path.join(out_dir, 'app_info.auto.c'), 'w') as f:
+        f.write('#include "pebble.h"\n#include "pebble_process_info.h"\n\n')
+        f.write('const PebbleProcessInfo __pbl_app_info = {\n')
+        f.write('  .header = "PBLAPP",\n')
+        f.write('  .process_version = { %s, %s },\n' % (int(version[0]), int(version[1])))
+        f.write('  .name = "%s",\n' % pebble['displayName'])
+        f.write('  .company = "%s",\n' % package['author'])
+        f.write('};\n\n')
+        f.write('const char *host_resource_files[] = {\n  NULL,\n')
+        for _, path in media:
+            f.write('  "%s",\n' % path)
+        f.write('};\n\n')
+        f.write('const uint32_t host_resource_count = %d;\n' % (len(media) + 1))
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,93 @@
+#!/usr/bin/env python
+#
+# Morpheuz Sleep Monitor
+#
+# Generates src/dial_tables.h - the end points of every mark on the analogue dial that falls
+# on a DIAL_STEP boundary, for each ring radius in analogue.h. Values are exactly what
+# draw_marks would work out at runtime from sin_lookup/cos_lookup (dialcheck confirms it).
+#
+# Usage: gen_dial_tables.py <analogue.h> <dial_tables.h>
+#
+
+import math
+import re
+import sys
+
+POSITIONS = 1440
+DIAL_STEP = 12
+QUADRANT = POSITIONS // DIAL_STEP // 4
+TRIG_MAX_ANGLE = 0x10000
+TRIG_MAX_RATIO = 0xffff
+RINGS = ['MIN', 'HOUR', 'CLOCK']
+
+
+def lround(value):
+    return int(math.floor(abs(value) + 0.5)) * (1 if value >= 0 else -1)
+
+
+def trunc_div(a, b):
+    q = abs(a) // abs(b)
+    return q if (a >= 0) == (b >= 0) else -q
+
+
+def read_defines(header):
+    defines = {}
+    with open(header) as f:
+        for line in f:
+            m = re.match(r'#define\s+(\w+)\s+(.*)$', line.strip())
+            if m:
+                defines[m.group(1)] = m.group(2)
+    return defines
+
+
+def evaluate(name, defines):
+    expr = defines[name]
+    for other in sorted(defines, key=len, reverse=True):
+        if other != name and re.search(r'\b%s\b' % other, expr):
+            expr = re.sub(r'\b%s\b' % other, '(%d)' % evaluate(other, defines), expr)
+    return int(eval(expr))
+
+
+def main():
+    header, out = sys.argv[1:3]
+    defines = read_defines(header)
+    width = int(re.search(r'GRect\(\s*\d+\s*,\s*\d+\s*,\s*(\d+)', defines['ANALOGUE_FINISH']).group(1))
+    furthest_out = width // 2
+
+    rows = []
+    for ring in RINGS:
+        pixels = furthest_out - evaluate(ring, defines)
+        points = []
+        for position in range(QUADRANT):
+            angle = TRIG_MAX_ANGLE * position * DIAL_STEP // POSITIONS
+            minus_cos = -lround(math.cos(2.0 * math.pi * angle / TRIG_MAX_ANGLE) * TRIG_MAX_RATIO)
+            plus_sin = lround(math.sin(2.0 * math.pi * angle / TRIG_MAX_ANGLE) * TRIG_MAX_RATIO)
+            points.append('{ %d, %d }' % (trunc_div(plus_sin * pixels, TRIG_MAX_RATIO), trunc_div(minus_cos * pixels, TRIG_MAX_RATIO)))
+        rows.append('  // %s (%d pixels)\n  { %s }' % (ring, pixels, ', '.join(points)))
+
+    with open(out, 'w') as f:
+        f.write('/*\n')
+        f.write(' * Generated by host/gen_dial_tables.py from analogue.h - do not edit\n')
+        f.write(' *\n')
+        f.write(' * Offsets from the centre of the %dx%d dial for each DIAL_STEP position in the first\n' % (width, width))
+        f.write(' * quarter, for each ring. The other quarters are the same turned through 90 degrees.\n')
+        f.write(' */\n\n')
+        f.write('#ifndef DIAL_TABLES_H_\n#define DIAL_TABLES_H_\n\n')
+        f.write('#define DIAL_STEP %d\n' % DIAL_STEP)
+        f.write('#define DIAL_QUADRANT %d\n\n' % QUADRANT)
+        f.write('enum DialRings {\n%s,\n  DIAL_RINGS\n};\n\n' % ',\n'.join('  DIAL_RING_%s' % ring for ring in RINGS))
+        f.write('static const int8_t dial_table[DIAL_RINGS][DIAL_QUADRANT][2] = {\n%s\n};\n\n' % ',\n'.join(rows))
+        f.write('/*\n * Point on a ring for a position (0 to 1440 / DIAL_STEP - 1, clockwise from 12)\n */\n')
+        f.write('static inline GPoint dial_point(GPoint center, uint8_t ring, uint8_t position) {\n')
+        f.write('  const int8_t *d = dial_table[ring][position % DIAL_QUADRANT];\n')
+        f.write('  switch (position / DIAL_QUADRANT) {\n')
+        f.write('    case 1:\n      return GPoint(center.x - d[1], center.y + d[0]);\n')
+        f.write('    case 2:\n      return GPoint(center.x - d[0], center.y - d[1]);\n')
+        f.write('    case 3:\n      return GPoint(center.x + d[1], center.y - d[0]);\n')
+        f.write('    default:\n      return GPoint(center.x + d[0], center.y + d[1]);\n')
+        f.write('  }\n}\n\n')
+        f.write('#endif /* DIAL_TABLES_H_ */\n')
+
+
+if __name__ == '__main__':
+    main()
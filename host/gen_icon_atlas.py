@@ -0,0 +1,138 @@
+#!/usr/bin/env python
+#
+# Morpheuz Sleep Monitor
+#
+# Generates the status icon atlas - resources/images/status-icons.png (and ~color) with the
+# icon bar icons side by side - and src/icon_atlas.h with where each one sits in it. The
+# separate icon images stay as the source; only the atlas goes into the app.
+#
+# Usage: gen_icon_atlas.py <images dir> <icon_atlas.h>
+#
+
+import os
+import struct
+import sys
+import zlib
+
+# Name in icon_atlas.h, source image (without .png)
+ICONS = [
+    ('BATTERY', 'battery_icon'),
+    ('BATTERY_CHARGE', 'battery_charge'),
+    ('COMMS', 'comms'),
+    ('BLUETOOTH', 'bluetooth'),
+    ('RECORD', 'record'),
+    ('ALARM_RING', 'alarm-ring-icon'),
+    ('ALARM', 'alarm-icon'),
+    ('IGNORE', 'ignore'),
+    ('EXPORT', 'export'),
+]
+ATLAS = 'status-icons'
+
+# Channels for each PNG colour type we can read (8 bit, not paletted)
+CHANNELS = {0: 1, 2: 3, 4: 2, 6: 4}
+
+
+def read_png(path):
+    """RGBA rows of an 8 bit, non-interlaced, non-paletted PNG"""
+    with open(path, 'rb') as f:
+        data = f.read()
+    pos = 8
+    idat = b''
+    while pos < len(data):
+        length, kind = struct.unpack('>I4s', data[pos:pos + 8])
+        body = data[pos + 8:pos + 8 + length]
+        if kind == b'IHDR':
+            width, height, depth, colour, _, _, interlace = struct.unpack('>IIBBBBB', body)
+            if depth != 8 or colour not in CHANNELS or interlace != 0:
+                sys.exit('%s: only 8 bit, non-interlaced grey/RGB(A) images' % path)
+        elif kind == b'IDAT':
+            idat += body
+        pos += 12 + length
+
+    channels = CHANNELS[colour]
+    stride = width * channels
+    raw = zlib.decompress(idat)
+    rows = []
+    previous = bytearray(stride)
+    for y in range(height):
+        kind = raw[y * (stride + 1)]
+        line = bytearray(raw[y * (stride + 1) + 1:(y + 1) * (stride + 1)])
+        for x in range(stride):
+            left = line[x - channels] if x >= channels else 0
+            up = previous[x]
+            corner = previous[x - channels] if x >= channels else 0
+            if kind == 1:
+                line[x] = (line[x] + left) & 0xFF
+            elif kind == 2:
+                line[x] = (line[x] + up) & 0xFF
+            elif kind == 3:
+                line[x] = (line[x] + (left + up) // 2) & 0xFF
+            elif kind == 4:
+                p = left + up - corner
+                pa, pb, pc = abs(p - left), abs(p - up), abs(p - corner)
+                predictor = left if pa <= pb and pa <= pc else (up if pb <= pc else corner)
+                line[x] = (line[x] + predictor) & 0xFF
+        previous = line
+        rgba = bytearray()
+        for x in range(width):
+            pixel = line[x * channels:(x + 1) * channels]
+            if colour == 0:
+                rgba += bytes([pixel[0]] * 3 + [255])
+            elif colour == 2:
+                rgba += pixel + b'\xff'
+            elif colour == 4:
+                rgba += bytes([pixel[0]] * 3 + [pixel[1]])
+            else:
+                rgba += pixel
+        rows.append(rgba)
+    return width, height, rows
+
+
+def write_png(path, width, height, rows):
+    def chunk(kind, body):
+        return struct.pack('>I', len(body)) + kind + body + struct.pack('>I', zlib.crc32(kind + body) & 0xFFFFFFFF)
+
+    raw = b''.join(b'\x00' + bytes(row) for row in rows)
+    with open(path, 'wb') as f:
+        f.write(b'\x89PNG\r\n\x1a\n')
+        f.write(chunk(b'IHDR', struct.pack('>IIBBBBB', width, height, 8, 6, 0, 0, 0)))
+        f.write(chunk(b'IDAT', zlib.compress(raw, 9)))
+        f.write(chunk(b'IEND', b''))
+
+
+def build(images, suffix):
+    icons = [read_png(os.path.join(images, source + suffix + '.png')) for _, source in ICONS]
+    height = max(icon[1] for icon in icons)
+    width = sum(icon[0] for icon in icons)
+    rows = [bytearray() for _ in range(height)]
+    placed = []
+    x = 0
+    for icon_width, icon_height, icon_rows in icons:
+        for y in range(height):
+            rows[y] += icon_rows[y] if y < icon_height else bytearray(icon_width * 4)
+        placed.append((x, icon_width, icon_height))
+        x += icon_width
+    write_png(os.path.join(images, ATLAS + suffix + '.png'), width, height, rows)
+    return placed
+
+
+def main():
+    images, out = sys.argv[1:3]
+    placed = build(images, '')
+    if build(images, '~color') != placed:
+        sys.exit('icon sizes differ between the black and white and colour images')
+
+    with open(out, 'w') as f:
+        f.write('/*\n')
+        f.write(' * Generated by host/gen_icon_atlas.py from the icon images - do not edit\n')
+        f.write(' *\n')
+        f.write(' * Where each status icon sits in RESOURCE_ID_STATUS_ICONS.\n')
+        f.write(' */\n\n')
+        f.write('#ifndef ICON_ATLAS_H_\n#define ICON_ATLAS_H_\n\n')
+        for (name, source), (x, width, height) in zip(ICONS, placed):
+            f.write('#define ATLAS_%s GRect(%d, 0, %d, %d) // %s.png\n' % (name, x, width, height, source))
+        f.write('\n#endif /* ICON_ATLAS_H_ */\n')
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,206 @@
+/*
+ * Morpheuz Sleep Monitor
+ *
+ * Copyright (c) 2013-2016 James Fowler
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/*
+ * History ring check. Stores a run of generated nights through history_store_night as a reset
+ * would, reading every night still in the ring back after each one and comparing it with what
+ * went in. Reports how big the compressed nights are against a ChartData per night.
+ *
+ * Then fills the ring with the hardest nights to compress, saves everything else the app keeps
+ * and totals the store, allowing PERSIST_KEY_OVERHEAD a key for the watch's own record of it.
+ *
+ *   historycheck [nights]     (default 100)
+ *
+ * Exits 1 if any night reads back differently or the worst case doesn't fit in PERSIST_LIMIT.
+ */
+
+#include "pebble_host.h"
+
+#define main host_app_main
+#include "morpheuz.h"
+#undef main
+#include "chart.h"
+
+#ifdef ENABLE_HISTORY
+
+#define PERSIST_LIMIT 4096
+#define PERSIST_KEY_OVERHEAD 12
+#define PRESET_BYTES 40 // PresetData in presets.c
+
+static uint32_t seed = 1;
+
+static uint32_t next_random() {
+  seed = seed * 1103515245 + 12345;
+  return seed >> 8;
+}
+
+/*
+ * Something like a night - mostly still, bursts of movement, the odd ignored segment. Every
+ * tenth night is as hard to compress as it gets.
+ */
+static void random_night(uint32_t n, InternalData *night, ConfigData *config) {
+  memset(night, 0, sizeof(InternalData));
+  night->internal_ver = INTERNAL_VER;
+  night->has_been_reset = true;
+  night->base = 1476657000 + n * TWENTY_FOUR_HOURS_IN_SECONDS;
+  night->highest_entry = 1 + next_random() % (LIMIT - 1);
+  night->gone_off = next_random() % 2 ? next_random() % MINS_IN_DAY : 0;
+  night->snoozes = next_random() % 4;
+  for (uint8_t i = 0; i <= night->highest_entry; i++) {
+    if (n % 10 == 9) {
+      set_point(night->points, i, i % 2 ? 0 : POINT_MAX);
+    } else {
+      uint32_t kind = next_random() % 4;
+      set_point(night->points, i, kind == 0 ? 5 : kind == 1 ? next_random() % LIGHT_ABOVE : next_random() % 3000);
+    }
+    set_ignore(night->ignore, i, next_random() % 20 == 0);
+  }
+  config->smart = next_random() % 2;
+  config->from = next_random() % MINS_IN_DAY;
+  config->to = next_random() % MINS_IN_DAY;
+}
+
+/*
+ * As big as a night gets - every segment recorded, every delta and time two bytes
+ */
+static void worst_night(uint32_t n, InternalData *night, ConfigData *config) {
+  memset(night, 0, sizeof(InternalData));
+  night->internal_ver = INTERNAL_VER;
+  night->has_been_reset = true;
+  night->base = 1476657000 + n * TWENTY_FOUR_HOURS_IN_SECONDS;
+  night->highest_entry = LIMIT - 1;
+  night->gone_off = MINS_IN_DAY - 1;
+  night->snoozes = 9;
+  for (uint8_t i = 0; i <= night->highest_entry; i++) {
+    set_point(night->points, i, i % 2 ? 0 : POINT_MAX);
+    set_ignore(night->ignore, i, i % 3 == 0);
+  }
+  config->smart = true;
+  config->from = MINS_IN_DAY - 2;
+  config->to = MINS_IN_DAY - 1;
+}
+
+/*
+ * The ring full of the worst nights alongside everything else the app keeps - false if it
+ * wouldn't fit
+ */
+static bool worst_case_fits() {
+  host_persist_reset();
+  for (uint32_t n = 0; n < HISTORY_NIGHTS; n++) {
+    worst_night(n, get_internal_data(), get_config_data());
+    history_store_night();
+  }
+  uint16_t history_keys;
+  uint32_t history_bytes = host_persist_used(&history_keys);
+
+  save_internal_data();
+  save_config_data(NULL);
+  store_chart_data();
+  counters_save();
+  for (uint16_t i = 0; i < TRACE_EVENTS; i++) {
+    trace_event(TRACE_RESET, 0, 0);
+  }
+  trace_save();
+  static uint8_t presets[PRESET_BYTES];
+  persist_write_data(PERSIST_PRESET_KEY, presets, sizeof(presets));
+
+  uint16_t keys;
+  uint32_t bytes = host_persist_used(&keys);
+  uint32_t total = bytes + keys * PERSIST_KEY_OVERHEAD;
+  printf("worst case %u nights %u bytes in %u keys, everything else %u bytes in %u keys, total %u of %u\n", HISTORY_NIGHTS,
+         history_bytes, history_keys, bytes - history_bytes, keys - history_keys, total, PERSIST_LIMIT);
+  return total <= PERSIST_LIMIT;
+}
+
+static bool same_night(InternalData *night, ConfigData *config, ChartData *chart) {
+  if (chart->base != night->base || chart->highest_entry != night->highest_entry || chart->gone_off != night->gone_off
+      || chart->snoozes != night->snoozes || chart->smart != config->smart || chart->from != config->from || chart->to != config->to) {
+    return false;
+  }
+  for (uint8_t i = 0; i <= night->highest_entry; i++) {
+    if (get_point(chart->points, i) != get_point(night->points, i) || get_ignore(chart->ignore, i) != get_ignore(night->ignore, i)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+int main(int argc, char *argv[]) {
+  uint32_t nights = argc > 1 ? strtoul(argv[1], NULL, 10) : 100;
+  static InternalData stored[HISTORY_NIGHTS];
+  static ConfigData stored_config[HISTORY_NIGHTS];
+  uint32_t mismatches = 0;
+  uint32_t bytes = 0;
+
+  host_persist_reset();
+  for (uint32_t n = 0; n < nights; n++) {
+    InternalData *night = &stored[n % HISTORY_NIGHTS];
+    ConfigData *config = &stored_config[n % HISTORY_NIGHTS];
+    random_night(n, night, config);
+    *get_internal_data() = *night;
+    *get_config_data() = *config;
+
+    uint32_t before = host_stats.persist_bytes_written;
+    history_store_night();
+    bytes += host_stats.persist_bytes_written - before;
+
+    uint8_t held = n + 1 < HISTORY_NIGHTS ? n + 1 : HISTORY_NIGHTS;
+    if (history_count() != held) {
+      printf("night %u: count %u expected %u\n", n, history_count(), held);
+      mismatches++;
+    }
+    HistoryIndex index;
+    history_read_index(&index);
+    for (uint8_t ago = 0; ago < held; ago++) {
+      uint8_t which = (n - ago) % HISTORY_NIGHTS;
+      ChartData chart;
+      if (history_night_base(&index, ago) != stored[which].base || !history_read_night(&index, ago, &chart)
+          || !same_night(&stored[which], &stored_config[which], &chart)) {
+        if (mismatches++ < 10)
+          printf("night %u: %u nights ago differs\n", n, ago);
+      }
+    }
+    ChartData chart;
+    if (history_read_night(&index, held, &chart) && held < HISTORY_NIGHTS) {
+      printf("night %u: read past the end\n", n);
+      mismatches++;
+    }
+  }
+
+  printf("history: %u nights, %u mismatches\n", nights, mismatches);
+  uint32_t index_bytes = nights * sizeof(HistoryIndex);
+  printf("nights %.1f bytes each (ChartData %u), index %u bytes per store\n", (double) (bytes - index_bytes) / nights,
+         (unsigned) sizeof(ChartData), (unsigned) sizeof(HistoryIndex));
+  bool fits = worst_case_fits();
+  return mismatches == 0 && fits ? 0 : 1;
+}
+
+#else
+
+int main(int argc, char *argv[]) {
+  printf("history: not built on this platform\n");
+  return 0;
+}
+
+#endif
@@ -0,0 +1,51 @@
+/*
+ * Morpheuz Sleep Monitor
+ *
+ * Copyright (c) 2013-2016 James Fowler
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/*
+ * Host stand in for the undocumented SDK app info header (only the fields Morpheuz reads)
+ */
+
+#ifndef PEBBLE_PROCESS_INFO_H_
+#define PEBBLE_PROCESS_INFO_H_
+
+#include <stdint.h>
+
+typedef struct {
+  uint8_t major;
+  uint8_t minor;
+} Version;
+
+typedef struct {
+  char header[8];
+  Version struct_version;
+  Version sdk_version;
+  Version process_version;
+  uint16_t load_size;
+  uint32_t offset;
+  uint32_t crc;
+  char name[32];
+  char company[32];
+} PebbleProcessInfo;
+
+#endif /* PEBBLE_PROCESS_INFO_H_ */
@@ -0,0 +1,670 @@
+/*
+ * Morpheuz Sleep Monitor
+ *
+ * Copyright (c) 2013-2016 James Fowler
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/*
+ * Whole night simulator. Launches the real app on the host shim, resets it for bed at the
+ * start time and plays an accelerometer trace through accel_data_handler on the virtual
+ * clock, with a phone that answers like app.js. A ten hour night takes milliseconds.
+ *
+ *   nightsim [-s start] [-H hours] [-a from-to] [-Q] [-B] [-D] [-A] [-S seed] [-l latency] [-n] [-r HH:MM] [-f pct] [-d pct] [-x] [-T] [-q] [trace]
+ *
+ *   -s  start of night, local time "YYYY-MM-DD HH:MM" (default 2016-10-16 22:30)
+ *   -H  hours to run after the reset (default 10.5)
+ *   -a  smart alarm window "HH:MM-HH:MM" (default off)
+ *   -Q  quick smart alarm - checked on every accelerometer batch, not just each minute
+ *   -B  the phone takes points through data logging (CTRL_BULK), read back at the end of the night
+ *   -D  deferred sync - nothing goes to the phone until the alarm, the end of recording or a wakeup
+ *   -A  analogue face on
+ *   -S  seed for the synthetic night used when no trace is given, and the link (default 1)
+ *   -l  phone link latency in ms (default 50)
+ *   -n  no phone - bluetooth disconnected all night
+ *   -r  phone out of range until local time "HH:MM", then back for the morning sync
+ *   -f  percent of messages NACKed by the link
+ *   -d  percent of messages ACKed by the link but lost before the JS sees them
+ *   -x  quit from the menu at the end rather than being killed
+ *   -T  the phone asks for the event trace at the end and prints it as hex (for tracedecode)
+ *   -q  quiet - don't list every message sent
+ *
+ * Trace files are text, one sample per line: "ms,x,y,z" where ms is the offset from the
+ * reset. Lines starting with # are ignored. Each sample the app asks for gets the trace
+ * sample at or before its timestamp, so a trace of any rate works at any sampling rate.
+ *
+ * Times are local to TZ (UTC if unset) so runs are repeatable.
+ */
+
+#include <getopt.h>
+
+#include "pebble_host.h"
+
+// morpheuz.h declares the app's main, which the host build renames
+#define main host_app_main
+#include "morpheuz.h"
+#undef main
+
+#define MS_PER_MINUTE (60 * 1000)
+#define SETTLE_MS (10 * 1000)
+#define DEFAULT_START "2016-10-16 22:30"
+#define DEFAULT_HOURS 10.5
+#define MAX_LOGGED 4096
+
+typedef struct {
+  uint32_t ms;
+  int16_t x;
+  int16_t y;
+  int16_t z;
+} TraceSample;
+
+typedef struct {
+  uint64_t at_ms;
+  uint32_t key;
+  int32_t value;
+  uint16_t length;
+} LoggedMessage;
+
+static TraceSample *trace;
+static uint32_t trace_count;
+static uint32_t trace_pos;
+static uint64_t reset_ms;
+static uint32_t seed = 1;
+
+static LoggedMessage logged[MAX_LOGGED];
+static uint32_t logged_count;
+
+static uint64_t alarm_ms;
+static uint16_t alarm_gone_off;
+static bool quick_alarm;
+static bool bulk;
+static bool defer_sync;
+static bool quit_at_end;
+static bool dump_trace;
+
+/*
+ * The quick smart alarm can go off between minutes, so look before every batch as well
+ */
+static void note_alarm() {
+  if (alarm_ms == 0 && get_internal_data()->gone_off > 0) {
+    alarm_ms = host_clock_now_ms();
+    alarm_gone_off = get_internal_data()->gone_off;
+  }
+}
+
+/*
+ * Load a trace file
+ */
+static bool load_trace(const char *name) {
+  FILE *f = fopen(name, "r");
+  if (f == NULL) {
+    perror(name);
+    return false;
+  }
+  uint32_t size = 0;
+  char line[128];
+  while (fgets(line, sizeof(line), f) != NULL) {
+    TraceSample s;
+    int ms, x, y, z;
+    if (line[0] == '#' || sscanf(line, "%d,%d,%d,%d", &ms, &x, &y, &z) != 4)
+      continue;
+    s.ms = ms;
+    s.x = x;
+    s.y = y;
+    s.z = z;
+    if (trace_count == size) {
+      size = size == 0 ? 4096 : size * 2;
+      trace = realloc(trace, size * sizeof(TraceSample));
+    }
+    trace[trace_count++] = s;
+  }
+  fclose(f);
+  return true;
+}
+
+/*
+ * Trace replay - samples are asked for in time order so a cursor does
+ */
+static void trace_source(AccelData *data, uint32_t num_samples, void *context) {
+  note_alarm();
+  for (uint32_t i = 0; i < num_samples; i++) {
+    if (reset_ms == 0 || data[i].timestamp < reset_ms) {
+      data[i].z = -1000;
+      continue;
+    }
+    uint64_t offset = data[i].timestamp - reset_ms;
+    while (trace_pos + 1 < trace_count && trace[trace_pos + 1].ms <= offset) {
+      trace_pos++;
+    }
+    if (trace_count == 0 || trace[trace_pos].ms > offset) {
+      data[i].z = -1000;
+      continue;
+    }
+    data[i].x = trace[trace_pos].x;
+    data[i].y = trace[trace_pos].y;
+    data[i].z = trace[trace_pos].z;
+  }
+}
+
+/*
+ * Small repeatable random numbers
+ */
+static uint32_t next_random() {
+  seed = seed * 1103515245 + 12345;
+  return (seed >> 16) & 0x7fff;
+}
+
+/*
+ * Synthetic night - restless for the first half hour, then sleep cycles of around 90
+ * minutes with turning over at the light end of each, sensor noise throughout
+ */
+static void synthetic_source(AccelData *data, uint32_t num_samples, void *context) {
+  note_alarm();
+  for (uint32_t i = 0; i < num_samples; i++) {
+    uint64_t offset = data[i].timestamp > reset_ms ? data[i].timestamp - reset_ms : 0;
+    uint32_t minute = offset / MS_PER_MINUTE;
+    uint32_t in_cycle = minute % 90;
+    uint32_t chance = minute < 30 ? 200 : (in_cycle > 75 ? 40 : 1);
+    int16_t movement = (next_random() % 20000) < chance ? (int16_t) (next_random() % 3000) - 1500 : 0;
+    data[i].x = (int16_t) (next_random() % 7) - 3 + movement;
+    data[i].y = (int16_t) (next_random() % 7) - 3 - movement / 2;
+    data[i].z = -1000 + (int16_t) (next_random() % 7) - 3 + movement / 3;
+  }
+}
+
+/*
+ * Key names for the message log
+ */
+static const char *key_name(uint32_t key) {
+  if (key == KEY_POINT) return "keyPoint";
+  if (key == KEY_CTRL) return "keyCtrl";
+  if (key == KEY_FROM) return "keyFrom";
+  if (key == KEY_TO) return "keyTo";
+  if (key == KEY_BASE) return "keyBase";
+  if (key == KEY_VERSION) return "keyVersion";
+  if (key == KEY_GONEOFF) return "keyGoneoff";
+  if (key == KEY_TRANSMIT) return "keyTransmit";
+  if (key == KEY_AUTO_RESET) return "keyAutoReset";
+  if (key == KEY_SNOOZES) return "keySnoozes";
+  if (key == KEY_FAULT) return "keyFault";
+  if (key == KEY_POINTS) return "keyPoints";
+  if (key == KEY_SEQ) return "keySeq";
+  if (key == KEY_COUNTERS) return "keyCounters";
+  if (key == KEY_TRACE) return "keyTrace";
+  return "?";
+}
+
+/*
+ * The phone's copy of the night, as app.js stores it
+ */
+static int32_t phone_points[LIMIT];
+static uint64_t phone_final_ms[LIMIT];
+static uint32_t phone_counters[COUNTERS];
+static bool phone_has_counters;
+static uint8_t phone_trace[TRACE_EVENTS * sizeof(TraceEvent)];
+static uint16_t phone_trace_length;
+static uint16_t phone_trace_next;
+static bool phone_trace_done;
+static int32_t seq_expected = LAST_SENT_INIT;
+static bool gap_reported;
+static uint32_t nack_percent;
+static uint32_t drop_percent;
+static uint32_t link_seed = 1;
+static uint32_t gaps;
+
+static uint32_t link_random() {
+  link_seed = link_seed * 1103515245 + 12345;
+  return (link_seed >> 16) % 100;
+}
+
+/*
+ * Once a point is complete the next copy to arrive is final - remember when
+ */
+static void phone_got(uint8_t point) {
+  if (point < LIMIT && phone_final_ms[point] == 0 && point < get_internal_data()->highest_entry)
+    phone_final_ms[point] = host_clock_now_ms();
+}
+
+static void phone_reply(int32_t ctrl, bool with_seq, int32_t seq) {
+  Tuplet reply[] = { TupletInteger(KEY_CTRL, ctrl), TupletInteger(KEY_SEQ, seq) };
+  host_phone_send_tuplets(reply, with_seq ? 2 : 1);
+}
+
+/*
+ * The phone - logs what arrives and replies with the same ctrl flags as app.js. The link can
+ * NACK (the watch sees outbox failed) or lose a message after the ACK (the JS never sees it).
+ */
+static AppMessageResult phone_handler(DictionaryIterator *iter, void *context) {
+  if (link_random() < nack_percent)
+    return APP_MSG_SEND_TIMEOUT;
+  if (link_random() < drop_percent)
+    return APP_MSG_OK;
+
+  // Windowed chunk - drop anything after a gap and say so once
+  Tuple *seq_tuple = dict_find(iter, KEY_SEQ);
+  int32_t seq_first = 0, seq_last = 0;
+  if (seq_tuple) {
+    seq_first = seq_tuple->value->int32 >> 16;
+    seq_last = seq_tuple->value->int32 & 0xFFFF;
+    if (seq_first > seq_expected) {
+      if (!gap_reported) {
+        gap_reported = true;
+        gaps++;
+        phone_reply(CTRL_GAP, true, seq_expected - 1);
+      }
+      return APP_MSG_OK;
+    }
+    gap_reported = false;
+  }
+
+  int32_t ctrl = 0;
+  for (Tuple *t = dict_read_first(iter); t != NULL; t = dict_read_next(iter)) {
+    if (logged_count < MAX_LOGGED) {
+      logged[logged_count].at_ms = host_clock_now_ms();
+      logged[logged_count].key = t->key;
+      logged[logged_count].value = t->type == TUPLE_BYTE_ARRAY ? t->value->uint8 : t->value->int32;
+      logged[logged_count].length = t->length;
+      logged_count++;
+    }
+    if (t->key == KEY_VERSION) {
+      ctrl |= CTRL_VERSION_DONE | CTRL_LAZARUS | (quick_alarm ? CTRL_QUICK_ALARM : 0) | (bulk ? CTRL_BULK : 0) | (defer_sync ? CTRL_DEFER_SYNC : 0);
+    } else if (t->key == KEY_BASE) {
+      memset(phone_points, 0, sizeof(phone_points));
+      ctrl |= CTRL_DO_NEXT | CTRL_SET_LAST_SENT;
+    } else if (t->key == KEY_POINT) {
+      phone_points[t->value->int32 >> 16] = t->value->int32 & 0xFFFF;
+      phone_got(t->value->int32 >> 16);
+      ctrl |= CTRL_DO_NEXT | CTRL_SET_LAST_SENT;
+    } else if (t->key == KEY_POINTS) {
+      const uint8_t *packed = (const uint8_t *) t->value;
+      for (uint16_t i = 0; i < (t->length - 1) / 2; i++) {
+        phone_points[packed[0] + i] = packed[1 + i * 2] | (packed[2 + i * 2] << 8);
+        phone_got(packed[0] + i);
+      }
+      ctrl |= CTRL_DO_NEXT | CTRL_SET_LAST_SENT;
+    } else if (t->key == KEY_FROM || t->key == KEY_TO || t->key == KEY_AUTO_RESET) {
+      ctrl |= CTRL_DO_NEXT | CTRL_SET_LAST_SENT;
+    } else if (t->key == KEY_GONEOFF) {
+      ctrl |= CTRL_GONEOFF_DONE | CTRL_DO_NEXT;
+    } else if (t->key == KEY_SNOOZES) {
+      ctrl |= CTRL_SNOOZES_DONE | CTRL_DO_NEXT;
+    } else if (t->key == KEY_TRANSMIT) {
+      ctrl |= CTRL_TRANSMIT_DONE;
+    } else if (t->key == KEY_FAULT) {
+      ctrl |= CTRL_DO_NEXT;
+    } else if (t->key == KEY_COUNTERS) {
+      const uint8_t *packed = (const uint8_t *) t->value;
+      for (uint16_t i = 0; i < COUNTERS && i * 4 + 3 < t->length; i++) {
+        phone_counters[i] = packed[i * 4] | (packed[i * 4 + 1] << 8) | (packed[i * 4 + 2] << 16) | ((uint32_t) packed[i * 4 + 3] << 24);
+      }
+      phone_has_counters = true;
+    } else if (t->key == KEY_TRACE) {
+      // Events in order from the first chunk - a repeat after a NACK carries on where it was
+      const uint8_t *chunk = (const uint8_t *) t->value;
+      uint16_t first = chunk[0] | (chunk[1] << 8);
+      uint16_t end = chunk[2] | (chunk[3] << 8);
+      if (phone_trace_length == 0)
+        phone_trace_next = first;
+      if (first == phone_trace_next && phone_trace_length + t->length - 4 <= sizeof(phone_trace)) {
+        memcpy(phone_trace + phone_trace_length, chunk + 4, t->length - 4);
+        phone_trace_length += t->length - 4;
+        phone_trace_next += (t->length - 4) / sizeof(TraceEvent);
+        phone_trace_done = phone_trace_next == end;
+      }
+    }
+  }
+
+  // Cumulative ack - a base starts the sequence again
+  if (seq_tuple && (dict_find(iter, KEY_BASE) != NULL || seq_last + 1 > seq_expected))
+    seq_expected = seq_last + 1;
+
+  if (ctrl != 0)
+    phone_reply(ctrl, seq_tuple != NULL, seq_expected - 1);
+  return APP_MSG_OK;
+}
+
+/*
+ * The phone's side of data logging - items replayed in order as if they were messages
+ */
+static uint32_t bulk_items;
+static bool bulk_transmit;
+
+static void read_bulk() {
+  size_t length;
+  const uint8_t *bytes = host_data_logging_bytes(BULK_TAG, &length);
+  uint8_t counter_item = 0;
+  for (size_t pos = 0; pos + sizeof(BulkItem) <= length; pos += sizeof(BulkItem)) {
+    BulkItem item;
+    memcpy(&item, bytes + pos, sizeof(item));
+    bulk_items++;
+    if (item.key == KEY_BASE) {
+      memset(phone_points, 0, sizeof(phone_points));
+    } else if (item.key == KEY_POINT) {
+      phone_points[item.value >> 16] = item.value & 0xFFFF;
+    } else if (item.key == KEY_TRANSMIT) {
+      bulk_transmit = true;
+      counter_item = 0;
+    } else if (item.key == KEY_COUNTERS) {
+      // The last set before the marker wins
+      if (counter_item < COUNTERS)
+        phone_counters[counter_item++] = (uint32_t) item.value;
+      phone_has_counters = true;
+    }
+  }
+}
+
+static uint64_t night_ms;
+static bool reconnect;
+static uint8_t reconnect_hr;
+static uint8_t reconnect_min;
+
+/*
+ * Runs inside app_event_loop - reset for bed then step the night a minute at a time
+ * so the smart alarm is caught on the tick it fires
+ */
+static void night_loop() {
+  host_clock_advance_ms(SETTLE_MS);
+  reset_ms = host_clock_now_ms();
+  reset_sleep_period();
+  uint64_t end_ms = reset_ms + night_ms;
+  uint64_t next_ms = (reset_ms / MS_PER_MINUTE + 1) * MS_PER_MINUTE;
+  while (next_ms <= end_ms) {
+    if (reconnect) {
+      time_t now = next_ms / 1000;
+      struct tm *tm_now = localtime(&now);
+      if (tm_now->tm_hour == reconnect_hr && tm_now->tm_min == reconnect_min) {
+        host_set_bluetooth(true);
+        reconnect = false;
+      }
+    }
+    host_clock_run_until_ms(next_ms);
+    note_alarm();
+    next_ms += MS_PER_MINUTE;
+  }
+  host_clock_run_until_ms(end_ms);
+  if (dump_trace) {
+    phone_reply(CTRL_TRACE_DUMP, false, 0);
+    host_clock_run_until_ms(end_ms + MS_PER_MINUTE / 2);
+  }
+  if (quit_at_end)
+    close_morpheuz();
+}
+
+/*
+ * Local time as text
+ */
+static char *local_text(uint64_t ms) {
+  static char text[2][32];
+  static uint8_t which;
+  time_t t = ms / 1000;
+  which = !which;
+  strftime(text[which], sizeof(text[which]), "%Y-%m-%d %H:%M:%S", localtime(&t));
+  return text[which];
+}
+
+/*
+ * Counter names for the report, in CounterId order
+ */
+static const char *counter_names[COUNTERS] = {
+  "accel", "discarded", "accel_ms", "draw_progress", "draw_icon_bar", "draw_dial", "draw_hands",
+  "draw_round_time", "draw_chart", "sent", "acked", "failed", "persist_bytes", "wakeups", "masked",
+  "raw_dropped", "redraw_requests", "mark_icon_bar", "mark_progress", "mark_dial", "mark_hands",
+  "progress_columns"
+};
+
+/*
+ * Everything worth knowing about the night
+ */
+static void report(bool list_messages) {
+  InternalData *internal_data = get_internal_data();
+  printf("night %s to %s\n", local_text(reset_ms), local_text(host_clock_now_ms()));
+  if (alarm_ms != 0) {
+    printf("smart alarm fired %s (gone_off %02d:%02d)\n", local_text(alarm_ms), alarm_gone_off / 60, alarm_gone_off % 60);
+  } else {
+    printf("smart alarm not fired\n");
+  }
+  printf("highest_entry %d last_sent %d transmit_sent %d error_code %d masked_samples %d\n", internal_data->highest_entry, internal_data->last_sent,
+         internal_data->transmit_sent, internal_data->error_code, internal_data->masked_samples);
+  printf("points");
+  for (uint8_t i = 0; i < LIMIT; i++) {
+    printf(" %d%s", get_point(internal_data->points, i), get_ignore(internal_data->ignore, i) ? "i" : "");
+  }
+  printf("\n");
+  printf("persist_write_data %u (%u bytes)\n", host_stats.persist_writes, host_stats.persist_bytes_written);
+  printf("messages sent %u acked %u failed %u (%u bytes), gaps %u, outbox busy %u\n", host_stats.messages_sent, host_stats.messages_acked,
+         host_stats.messages_failed, host_stats.message_bytes_sent, gaps, host_stats.outbox_busy);
+  if (bulk) {
+    read_bulk();
+    printf("data logging items %u (%u bytes), transmit %d\n", bulk_items, host_stats.dlog_bytes, bulk_transmit);
+  }
+  uint8_t differ = 0;
+  for (uint8_t i = 0; i <= internal_data->highest_entry; i++) {
+    if (phone_points[i] != (get_ignore(internal_data->ignore, i) ? 5000 : get_point(internal_data->points, i)))
+      differ++;
+  }
+  printf("phone points differ from watch %d\n", differ);
+  printf("phone counters");
+  for (uint8_t i = 0; phone_has_counters && i < COUNTERS; i++) {
+    printf(" %s %u", counter_names[i], phone_counters[i]);
+  }
+  printf(phone_has_counters ? "\n" : " none\n");
+  if (!bulk) {
+    // How long after a point is complete the phone has it
+    uint64_t worst_ms = 0;
+    uint8_t never = 0;
+    for (uint8_t i = 0; i < internal_data->highest_entry; i++) {
+      uint64_t complete_ms = (uint64_t) internal_data->base * 1000 + (uint64_t) (i + 1) * DIVISOR * 1000;
+      if (phone_final_ms[i] == 0)
+        never++;
+      else if (phone_final_ms[i] > complete_ms && phone_final_ms[i] - complete_ms > worst_ms)
+        worst_ms = phone_final_ms[i] - complete_ms;
+    }
+    printf("phone behind at worst %.1fs, points never final on the phone %d\n", worst_ms / 1000.0, never);
+  }
+  printf("features");
+  for (uint8_t ago = 0; ago < 10; ago++) {
+    MinuteFeatures features;
+    if (get_minute_features(ago, &features))
+      printf(" %u/%u/%u/%u", features.activity, features.rms, features.bursts, features.moving);
+    else
+      printf(" -");
+  }
+  printf(" (activity/rms/bursts/moving, - not measured, last 10 minutes)\n");
+  printf("accel batches %u samples %u, timers %u, ticks %u, frames %u\n", host_stats.accel_batches, host_stats.accel_samples,
+         host_stats.timers_fired, host_stats.ticks, host_stats.frames);
+  printf("layer updates %u, draw calls %u, bitmaps created %u, resource loads %u\n", host_stats.layer_updates, host_stats.draw_calls,
+         host_stats.bitmaps_created, host_stats.resource_loads);
+  // Every callback into the app wakes the CPU
+  uint32_t wakeups = host_stats.accel_batches + host_stats.taps + host_stats.timers_fired + host_stats.ticks + host_stats.wakeups_fired
+                     + host_stats.messages_acked + host_stats.messages_failed + host_stats.messages_received;
+  double hours = (host_clock_now_ms() - reset_ms) / (60.0 * MS_PER_MINUTE);
+  printf("accel peeks %u taps %u, wakeups %u (%.0f per hour)\n", host_stats.accel_peeks, host_stats.taps, wakeups, wakeups / hours);
+  HostWakeup scheduled[8];
+  uint8_t scheduled_count = host_wakeup_list(scheduled, ARRAY_LENGTH(scheduled));
+  printf("wakeups scheduled");
+  for (uint8_t i = 0; i < scheduled_count; i++) {
+    printf(" %s (%ld)", local_text((uint64_t) scheduled[i].timestamp * 1000), (long) scheduled[i].cookie);
+  }
+  printf("\n");
+  if (dump_trace) {
+    printf("trace%s ", phone_trace_done ? "" : " (incomplete)");
+    for (uint16_t i = 0; i < phone_trace_length; i++) {
+      printf("%02x", phone_trace[i]);
+    }
+    printf("\n");
+  }
+  if (!list_messages)
+    return;
+  for (uint32_t i = 0; i < logged_count; i++) {
+    LoggedMessage *m = &logged[i];
+    printf("  %s %-12s %ld", local_text(m->at_ms), key_name(m->key), (long) m->value);
+    if (m->key == KEY_POINT)
+      printf(" (point %d biggest %d)", m->value >> 16, m->value & 0xFFFF);
+    if (m->key == KEY_POINTS)
+      printf(" (first %ld count %d)", (long) m->value, (m->length - 1) / 2);
+    if (m->key == KEY_SEQ)
+      printf(" (first %d last %d)", m->value >> 16, m->value & 0xFFFF);
+    printf("\n");
+  }
+  if (logged_count == MAX_LOGGED)
+    printf("  ... more not logged\n");
+}
+
+/*
+ * Parse "HH:MM"
+ */
+static bool parse_hhmm(const char *text, uint8_t *hr, uint8_t *min) {
+  int h, m;
+  if (sscanf(text, "%d:%d", &h, &m) != 2 || h < 0 || h > 23 || m < 0 || m > 59)
+    return false;
+  *hr = h;
+  *min = m;
+  return true;
+}
+
+static void usage() {
+  fprintf(stderr, "usage: nightsim [-s \"YYYY-MM-DD HH:MM\"] [-H hours] [-a HH:MM-HH:MM] [-Q] [-B] [-D] [-A] [-S seed] [-l latency_ms] [-n] [-r HH:MM] [-f pct] [-d pct] [-x] [-T] [-q] [trace]\n");
+  exit(2);
+}
+
+int main(int argc, char *argv[]) {
+  const char *start = DEFAULT_START;
+  double hours = DEFAULT_HOURS;
+  const char *smart = NULL;
+  bool list_messages = true;
+  bool connected = true;
+  bool analogue = false;
+  int opt;
+
+  while ((opt = getopt(argc, argv, "s:H:a:QBDAS:l:nr:f:d:xTq")) != -1) {
+    switch (opt) {
+      case 's':
+        start = optarg;
+        break;
+      case 'H':
+        hours = atof(optarg);
+        break;
+      case 'a':
+        smart = optarg;
+        break;
+      case 'Q':
+        quick_alarm = true;
+        break;
+      case 'B':
+        bulk = true;
+        break;
+      case 'D':
+        defer_sync = true;
+        break;
+      case 'A':
+        analogue = true;
+        break;
+      case 'S':
+        seed = strtoul(optarg, NULL, 10);
+        break;
+      case 'l':
+        host_phone_set_latency_ms(strtoul(optarg, NULL, 10));
+        break;
+      case 'n':
+        connected = false;
+        break;
+      case 'r':
+        if (!parse_hhmm(optarg, &reconnect_hr, &reconnect_min))
+          usage();
+        reconnect = true;
+        connected = false;
+        break;
+      case 'f':
+        nack_percent = strtoul(optarg, NULL, 10);
+        break;
+      case 'd':
+        drop_percent = strtoul(optarg, NULL, 10);
+        break;
+      case 'x':
+        quit_at_end = true;
+        break;
+      case 'T':
+        dump_trace = true;
+        break;
+      case 'q':
+        list_messages = false;
+        break;
+      default:
+        usage();
+    }
+  }
+
+  link_seed = seed;
+
+  if (getenv("TZ") == NULL)
+    setenv("TZ", "UTC", 1);
+  tzset();
+
+  struct tm tm_start;
+  memset(&tm_start, 0, sizeof(tm_start));
+  if (sscanf(start, "%d-%d-%d %d:%d", &tm_start.tm_year, &tm_start.tm_mon, &tm_start.tm_mday, &tm_start.tm_hour, &tm_start.tm_min) != 5)
+    usage();
+  tm_start.tm_year -= 1900;
+  tm_start.tm_mon -= 1;
+  tm_start.tm_isdst = -1;
+
+  if (optind < argc) {
+    if (!load_trace(argv[optind]))
+      return 1;
+    host_accel_set_source(trace_source, NULL);
+  } else {
+    host_accel_set_source(synthetic_source, NULL);
+  }
+
+  // Smart alarm and face settings go in ahead of launch as if set on a previous night
+  if (smart != NULL || analogue) {
+    ConfigData config;
+    memset(&config, 0, sizeof(config));
+    config.fromhr = FROM_HR_DEF;
+    config.frommin = FROM_MIN_DEF;
+    config.tohr = TO_HR_DEF;
+    config.tomin = TO_MIN_DEF;
+    if (smart != NULL) {
+      char *to = strchr(smart, '-');
+      if (to == NULL || !parse_hhmm(smart, &config.fromhr, &config.frommin) || !parse_hhmm(to + 1, &config.tohr, &config.tomin))
+        usage();
+      config.smart = true;
+    }
+    config.config_ver = CONFIG_VER;
+    config.analogue = analogue;
+    config.quick_alarm = quick_alarm;
+    config.lazarus = true;
+    config.from = to_mins(config.fromhr, config.frommin);
+    config.to = to_mins(config.tohr, config.tomin);
+    persist_write_data(PERSIST_CONFIG_KEY, &config, sizeof(config));
+  }
+
+  night_ms = (uint64_t) (hours * 60 * MS_PER_MINUTE);
+  host_clock_set(mktime(&tm_start) - SETTLE_MS / 1000);
+  host_set_bluetooth(connected);
+  host_phone_set_handler(phone_handler, NULL);
+  host_set_event_loop(night_loop);
+  host_stats_reset();
+
+  host_app_main();
+
+  report(list_messages);
+  return 0;
+}
@@ -0,0 +1,2194 @@
+/*
+ * Morpheuz Sleep Monitor
+ *
+ * Copyright (c) 2013-2016 James Fowler
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <math.h>
+#include <stdarg.h>
+
+#include "pebble.h"
+#include "pebble_host.h"
+
+// Generated from package.json by gen_auto.py
+extern const char *host_resource_files[];
+extern const uint32_t host_resource_count;
+
+#define MAX_WINDOWS 8
+#define MAX_WAKEUPS 8
+#define WAKEUP_CLASH_SECONDS 60
+#define HOST_HEAP_FREE 16384
+#define VIBE_SHORT_MS 250
+#define VIBE_LONG_MS 500
+#define VIBE_DOUBLE_MS 750
+#define MS_PER_SECOND 1000
+#define HOST_TAP_JERK 400
+
+HostStats host_stats;
+
+/*
+ * Clock
+ */
+static uint64_t now_ms;
+
+/*
+ * Timers (app timers and the shim's own, e.g. animations, share one ordered list)
+ */
+struct AppTimer {
+  uint64_t due;
+  uint32_t seq;
+  AppTimerCallback callback;
+  void *data;
+  bool internal;
+  struct AppTimer *next;
+};
+static AppTimer *timers;
+static uint32_t timer_seq;
+
+/*
+ * Services
+ */
+static TickHandler tick_handler;
+static TimeUnits tick_units;
+static uint64_t next_tick;
+
+static AccelDataHandler accel_handler;
+static uint32_t accel_samples_per_update;
+static uint32_t accel_rate = ACCEL_SAMPLING_25HZ;
+static uint64_t next_accel;
+static HostAccelSource accel_source;
+static void *accel_source_context;
+static AccelData *accel_buffer;
+static AccelTapHandler tap_handler;
+static AccelData accel_last;
+static bool accel_last_valid;
+static uint64_t vibe_until;
+
+static BatteryStateHandler battery_handler;
+static BatteryChargeState battery_state = { .charge_percent = 80, .is_charging = false, .is_plugged = false };
+static BluetoothConnectionHandler bluetooth_handler;
+static bool bluetooth_connected = true;
+static bool is_24h = true;
+static uint8_t log_level;
+
+static AppLaunchReason host_launch_reason = APP_LAUNCH_USER;
+static uint32_t host_launch_args;
+static WakeupId launch_wakeup_id = -1;
+static int32_t launch_cookie;
+static HostEventLoop event_loop;
+
+typedef struct {
+  bool used;
+  WakeupId id;
+  time_t timestamp;
+  int32_t cookie;
+} WakeupEntry;
+static WakeupEntry wakeups[MAX_WAKEUPS];
+static WakeupHandler wakeup_handler;
+static WakeupId wakeup_next_id = 1;
+
+/*
+ * Persist
+ */
+typedef struct PersistEntry {
+  uint32_t key;
+  uint16_t size;
+  uint8_t data[PERSIST_DATA_MAX_LENGTH];
+  struct PersistEntry *next;
+} PersistEntry;
+static PersistEntry *persist_entries;
+
+/*
+ * Data logging - one delivered byte stream per tag
+ */
+typedef struct DataLoggingEntry {
+  uint32_t tag;
+  uint16_t item_length;
+  bool open;
+  uint8_t *bytes;
+  size_t length;
+  struct DataLoggingEntry *next;
+} DataLoggingEntry;
+static DataLoggingEntry *dlog_entries;
+static uint32_t dlog_spool_bytes = 64 * 1024;
+static uint32_t dlog_drain_rate = 1000;
+static uint32_t dlog_spooled;
+static uint64_t dlog_drained_at;
+static void dlog_drain(void);
+
+/*
+ * AppMessage
+ */
+typedef enum {
+  OUTBOX_IDLE,
+  OUTBOX_BEGUN,
+  OUTBOX_SENDING
+} OutboxState;
+
+typedef struct InboxEntry {
+  uint64_t due;
+  uint16_t size;
+  uint8_t *buffer;
+  struct InboxEntry *next;
+} InboxEntry;
+
+static bool message_open;
+static uint32_t inbox_size;
+static uint32_t outbox_size;
+static uint8_t *outbox_buffer;
+static DictionaryIterator outbox_iter;
+static OutboxState outbox_state;
+static uint64_t outbox_due;
+static AppMessageResult outbox_result;
+static AppMessageInboxReceived inbox_received;
+static AppMessageInboxDropped inbox_dropped;
+static AppMessageOutboxSent outbox_sent;
+static AppMessageOutboxFailed outbox_failed;
+static InboxEntry *inbox_queue;
+static HostPhoneHandler phone_handler;
+static void *phone_context;
+static uint32_t link_latency_ms = 50;
+
+/*
+ * UI
+ */
+struct Layer {
+  GRect frame;
+  GRect bounds;
+  LayerUpdateProc update_proc;
+  bool hidden;
+  bool dirty;
+  struct Layer *parent;
+  struct Layer *first_child;
+  struct Layer *next_sibling;
+  struct Window *window;
+};
+
+struct TextLayer {
+  Layer layer;
+  const char *text;
+  GFont font;
+  GColor text_color;
+  GColor background_color;
+  GTextAlignment alignment;
+};
+
+struct BitmapLayer {
+  Layer layer;
+  const GBitmap *bitmap;
+  GCompOp mode;
+};
+
+struct MenuLayer {
+  Layer layer;
+  MenuLayerCallbacks callbacks;
+  void *context;
+  MenuIndex selected;
+};
+
+struct GBitmap {
+  GRect bounds;
+  GBitmapFormat format;
+  uint16_t row_size;
+  uint8_t *data;
+  const GBitmap *parent;
+};
+
+struct HostFont {
+  const char *key;
+};
+
+struct GPath {
+  GPathInfo info;
+  int32_t rotation;
+  GPoint offset;
+};
+
+struct GContext {
+  GColor fill_color;
+  GColor stroke_color;
+  GColor text_color;
+  uint8_t stroke_width;
+  GCompOp mode;
+  bool antialiased;
+};
+
+typedef struct {
+  ClickHandler single;
+  ClickHandler long_down;
+  ClickHandler long_up;
+} ButtonConfig;
+
+struct Window {
+  Layer root;
+  WindowHandlers handlers;
+  ClickConfigProvider click_config_provider;
+  void *click_context;
+  ButtonConfig buttons[NUM_BUTTONS];
+  MenuLayer *menu;
+  GColor background_color;
+  bool loaded;
+};
+
+struct Animation {
+  Layer *layer;
+  GRect from_frame;
+  GRect to_frame;
+  uint32_t duration;
+  AnimationHandlers handlers;
+  void *context;
+};
+
+struct PropertyAnimation {
+  struct Animation animation;
+};
+
+struct DictationSession {
+  DictationSessionStatusCallback callback;
+  void *context;
+};
+
+static Window *window_stack[MAX_WINDOWS];
+static uint8_t window_count;
+static Window *configuring_window;
+static bool render_enabled = true;
+static struct HostFont system_font = { "system" };
+static struct HostFont custom_font = { "custom" };
+static DictationSessionStatus dictation_status = DictationSessionStatusFailureSystemAborted;
+static char dictation_text[64];
+
+static void render_if_dirty();
+
+/*
+ * ------------------------------------------------------------------------------------------
+ * Logging
+ */
+void app_log(uint8_t level, const char *src_filename, int src_line_number, const char *fmt, ...) {
+  if (level > log_level)
+    return;
+  va_list args;
+  va_start(args, fmt);
+  fprintf(stderr, "[%llu] ", (unsigned long long) (now_ms / MS_PER_SECOND));
+  vfprintf(stderr, fmt, args);
+  fputc('\n', stderr);
+  va_end(args);
+}
+
+void host_set_log_level(uint8_t level) {
+  log_level = level;
+}
+
+/*
+ * ------------------------------------------------------------------------------------------
+ * Clock
+ */
+time_t host_time(time_t *tloc) {
+  time_t now = (time_t) (now_ms / MS_PER_SECOND);
+  if (tloc != NULL)
+    *tloc = now;
+  return now;
+}
+
+uint16_t time_ms(time_t *t_utc, uint16_t *out_ms) {
+  uint16_t ms = (uint16_t) (now_ms % MS_PER_SECOND);
+  if (t_utc != NULL)
+    *t_utc = (time_t) (now_ms / MS_PER_SECOND);
+  if (out_ms != NULL)
+    *out_ms = ms;
+  return ms;
+}
+
+uint64_t host_clock_now_ms(void) {
+  return now_ms;
+}
+
+/*
+ * Next tick boundary after the current time for the subscribed unit
+ */
+static uint64_t calc_next_tick() {
+  uint64_t unit_ms = (tick_units & SECOND_UNIT) ? MS_PER_SECOND : 60 * MS_PER_SECOND;
+  return (now_ms / unit_ms + 1) * unit_ms;
+}
+
+/*
+ * Next accelerometer batch is a full batch worth of samples from now
+ */
+static uint64_t calc_next_accel() {
+  return now_ms + ((uint64_t) accel_samples_per_update * MS_PER_SECOND) / accel_rate;
+}
+
+void host_clock_set(time_t now) {
+  now_ms = ((uint64_t) now) * MS_PER_SECOND;
+  next_tick = calc_next_tick();
+  next_accel = calc_next_accel();
+}
+
+/*
+ * Timer list is kept in due order, ties in registration order
+ */
+static void timer_insert(AppTimer *timer) {
+  AppTimer **pp = &timers;
+  while (*pp != NULL && ((*pp)->due < timer->due || ((*pp)->due == timer->due && (*pp)->seq < timer->seq))) {
+    pp = &(*pp)->next;
+  }
+  timer->next = *pp;
+  *pp = timer;
+}
+
+static bool timer_unlink(AppTimer *timer) {
+  for (AppTimer **pp = &timers; *pp != NULL; pp = &(*pp)->next) {
+    if (*pp == timer) {
+      *pp = timer->next;
+      return true;
+    }
+  }
+  return false;
+}
+
+static AppTimer *timer_add(uint32_t timeout_ms, AppTimerCallback callback, void *data, bool internal) {
+  AppTimer *timer = calloc(1, sizeof(AppTimer));
+  timer->due = now_ms + timeout_ms;
+  timer->seq = timer_seq++;
+  timer->callback = callback;
+  timer->data = data;
+  timer->internal = internal;
+  timer_insert(timer);
+  return timer;
+}
+
+AppTimer *app_timer_register(uint32_t timeout_ms, AppTimerCallback callback, void *callback_data) {
+  return timer_add(timeout_ms, callback, callback_data, false);
+}
+
+bool app_timer_reschedule(AppTimer *timer_handle, uint32_t new_timeout_ms) {
+  if (timer_handle == NULL || !timer_unlink(timer_handle))
+    return false;
+  timer_handle->due = now_ms + new_timeout_ms;
+  timer_handle->seq = timer_seq++;
+  timer_insert(timer_handle);
+  return true;
+}
+
+void app_timer_cancel(AppTimer *timer_handle) {
+  if (timer_handle != NULL && timer_unlink(timer_handle))
+    free(timer_handle);
+}
+
+/*
+ * Types of event the clock can dispatch
+ */
+typedef enum {
+  EVENT_NONE,
+  EVENT_OUTBOX,
+  EVENT_INBOX,
+  EVENT_WAKEUP,
+  EVENT_TICK,
+  EVENT_ACCEL,
+  EVENT_TIMER
+} HostEvent;
+
+/*
+ * Find the earliest pending event
+ */
+static HostEvent next_event(uint64_t *due) {
+  HostEvent event = EVENT_NONE;
+  *due = UINT64_MAX;
+  if (outbox_state == OUTBOX_SENDING && outbox_due < *due) {
+    *due = outbox_due;
+    event = EVENT_OUTBOX;
+  }
+  if (inbox_queue != NULL && inbox_queue->due < *due) {
+    *due = inbox_queue->due;
+    event = EVENT_INBOX;
+  }
+  for (uint8_t i = 0; i < MAX_WAKEUPS; i++) {
+    if (wakeups[i].used && ((uint64_t) wakeups[i].timestamp) * MS_PER_SECOND < *due) {
+      *due = ((uint64_t) wakeups[i].timestamp) * MS_PER_SECOND;
+      event = EVENT_WAKEUP;
+    }
+  }
+  if (tick_handler != NULL && next_tick < *due) {
+    *due = next_tick;
+    event = EVENT_TICK;
+  }
+  if ((accel_handler != NULL || tap_handler != NULL) && next_accel < *due) {
+    *due = next_accel;
+    event = EVENT_ACCEL;
+  }
+  if (timers != NULL && timers->due < *due) {
+    *due = timers->due;
+    event = EVENT_TIMER;
+  }
+  return event;
+}
+
+static void dispatch_outbox();
+static void dispatch_inbox();
+static void dispatch_wakeup();
+static void dispatch_tick();
+static void dispatch_accel();
+
+/*
+ * Fire the first timer
+ */
+static void dispatch_timer() {
+  AppTimer *timer = timers;
+  timers = timer->next;
+  if (!timer->internal)
+    host_stats.timers_fired++;
+  AppTimerCallback callback = timer->callback;
+  void *data = timer->data;
+  free(timer);
+  callback(data);
+}
+
+void host_clock_run_until_ms(uint64_t until_ms) {
+  uint64_t due;
+  HostEvent event;
+  while ((event = next_event(&due)) != EVENT_NONE && due <= until_ms) {
+    if (due > now_ms)
+      now_ms = due;
+    switch (event) {
+      case EVENT_OUTBOX:
+        dispatch_outbox();
+        break;
+      case EVENT_INBOX:
+        dispatch_inbox();
+        break;
+      case EVENT_WAKEUP:
+        dispatch_wakeup();
+        break;
+      case EVENT_TICK:
+        dispatch_tick();
+        break;
+      case EVENT_ACCEL:
+        dispatch_accel();
+        break;
+      case EVENT_TIMER:
+        dispatch_timer();
+        break;
+      case EVENT_NONE:
+        break;
+    }
+    render_if_dirty();
+  }
+  if (until_ms > now_ms)
+    now_ms = until_ms;
+}
+
+void host_clock_advance_ms(uint64_t delta_ms) {
+  host_clock_run_until_ms(now_ms + delta_ms);
+}
+
+/*
+ * ------------------------------------------------------------------------------------------
+ * Tick timer service and clock
+ */
+void tick_timer_service_subscribe(TimeUnits units, TickHandler handler) {
+  tick_units = units;
+  tick_handler = handler;
+  next_tick = calc_next_tick();
+}
+
+void tick_timer_service_unsubscribe(void) {
+  tick_handler = NULL;
+}
+
+static void dispatch_tick() {
+  time_t now = host_time(NULL);
+  time_t before = now - ((tick_units & SECOND_UNIT) ? 1 : 60);
+  struct tm prev = *localtime(&before);
+  struct tm *tick_time = localtime(&now);
+  TimeUnits changed = (tick_units & SECOND_UNIT) ? SECOND_UNIT : 0;
+  if (tick_time->tm_min != prev.tm_min)
+    changed |= MINUTE_UNIT;
+  if (tick_time->tm_hour != prev.tm_hour)
+    changed |= HOUR_UNIT;
+  if (tick_time->tm_mday != prev.tm_mday)
+    changed |= DAY_UNIT;
+  if (tick_time->tm_mon != prev.tm_mon)
+    changed |= MONTH_UNIT;
+  if (tick_time->tm_year != prev.tm_year)
+    changed |= YEAR_UNIT;
+  next_tick = calc_next_tick();
+  host_stats.ticks++;
+  tick_handler(tick_time, changed);
+}
+
+bool clock_is_24h_style(void) {
+  return is_24h;
+}
+
+void host_set_24h_style(bool value) {
+  is_24h = value;
+}
+
+void clock_copy_time_string(char *buffer, uint8_t size) {
+  time_t now = host_time(NULL);
+  struct tm *t = localtime(&now);
+  if (is_24h) {
+    snprintf(buffer, size, "%02d:%02d", t->tm_hour, t->tm_min);
+  } else {
+    int hour = t->tm_hour % 12;
+    snprintf(buffer, size, "%d:%02d", hour == 0 ? 12 : hour, t->tm_min);
+  }
+}
+
+/*
+ * ------------------------------------------------------------------------------------------
+ * Accelerometer
+ */
+void host_accel_set_source(HostAccelSource source, void *context) {
+  accel_source = source;
+  accel_source_context = context;
+}
+
+uint32_t host_accel_rate(void) {
+  return accel_rate;
+}
+
+uint32_t host_accel_samples_per_update(void) {
+  return accel_samples_per_update;
+}
+
+void accel_data_service_subscribe(uint32_t samples_per_update, AccelDataHandler handler) {
+  accel_handler = handler;
+  accel_service_set_samples_per_update(samples_per_update);
+}
+
+void accel_data_service_unsubscribe(void) {
+  accel_handler = NULL;
+}
+
+void accel_tap_service_subscribe(AccelTapHandler handler) {
+  tap_handler = handler;
+  if (accel_handler == NULL)
+    next_accel = now_ms + MS_PER_SECOND / accel_rate;
+}
+
+void accel_tap_service_unsubscribe(void) {
+  tap_handler = NULL;
+}
+
+int accel_service_set_sampling_rate(AccelSamplingRate rate) {
+  accel_rate = rate;
+  next_accel = calc_next_accel();
+  return 0;
+}
+
+int accel_service_set_samples_per_update(uint32_t num_samples) {
+  if (num_samples > 25)
+    num_samples = 25;
+  accel_samples_per_update = num_samples;
+  free(accel_buffer);
+  accel_buffer = calloc(num_samples, sizeof(AccelData));
+  next_accel = calc_next_accel();
+  return 0;
+}
+
+/*
+ * A still watch lying face up
+ */
+static void still_source(AccelData *data, uint32_t num_samples, void *context) {
+  for (uint32_t i = 0; i < num_samples; i++) {
+    data[i].x = 0;
+    data[i].y = 0;
+    data[i].z = -1000;
+  }
+}
+
+/*
+ * One sample now. While the tap service keeps the accelerometer running this is the latest
+ * sample it took, otherwise the accelerometer is woken for one. Fails while subscribed to data,
+ * as on the watch.
+ */
+int accel_service_peek(AccelData *data) {
+  if (accel_handler != NULL)
+    return -1;
+  host_stats.accel_peeks++;
+  if (tap_handler != NULL && accel_last_valid) {
+    *data = accel_last;
+  } else {
+    memset(data, 0, sizeof(AccelData));
+    data->timestamp = now_ms;
+    if (accel_source != NULL) {
+      accel_source(data, 1, accel_source_context);
+    } else {
+      still_source(data, 1, NULL);
+    }
+  }
+  data->did_vibrate = data->timestamp < vibe_until;
+  return 0;
+}
+
+/*
+ * With only the tap service subscribed the accelerometer samples on its own - a sharp enough
+ * change from one sample to the next is a tap, and that is the only time the app hears of it
+ */
+static void dispatch_tap_scan() {
+  AccelData s;
+  memset(&s, 0, sizeof(s));
+  s.timestamp = now_ms;
+  if (accel_source != NULL) {
+    accel_source(&s, 1, accel_source_context);
+  } else {
+    still_source(&s, 1, NULL);
+  }
+  s.did_vibrate = s.timestamp < vibe_until;
+  next_accel = now_ms + MS_PER_SECOND / accel_rate;
+  AccelData previous = accel_last;
+  bool compare = accel_last_valid && !s.did_vibrate;
+  accel_last = s;
+  accel_last_valid = true;
+  if (!compare)
+    return;
+  int32_t dx = s.x - previous.x, dy = s.y - previous.y, dz = s.z - previous.z;
+  AccelAxisType axis = abs(dx) >= abs(dy) && abs(dx) >= abs(dz) ? ACCEL_AXIS_X : abs(dy) >= abs(dz) ? ACCEL_AXIS_Y : ACCEL_AXIS_Z;
+  int32_t d = axis == ACCEL_AXIS_X ? dx : axis == ACCEL_AXIS_Y ? dy : dz;
+  if (abs(d) > HOST_TAP_JERK) {
+    host_stats.taps++;
+    tap_handler(axis, d > 0 ? 1 : -1);
+  }
+}
+
+static void dispatch_accel() {
+  if (accel_handler == NULL) {
+    dispatch_tap_scan();
+    return;
+  }
+  uint32_t n = accel_samples_per_update;
+  uint64_t period = MS_PER_SECOND / accel_rate;
+  uint64_t first = now_ms - n * period;
+  memset(accel_buffer, 0, n * sizeof(AccelData));
+  for (uint32_t i = 0; i < n; i++) {
+    accel_buffer[i].timestamp = first + i * period;
+  }
+  if (accel_source != NULL) {
+    accel_source(accel_buffer, n, accel_source_context);
+  } else {
+    still_source(accel_buffer, n, NULL);
+  }
+  for (uint32_t i = 0; i < n; i++) {
+    accel_buffer[i].did_vibrate = accel_buffer[i].did_vibrate || accel_buffer[i].timestamp < vibe_until;
+  }
+  next_accel = calc_next_accel();
+  accel_last = accel_buffer[n - 1];
+  accel_last_valid = true;
+  host_stats.accel_batches++;
+  host_stats.accel_samples += n;
+  accel_handler(accel_buffer, n);
+}
+
+/*
+ * ------------------------------------------------------------------------------------------
+ * Battery, bluetooth, vibes and light
+ */
+BatteryChargeState battery_state_service_peek(void) {
+  return battery_state;
+}
+
+void battery_state_service_subscribe(BatteryStateHandler handler) {
+  battery_handler = handler;
+}
+
+void battery_state_service_unsubscribe(void) {
+  battery_handler = NULL;
+}
+
+void host_set_battery(BatteryChargeState charge) {
+  battery_state = charge;
+  if (battery_handler != NULL)
+    battery_handler(charge);
+}
+
+bool bluetooth_connection_service_peek(void) {
+  return bluetooth_connected;
+}
+
+void bluetooth_connection_service_subscribe(BluetoothConnectionHandler handler) {
+  bluetooth_handler = handler;
+}
+
+void bluetooth_connection_service_unsubscribe(void) {
+  bluetooth_handler = NULL;
+}
+
+void host_set_bluetooth(bool connected) {
+  dlog_drain();
+  bluetooth_connected = connected;
+  if (bluetooth_handler != NULL)
+    bluetooth_handler(connected);
+}
+
+/*
+ * Vibes mark the accelerometer samples taken while the motor runs
+ */
+static void vibe_for(uint32_t duration_ms) {
+  uint64_t until = now_ms + duration_ms;
+  if (until > vibe_until)
+    vibe_until = until;
+  host_stats.vibes++;
+}
+
+void vibes_short_pulse(void) {
+  vibe_for(VIBE_SHORT_MS);
+}
+
+void vibes_long_pulse(void) {
+  vibe_for(VIBE_LONG_MS);
+}
+
+void vibes_double_pulse(void) {
+  vibe_for(VIBE_DOUBLE_MS);
+}
+
+void vibes_enqueue_custom_pattern(VibePattern pattern) {
+  uint32_t total = 0;
+  for (uint32_t i = 0; i < pattern.num_segments; i++) {
+    total += pattern.durations[i];
+  }
+  vibe_for(total);
+}
+
+void vibes_cancel(void) {
+  vibe_until = now_ms;
+}
+
+void light_enable_interaction(void) {
+  host_stats.lights++;
+}
+
+void light_enable(bool enable) {
+  host_stats.lights++;
+}
+
+size_t heap_bytes_free(void) {
+  return HOST_HEAP_FREE;
+}
+
+size_t heap_bytes_used(void) {
+  return 0;
+}
+
+/*
+ * ------------------------------------------------------------------------------------------
+ * Persistent storage
+ */
+static PersistEntry *persist_find(uint32_t key) {
+  for (PersistEntry *e = persist_entries; e != NULL; e = e->next) {
+    if (e->key == key)
+      return e;
+  }
+  return NULL;
+}
+
+void host_persist_reset(void) {
+  while (persist_entries != NULL) {
+    PersistEntry *e = persist_entries;
+    persist_entries = e->next;
+    free(e);
+  }
+}
+
+uint32_t host_persist_used(uint16_t *keys) {
+  uint32_t bytes = 0;
+  *keys = 0;
+  for (PersistEntry *e = persist_entries; e != NULL; e = e->next) {
+    bytes += e->size;
+    (*keys)++;
+  }
+  return bytes;
+}
+
+bool persist_exists(const uint32_t key) {
+  return persist_find(key) != NULL;
+}
+
+int persist_get_size(const uint32_t key) {
+  PersistEntry *e = persist_find(key);
+  return e == NULL ? E_DOES_NOT_EXIST : e->size;
+}
+
+int persist_read_data(const uint32_t key, void *buffer, const size_t buffer_size) {
+  host_stats.persist_reads++;
+  PersistEntry *e = persist_find(key);
+  if (e == NULL)
+    return E_DOES_NOT_EXIST;
+  size_t size = e->size < buffer_size ? e->size : buffer_size;
+  memcpy(buffer, e->data, size);
+  return size;
+}
+
+/*
+ * As on the watch only the first PERSIST_DATA_MAX_LENGTH bytes are kept
+ */
+int persist_write_data(const uint32_t key, const void *data, const size_t size) {
+  PersistEntry *e = persist_find(key);
+  if (e == NULL) {
+    e = calloc(1, sizeof(PersistEntry));
+    e->key = key;
+    e->next = persist_entries;
+    persist_entries = e;
+  }
+  e->size = size < PERSIST_DATA_MAX_LENGTH ? size : PERSIST_DATA_MAX_LENGTH;
+  memcpy(e->data, data, e->size);
+  host_stats.persist_writes++;
+  host_stats.persist_bytes_written += e->size;
+  return e->size;
+}
+
+int32_t persist_read_int(const uint32_t key) {
+  int32_t value = 0;
+  persist_read_data(key, &value, sizeof(value));
+  return value;
+}
+
+status_t persist_write_int(const uint32_t key, const int32_t value) {
+  return persist_write_data(key, &value, sizeof(value));
+}
+
+bool persist_read_bool(const uint32_t key) {
+  bool value = false;
+  persist_read_data(key, &value, sizeof(value));
+  return value;
+}
+
+status_t persist_write_bool(const uint32_t key, const bool value) {
+  return persist_write_data(key, &value, sizeof(value));
+}
+
+status_t persist_delete(const uint32_t key) {
+  for (PersistEntry **pp = &persist_entries; *pp != NULL; pp = &(*pp)->next) {
+    if ((*pp)->key == key) {
+      PersistEntry *e = *pp;
+      *pp = e->next;
+      free(e);
+      return S_TRUE;
+    }
+  }
+  return S_FALSE;
+}
+
+/*
+ * ------------------------------------------------------------------------------------------
+ * Data logging
+ */
+static void dlog_drain(void) {
+  if (bluetooth_connected) {
+    uint64_t drained = (now_ms - dlog_drained_at) * dlog_drain_rate / MS_PER_SECOND;
+    dlog_spooled = drained >= dlog_spooled ? 0 : dlog_spooled - (uint32_t) drained;
+  }
+  dlog_drained_at = now_ms;
+}
+
+void host_data_logging_set_spool(uint32_t spool_bytes, uint32_t drain_bytes_per_sec) {
+  dlog_drain();
+  dlog_spool_bytes = spool_bytes;
+  dlog_drain_rate = drain_bytes_per_sec;
+}
+
+const uint8_t *host_data_logging_bytes(uint32_t tag, size_t *length) {
+  for (DataLoggingEntry *e = dlog_entries; e != NULL; e = e->next) {
+    if (e->tag == tag) {
+      *length = e->length;
+      return e->bytes;
+    }
+  }
+  *length = 0;
+  return NULL;
+}
+
+uint32_t host_data_logging_spooled(void) {
+  dlog_drain();
+  return dlog_spooled;
+}
+
+/*
+ * A second session with the same tag carries on the same stream
+ */
+DataLoggingSessionRef data_logging_create(uint32_t tag, DataLoggingItemType item_type, uint16_t item_length, bool resume) {
+  DataLoggingEntry *e;
+  for (e = dlog_entries; e != NULL; e = e->next) {
+    if (e->tag == tag)
+      break;
+  }
+  if (e == NULL) {
+    e = calloc(1, sizeof(DataLoggingEntry));
+    e->tag = tag;
+    e->next = dlog_entries;
+    dlog_entries = e;
+  }
+  e->item_length = item_type == DATA_LOGGING_BYTE_ARRAY ? item_length : sizeof(uint32_t);
+  e->open = true;
+  return e;
+}
+
+void data_logging_finish(DataLoggingSessionRef logging_session) {
+  if (logging_session != NULL)
+    ((DataLoggingEntry *) logging_session)->open = false;
+}
+
+DataLoggingResult data_logging_log(DataLoggingSessionRef logging_session, const void *data, uint32_t num_items) {
+  DataLoggingEntry *e = logging_session;
+  if (e == NULL || data == NULL)
+    return DATA_LOGGING_INVALID_PARAMS;
+  if (!e->open)
+    return DATA_LOGGING_CLOSED;
+  size_t size = (size_t) e->item_length * num_items;
+  dlog_drain();
+  if (dlog_spooled + size > dlog_spool_bytes) {
+    host_stats.dlog_full++;
+    return DATA_LOGGING_FULL;
+  }
+  dlog_spooled += size;
+  if (dlog_spooled > host_stats.dlog_spool_max)
+    host_stats.dlog_spool_max = dlog_spooled;
+  e->bytes = realloc(e->bytes, e->length + size);
+  memcpy(e->bytes + e->length, data, size);
+  e->length += size;
+  host_stats.dlog_items += num_items;
+  host_stats.dlog_bytes += size;
+  return DATA_LOGGING_SUCCESS;
+}
+
+/*
+ * ------------------------------------------------------------------------------------------
+ * Dictionaries - same byte layout as the watch
+ */
+#define TUPLE_HEADER_SIZE (sizeof(Tuple))
+
+static uint16_t tuplet_length(const Tuplet *tuplet) {
+  switch (tuplet->type) {
+    case TUPLE_BYTE_ARRAY:
+      return tuplet->bytes.length;
+    case TUPLE_CSTRING:
+      return tuplet->cstring.length;
+    default:
+      return tuplet->integer.width;
+  }
+}
+
+uint32_t dict_calc_buffer_size(const uint8_t tuple_count, ...) {
+  uint32_t total = sizeof(Dictionary);
+  va_list args;
+  va_start(args, tuple_count);
+  for (uint8_t i = 0; i < tuple_count; i++) {
+    total += TUPLE_HEADER_SIZE + va_arg(args, uint32_t);
+  }
+  va_end(args);
+  return total;
+}
+
+uint32_t dict_calc_buffer_size_from_tuplets(const Tuplet * const tuplets, const uint8_t tuplets_count) {
+  uint32_t total = sizeof(Dictionary);
+  for (uint8_t i = 0; i < tuplets_count; i++) {
+    total += TUPLE_HEADER_SIZE + tuplet_length(&tuplets[i]);
+  }
+  return total;
+}
+
+DictionaryResult dict_write_begin(DictionaryIterator *iter, uint8_t * const buffer, const uint16_t size) {
+  if (iter == NULL || buffer == NULL || size < sizeof(Dictionary))
+    return DICT_INVALID_ARGS;
+  iter->dictionary = (Dictionary *) buffer;
+  iter->dictionary->count = 0;
+  iter->end = buffer + size;
+  iter->cursor = iter->dictionary->head;
+  return DICT_OK;
+}
+
+static DictionaryResult dict_write_raw(DictionaryIterator *iter, uint32_t key, TupleType type, const void *data, uint16_t length) {
+  if (iter == NULL || iter->dictionary == NULL)
+    return DICT_INVALID_ARGS;
+  uint8_t *cursor = (uint8_t *) iter->cursor;
+  if (cursor + TUPLE_HEADER_SIZE + length > (const uint8_t *) iter->end)
+    return DICT_NOT_ENOUGH_STORAGE;
+  Tuple *tuple = iter->cursor;
+  tuple->key = key;
+  tuple->type = type;
+  tuple->length = length;
+  memcpy(tuple->value->data, data, length);
+  iter->dictionary->count++;
+  iter->cursor = (Tuple *) (cursor + TUPLE_HEADER_SIZE + length);
+  return DICT_OK;
+}
+
+DictionaryResult dict_write_tuplet(DictionaryIterator *iter, const Tuplet * const tuplet) {
+  switch (tuplet->type) {
+    case TUPLE_BYTE_ARRAY:
+      return dict_write_raw(iter, tuplet->key, tuplet->type, tuplet->bytes.data, tuplet->bytes.length);
+    case TUPLE_CSTRING:
+      return dict_write_raw(iter, tuplet->key, tuplet->type, tuplet->cstring.data, tuplet->cstring.length);
+    default:
+      return dict_write_int(iter, tuplet->key, &tuplet->integer.storage, tuplet->integer.width, tuplet->type == TUPLE_INT);
+  }
+}
+
+DictionaryResult dict_write_data(DictionaryIterator *iter, const uint32_t key, const uint8_t * const data, const uint16_t size) {
+  return dict_write_raw(iter, key, TUPLE_BYTE_ARRAY, data, size);
+}
+
+/*
+ * Integers are little endian on both sides so the low bytes of the storage are the value
+ */
+DictionaryResult dict_write_int(DictionaryIterator *iter, const uint32_t key, const void *integer, const uint8_t width_bytes, const bool is_signed) {
+  if (width_bytes != 1 && width_bytes != 2 && width_bytes != 4)
+    return DICT_INVALID_ARGS;
+  return dict_write_raw(iter, key, is_signed ? TUPLE_INT : TUPLE_UINT, integer, width_bytes);
+}
+
+DictionaryResult dict_write_int32(DictionaryIterator *iter, const uint32_t key, const int32_t value) {
+  return dict_write_int(iter, key, &value, sizeof(value), true);
+}
+
+DictionaryResult dict_write_uint8(DictionaryIterator *iter, const uint32_t key, const uint8_t value) {
+  return dict_write_int(iter, key, &value, sizeof(value), false);
+}
+
+uint32_t dict_write_end(DictionaryIterator *iter) {
+  if (iter == NULL || iter->dictionary == NULL)
+    return 0;
+  iter->end = iter->cursor;
+  iter->cursor = iter->dictionary->head;
+  return (uint32_t) ((const uint8_t *) iter->end - (const uint8_t *) iter->dictionary);
+}
+
+Tuple *dict_read_begin_from_buffer(DictionaryIterator *iter, const uint8_t * const buffer, const uint16_t size) {
+  iter->dictionary = (Dictionary *) buffer;
+  iter->end = buffer + size;
+  iter->cursor = iter->dictionary->head;
+  return dict_read_first(iter);
+}
+
+Tuple *dict_read_first(DictionaryIterator *iter) {
+  iter->cursor = iter->dictionary->head;
+  if (iter->dictionary->count == 0 || (const void *) iter->cursor >= iter->end)
+    return NULL;
+  return iter->cursor;
+}
+
+Tuple *dict_read_next(DictionaryIterator *iter) {
+  uint8_t *next = (uint8_t *) iter->cursor + TUPLE_HEADER_SIZE + iter->cursor->length;
+  if ((const void *) next >= iter->end)
+    return NULL;
+  iter->cursor = (Tuple *) next;
+  return iter->cursor;
+}
+
+Tuple *dict_find(const DictionaryIterator *iter, const uint32_t key) {
+  DictionaryIterator it = *iter;
+  for (Tuple *t = dict_read_first(&it); t != NULL; t = dict_read_next(&it)) {
+    if (t->key == key)
+      return t;
+  }
+  return NULL;
+}
+
+/*
+ * ------------------------------------------------------------------------------------------
+ * AppMessage
+ */
+AppMessageResult app_message_open(const uint32_t size_inbound, const uint32_t size_outbound) {
+  if (message_open)
+    return APP_MSG_INVALID_STATE;
+  inbox_size = size_inbound;
+  outbox_size = size_outbound;
+  outbox_buffer = calloc(1, size_outbound);
+  message_open = true;
+  return APP_MSG_OK;
+}
+
+uint32_t app_message_inbox_size_maximum(void) {
+  return 2026;
+}
+
+uint32_t app_message_outbox_size_maximum(void) {
+  return 656;
+}
+
+AppMessageInboxReceived app_message_register_inbox_received(AppMessageInboxReceived received_callback) {
+  AppMessageInboxReceived previous = inbox_received;
+  inbox_received = received_callback;
+  return previous;
+}
+
+AppMessageInboxDropped app_message_register_inbox_dropped(AppMessageInboxDropped dropped_callback) {
+  AppMessageInboxDropped previous = inbox_dropped;
+  inbox_dropped = dropped_callback;
+  return previous;
+}
+
+AppMessageOutboxSent app_message_register_outbox_sent(AppMessageOutboxSent sent_callback) {
+  AppMessageOutboxSent previous = outbox_sent;
+  outbox_sent = sent_callback;
+  return previous;
+}
+
+AppMessageOutboxFailed app_message_register_outbox_failed(AppMessageOutboxFailed failed_callback) {
+  AppMessageOutboxFailed previous = outbox_failed;
+  outbox_failed = failed_callback;
+  return previous;
+}
+
+AppMessageResult app_message_outbox_begin(DictionaryIterator **iterator) {
+  *iterator = NULL;
+  if (!message_open)
+    return APP_MSG_INVALID_STATE;
+  if (outbox_state != OUTBOX_IDLE) {
+    host_stats.outbox_busy++;
+    return APP_MSG_BUSY;
+  }
+  dict_write_begin(&outbox_iter, outbox_buffer, outbox_size);
+  outbox_state = OUTBOX_BEGUN;
+  *iterator = &outbox_iter;
+  return APP_MSG_OK;
+}
+
+AppMessageResult app_message_outbox_send(void) {
+  if (outbox_state != OUTBOX_BEGUN)
+    return APP_MSG_INVALID_STATE;
+  outbox_state = OUTBOX_SENDING;
+  outbox_due = now_ms + link_latency_ms;
+  outbox_result = bluetooth_connected ? APP_MSG_OK : APP_MSG_NOT_CONNECTED;
+  host_stats.messages_sent++;
+  host_stats.message_bytes_sent += (uint32_t) ((const uint8_t *) outbox_iter.end - outbox_buffer);
+  return APP_MSG_OK;
+}
+
+/*
+ * The phone has the message - it decides the ACK/NACK, then the app is told
+ */
+static void dispatch_outbox() {
+  DictionaryIterator iter;
+  dict_read_begin_from_buffer(&iter, outbox_buffer, (uint16_t) ((const uint8_t *) outbox_iter.end - outbox_buffer));
+  AppMessageResult result = outbox_result;
+  if (result == APP_MSG_OK && phone_handler != NULL) {
+    result = phone_handler(&iter, phone_context);
+  }
+  outbox_state = OUTBOX_IDLE;
+  dict_read_first(&iter);
+  if (result == APP_MSG_OK) {
+    host_stats.messages_acked++;
+    if (outbox_sent != NULL)
+      outbox_sent(&iter, NULL);
+  } else {
+    host_stats.messages_failed++;
+    if (outbox_failed != NULL)
+      outbox_failed(&iter, result, NULL);
+  }
+}
+
+void host_phone_set_handler(HostPhoneHandler handler, void *context) {
+  phone_handler = handler;
+  phone_context = context;
+}
+
+void host_phone_set_latency_ms(uint32_t latency_ms) {
+  link_latency_ms = latency_ms;
+}
+
+/*
+ * Queue a message from the phone to arrive after the link latency
+ */
+void host_phone_send_tuplets(const Tuplet *tuplets, uint8_t count) {
+  InboxEntry *entry = calloc(1, sizeof(InboxEntry));
+  entry->size = dict_calc_buffer_size_from_tuplets(tuplets, count);
+  entry->buffer = calloc(1, entry->size);
+  entry->due = now_ms + link_latency_ms;
+  DictionaryIterator iter;
+  dict_write_begin(&iter, entry->buffer, entry->size);
+  for (uint8_t i = 0; i < count; i++) {
+    dict_write_tuplet(&iter, &tuplets[i]);
+  }
+  dict_write_end(&iter);
+  InboxEntry **pp = &inbox_queue;
+  while (*pp != NULL && (*pp)->due <= entry->due) {
+    pp = &(*pp)->next;
+  }
+  entry->next = *pp;
+  *pp = entry;
+}
+
+static void dispatch_inbox() {
+  InboxEntry *entry = inbox_queue;
+  inbox_queue = entry->next;
+  if (!message_open || entry->size > inbox_size) {
+    if (inbox_dropped != NULL)
+      inbox_dropped(message_open ? APP_MSG_BUFFER_OVERFLOW : APP_MSG_APP_NOT_RUNNING, NULL);
+  } else if (inbox_received != NULL) {
+    DictionaryIterator iter;
+    dict_read_begin_from_buffer(&iter, entry->buffer, entry->size);
+    host_stats.messages_received++;
+    inbox_received(&iter, NULL);
+  }
+  free(entry->buffer);
+  free(entry);
+}
+
+/*
+ * ------------------------------------------------------------------------------------------
+ * Wakeup and launch
+ */
+void wakeup_service_subscribe(WakeupHandler handler) {
+  wakeup_handler = handler;
+}
+
+/*
+ * Same rules as the watch - nothing in the past, nothing within a minute of another wakeup
+ */
+WakeupId wakeup_schedule(time_t timestamp, int32_t cookie, bool notify_if_missed) {
+  if (timestamp < host_time(NULL))
+    return E_INVALID_ARGUMENT;
+  int8_t free_slot = -1;
+  for (uint8_t i = 0; i < MAX_WAKEUPS; i++) {
+    if (wakeups[i].used) {
+      time_t diff = wakeups[i].timestamp - timestamp;
+      if (diff < WAKEUP_CLASH_SECONDS && diff > -WAKEUP_CLASH_SECONDS)
+        return E_RANGE;
+    } else if (free_slot < 0) {
+      free_slot = i;
+    }
+  }
+  if (free_slot < 0)
+    return E_OUT_OF_RESOURCES;
+  wakeups[free_slot].used = true;
+  wakeups[free_slot].id = wakeup_next_id++;
+  wakeups[free_slot].timestamp = timestamp;
+  wakeups[free_slot].cookie = cookie;
+  return wakeups[free_slot].id;
+}
+
+void wakeup_cancel(WakeupId wakeup_id) {
+  for (uint8_t i = 0; i < MAX_WAKEUPS; i++) {
+    if (wakeups[i].used && wakeups[i].id == wakeup_id)
+      wakeups[i].used = false;
+  }
+}
+
+void wakeup_cancel_all(void) {
+  for (uint8_t i = 0; i < MAX_WAKEUPS; i++) {
+    wakeups[i].used = false;
+  }
+}
+
+bool wakeup_query(WakeupId wakeup_id, time_t *timestamp) {
+  for (uint8_t i = 0; i < MAX_WAKEUPS; i++) {
+    if (wakeups[i].used && wakeups[i].id == wakeup_id) {
+      if (timestamp != NULL)
+        *timestamp = wakeups[i].timestamp;
+      return true;
+    }
+  }
+  return false;
+}
+
+bool wakeup_get_launch_event(WakeupId *wakeup_id, int32_t *cookie) {
+  *wakeup_id = launch_wakeup_id;
+  *cookie = launch_cookie;
+  return launch_wakeup_id >= 0;
+}
+
+/*
+ * Wakeup while running goes to the handler
+ */
+static void dispatch_wakeup() {
+  uint8_t first = 0;
+  for (uint8_t i = 0; i < MAX_WAKEUPS; i++) {
+    if (wakeups[i].used && (!wakeups[first].used || wakeups[i].timestamp < wakeups[first].timestamp))
+      first = i;
+  }
+  wakeups[first].used = false;
+  host_stats.wakeups_fired++;
+  if (wakeup_handler != NULL)
+    wakeup_handler(wakeups[first].id, wakeups[first].cookie);
+}
+
+uint8_t host_wakeup_list(HostWakeup *list, uint8_t max) {
+  uint8_t count = 0;
+  for (uint8_t i = 0; i < MAX_WAKEUPS && count < max; i++) {
+    if (wakeups[i].used) {
+      list[count].id = wakeups[i].id;
+      list[count].timestamp = wakeups[i].timestamp;
+      list[count].cookie = wakeups[i].cookie;
+      count++;
+    }
+  }
+  return count;
+}
+
+AppLaunchReason launch_reason(void) {
+  return host_launch_reason;
+}
+
+uint32_t launch_get_args(void) {
+  return host_launch_args;
+}
+
+void host_set_launch(AppLaunchReason reason, uint32_t args) {
+  host_launch_reason = reason;
+  host_launch_args = args;
+}
+
+void host_set_wakeup_launch(WakeupId wakeup_id, int32_t cookie) {
+  host_launch_reason = APP_LAUNCH_WAKEUP;
+  launch_wakeup_id = wakeup_id;
+  launch_cookie = cookie;
+}
+
+void host_set_event_loop(HostEventLoop loop) {
+  event_loop = loop;
+}
+
+void app_event_loop(void) {
+  render_if_dirty();
+  if (event_loop != NULL)
+    event_loop();
+}
+
+/*
+ * ------------------------------------------------------------------------------------------
+ * Geometry and trig
+ */
+GPoint grect_center_point(const GRect *rect) {
+  return GPoint(rect->origin.x + rect->size.w / 2, rect->origin.y + rect->size.h / 2);
+}
+
+GRect grect_inset(GRect rect, GEdgeInsets insets) {
+  return GRect(rect.origin.x + insets.left, rect.origin.y + insets.top, rect.size.w - insets.left - insets.right, rect.size.h - insets.top - insets.bottom);
+}
+
+int32_t sin_lookup(int32_t angle) {
+  return (int32_t) lround(sin(2.0 * M_PI * (double) angle / TRIG_MAX_ANGLE) * TRIG_MAX_RATIO);
+}
+
+int32_t cos_lookup(int32_t angle) {
+  return (int32_t) lround(cos(2.0 * M_PI * (double) angle / TRIG_MAX_ANGLE) * TRIG_MAX_RATIO);
+}
+
+GPoint gpoint_from_polar(GRect container, GOvalScaleMode scale_mode, int32_t angle) {
+  int32_t w = container.size.w - 1;
+  int32_t h = container.size.h - 1;
+  int32_t radius = (scale_mode == GOvalScaleModeFitCircle ? (w < h ? w : h) : (w > h ? w : h)) / 2;
+  return GPoint(container.origin.x + w / 2 + sin_lookup(angle) * radius / TRIG_MAX_RATIO,
+                container.origin.y + h / 2 - cos_lookup(angle) * radius / TRIG_MAX_RATIO);
+}
+
+/*
+ * ------------------------------------------------------------------------------------------
+ * Resources, bitmaps and fonts
+ */
+static const char *resource_file(uint32_t resource_id) {
+  if (resource_id == 0 || resource_id >= host_resource_count)
+    return NULL;
+  return host_resource_files[resource_id];
+}
+
+ResHandle resource_get_handle(uint32_t resource_id) {
+  return (ResHandle) (uintptr_t) resource_id;
+}
+
+size_t resource_size(ResHandle h) {
+  const char *file = resource_file((uint32_t) (uintptr_t) h);
+  FILE *f = file == NULL ? NULL : fopen(file, "rb");
+  if (f == NULL)
+    return 0;
+  fseek(f, 0, SEEK_END);
+  size_t size = ftell(f);
+  fclose(f);
+  return size;
+}
+
+size_t resource_load(ResHandle h, uint8_t *buffer, size_t max_length) {
+  const char *file = resource_file((uint32_t) (uintptr_t) h);
+  FILE *f = file == NULL ? NULL : fopen(file, "rb");
+  host_stats.resource_loads++;
+  if (f == NULL)
+    return 0;
+  size_t read = fread(buffer, 1, max_length, f);
+  fclose(f);
+  return read;
+}
+
+/*
+ * Width and height from the PNG header are all the host needs of an image
+ */
+static GSize png_size(const char *file) {
+  uint8_t header[24];
+  FILE *f = file == NULL ? NULL : fopen(file, "rb");
+  if (f == NULL)
+    return GSize(0, 0);
+  size_t read = fread(header, 1, sizeof(header), f);
+  fclose(f);
+  if (read != sizeof(header))
+    return GSize(0, 0);
+  return GSize((header[18] << 8) | header[19], (header[22] << 8) | header[23]);
+}
+
+GBitmap *gbitmap_create_with_resource(uint32_t resource_id) {
+  GBitmap *bitmap = calloc(1, sizeof(GBitmap));
+  GSize size = png_size(resource_file(resource_id));
+  bitmap->bounds = GRect(0, 0, size.w, size.h);
+  host_stats.resource_loads++;
+  host_stats.bitmaps_created++;
+  return bitmap;
+}
+
+/*
+ * Rows of 1 bit bitmaps are word aligned as on the watch
+ */
+GBitmap *gbitmap_create_blank(GSize size, GBitmapFormat format) {
+  GBitmap *bitmap = calloc(1, sizeof(GBitmap));
+  bitmap->bounds = GRect(0, 0, size.w, size.h);
+  bitmap->format = format;
+  bitmap->row_size = format == GBitmapFormat1Bit ? (size.w + 31) / 32 * 4 : size.w;
+  bitmap->data = calloc(1, (size_t) bitmap->row_size * size.h);
+  host_stats.bitmaps_created++;
+  return bitmap;
+}
+
+GBitmap *gbitmap_create_as_sub_bitmap(const GBitmap *base_bitmap, GRect sub_rect) {
+  GBitmap *bitmap = calloc(1, sizeof(GBitmap));
+  bitmap->bounds = sub_rect;
+  bitmap->parent = base_bitmap;
+  host_stats.bitmaps_created++;
+  return bitmap;
+}
+
+GRect gbitmap_get_bounds(const GBitmap *bitmap) {
+  return bitmap->bounds;
+}
+
+void gbitmap_set_bounds(GBitmap *bitmap, GRect bounds) {
+  bitmap->bounds = bounds;
+}
+
+GBitmapFormat gbitmap_get_format(const GBitmap *bitmap) {
+  return bitmap->format;
+}
+
+uint16_t gbitmap_get_bytes_per_row(const GBitmap *bitmap) {
+  return bitmap->row_size;
+}
+
+uint8_t *gbitmap_get_data(const GBitmap *bitmap) {
+  return bitmap->data;
+}
+
+/*
+ * Every row is whole - the frame buffer here is rectangular even on chalk
+ */
+GBitmapDataRowInfo gbitmap_get_data_row_info(const GBitmap *bitmap, uint16_t y) {
+  return (GBitmapDataRowInfo) { bitmap->data + y * bitmap->row_size, 0, bitmap->bounds.size.w - 1 };
+}
+
+void gbitmap_destroy(GBitmap *bitmap) {
+  if (bitmap == NULL)
+    return;
+  free(bitmap->data);
+  free(bitmap);
+}
+
+GFont fonts_get_system_font(const char *font_key) {
+  return &system_font;
+}
+
+GFont fonts_load_custom_font(ResHandle handle) {
+  host_stats.resource_loads++;
+  return &custom_font;
+}
+
+void fonts_unload_custom_font(GFont font) {
+}
+
+/*
+ * ------------------------------------------------------------------------------------------
+ * Graphics - state is tracked, drawing is counted
+ */
+void graphics_context_set_fill_color(GContext *ctx, GColor color) {
+  ctx->fill_color = color;
+}
+
+void graphics_context_set_stroke_color(GContext *ctx, GColor color) {
+  ctx->stroke_color = color;
+}
+
+void graphics_context_set_stroke_width(GContext *ctx, uint8_t stroke_width) {
+  ctx->stroke_width = stroke_width;
+}
+
+void graphics_context_set_text_color(GContext *ctx, GColor color) {
+  ctx->text_color = color;
+}
+
+void graphics_context_set_compositing_mode(GContext *ctx, GCompOp mode) {
+  ctx->mode = mode;
+}
+
+void graphics_context_set_antialiased(GContext *ctx, bool enable) {
+  ctx->antialiased = enable;
+}
+
+void graphics_draw_pixel(GContext *ctx, GPoint point) {
+  host_stats.draw_calls++;
+}
+
+void graphics_draw_line(GContext *ctx, GPoint p0, GPoint p1) {
+  host_stats.draw_calls++;
+}
+
+void graphics_fill_rect(GContext *ctx, GRect rect, uint16_t corner_radius, GCornerMask corner_mask) {
+  host_stats.draw_calls++;
+}
+
+void graphics_fill_circle(GContext *ctx, GPoint p, uint16_t radius) {
+  host_stats.draw_calls++;
+}
+
+void graphics_draw_bitmap_in_rect(GContext *ctx, const GBitmap *bitmap, GRect rect) {
+  host_stats.draw_calls++;
+}
+
+/*
+ * One frame buffer for the life of the process - nothing is drawn into it, but it can be
+ * captured, copied from and released like the real one
+ */
+GBitmap *graphics_capture_frame_buffer(GContext *ctx) {
+  static GBitmap *frame_buffer;
+  if (frame_buffer == NULL) {
+    frame_buffer = gbitmap_create_blank(GSize(PBL_DISPLAY_WIDTH, PBL_DISPLAY_HEIGHT), PBL_IF_COLOR_ELSE(GBitmapFormat8Bit, GBitmapFormat1Bit));
+    host_stats.bitmaps_created--;
+  }
+  host_stats.frame_buffer_captures++;
+  return frame_buffer;
+}
+
+bool graphics_release_frame_buffer(GContext *ctx, GBitmap *buffer) {
+  return true;
+}
+
+void graphics_draw_text(GContext *ctx, const char *text, GFont const font, const GRect box, const GTextOverflowMode overflow_mode, const GTextAlignment alignment, void *text_attributes) {
+  host_stats.draw_calls++;
+}
+
+GPath *gpath_create(const GPathInfo *init) {
+  GPath *path = calloc(1, sizeof(GPath));
+  path->info = *init;
+  return path;
+}
+
+void gpath_destroy(GPath *path) {
+  free(path);
+}
+
+void gpath_rotate_to(GPath *path, int32_t angle) {
+  path->rotation = angle;
+}
+
+void gpath_move_to(GPath *path, GPoint point) {
+  path->offset = point;
+}
+
+void gpath_draw_filled(GContext *ctx, GPath *path) {
+  host_stats.draw_calls++;
+}
+
+void gpath_draw_outline(GContext *ctx, GPath *path) {
+  host_stats.draw_calls++;
+}
+
+/*
+ * ------------------------------------------------------------------------------------------
+ * Layers
+ */
+static void layer_init(Layer *layer, GRect frame) {
+  memset(layer, 0, sizeof(Layer));
+  layer->frame = frame;
+  layer->bounds = GRect(0, 0, frame.size.w, frame.size.h);
+  layer->dirty = true;
+}
+
+Layer *layer_create(GRect frame) {
+  Layer *layer = malloc(sizeof(Layer));
+  layer_init(layer, frame);
+  return layer;
+}
+
+static void layer_remove_from_parent(Layer *layer) {
+  if (layer->parent == NULL)
+    return;
+  for (Layer **pp = &layer->parent->first_child; *pp != NULL; pp = &(*pp)->next_sibling) {
+    if (*pp == layer) {
+      *pp = layer->next_sibling;
+      break;
+    }
+  }
+  layer->parent->dirty = true;
+  layer->parent = NULL;
+  layer->next_sibling = NULL;
+}
+
+/*
+ * Children outlive their parent on the watch too - they are just orphaned
+ */
+static void layer_deinit(Layer *layer) {
+  layer_remove_from_parent(layer);
+  for (Layer *child = layer->first_child; child != NULL;) {
+    Layer *next = child->next_sibling;
+    child->parent = NULL;
+    child->next_sibling = NULL;
+    child = next;
+  }
+}
+
+void layer_destroy(Layer *layer) {
+  if (layer == NULL)
+    return;
+  layer_deinit(layer);
+  free(layer);
+}
+
+void layer_mark_dirty(Layer *layer) {
+  layer->dirty = true;
+}
+
+void layer_set_update_proc(Layer *layer, LayerUpdateProc update_proc) {
+  layer->update_proc = update_proc;
+}
+
+void layer_add_child(Layer *parent, Layer *child) {
+  layer_remove_from_parent(child);
+  child->parent = parent;
+  Layer **pp = &parent->first_child;
+  while (*pp != NULL) {
+    pp = &(*pp)->next_sibling;
+  }
+  *pp = child;
+  child->dirty = true;
+}
+
+void layer_set_hidden(Layer *layer, bool hidden) {
+  if (layer->hidden != hidden) {
+    layer->hidden = hidden;
+    layer->dirty = true;
+    if (layer->parent != NULL)
+      layer->parent->dirty = true;
+  }
+}
+
+bool layer_get_hidden(const Layer *layer) {
+  return layer->hidden;
+}
+
+void layer_set_frame(Layer *layer, GRect frame) {
+  layer->frame = frame;
+  layer->bounds.size = frame.size;
+  layer->dirty = true;
+}
+
+GRect layer_get_frame(const Layer *layer) {
+  return layer->frame;
+}
+
+GRect layer_get_bounds(const Layer *layer) {
+  return layer->bounds;
+}
+
+/*
+ * Built in layers draw themselves
+ */
+static void text_layer_update(Layer *layer, GContext *ctx) {
+  TextLayer *text_layer = (TextLayer *) layer;
+  if (text_layer->text != NULL)
+    graphics_draw_text(ctx, text_layer->text, text_layer->font, layer->bounds, GTextOverflowModeWordWrap, text_layer->alignment, NULL);
+}
+
+static void bitmap_layer_update(Layer *layer, GContext *ctx) {
+  BitmapLayer *bitmap_layer = (BitmapLayer *) layer;
+  if (bitmap_layer->bitmap != NULL)
+    graphics_draw_bitmap_in_rect(ctx, bitmap_layer->bitmap, layer->bounds);
+}
+
+TextLayer *text_layer_create(GRect frame) {
+  TextLayer *text_layer = calloc(1, sizeof(TextLayer));
+  layer_init(&text_layer->layer, frame);
+  text_layer->layer.update_proc = text_layer_update;
+  text_layer->font = &system_font;
+  return text_layer;
+}
+
+void text_layer_destroy(TextLayer *text_layer) {
+  if (text_layer == NULL)
+    return;
+  layer_deinit(&text_layer->layer);
+  free(text_layer);
+}
+
+Layer *text_layer_get_layer(TextLayer *text_layer) {
+  return &text_layer->layer;
+}
+
+void text_layer_set_text(TextLayer *text_layer, const char *text) {
+  text_layer->text = text;
+  text_layer->layer.dirty = true;
+}
+
+const char *text_layer_get_text(TextLayer *text_layer) {
+  return text_layer->text;
+}
+
+void text_layer_set_text_color(TextLayer *text_layer, GColor color) {
+  text_layer->text_color = color;
+  text_layer->layer.dirty = true;
+}
+
+void text_layer_set_background_color(TextLayer *text_layer, GColor color) {
+  text_layer->background_color = color;
+  text_layer->layer.dirty = true;
+}
+
+void text_layer_set_text_alignment(TextLayer *text_layer, GTextAlignment text_alignment) {
+  text_layer->alignment = text_alignment;
+  text_layer->layer.dirty = true;
+}
+
+void text_layer_set_font(TextLayer *text_layer, GFont font) {
+  text_layer->font = font;
+  text_layer->layer.dirty = true;
+}
+
+BitmapLayer *bitmap_layer_create(GRect frame) {
+  BitmapLayer *bitmap_layer = calloc(1, sizeof(BitmapLayer));
+  layer_init(&bitmap_layer->layer, frame);
+  bitmap_layer->layer.update_proc = bitmap_layer_update;
+  return bitmap_layer;
+}
+
+void bitmap_layer_destroy(BitmapLayer *bitmap_layer) {
+  if (bitmap_layer == NULL)
+    return;
+  layer_deinit(&bitmap_layer->layer);
+  free(bitmap_layer);
+}
+
+Layer *bitmap_layer_get_layer(const BitmapLayer *bitmap_layer) {
+  return (Layer *) &bitmap_layer->layer;
+}
+
+void bitmap_layer_set_bitmap(BitmapLayer *bitmap_layer, const GBitmap *bitmap) {
+  bitmap_layer->bitmap = bitmap;
+  bitmap_layer->layer.dirty = true;
+}
+
+void bitmap_layer_set_compositing_mode(BitmapLayer *bitmap_layer, GCompOp mode) {
+  bitmap_layer->mode = mode;
+  bitmap_layer->layer.dirty = true;
+}
+
+/*
+ * ------------------------------------------------------------------------------------------
+ * Rendering - as on the watch, anything dirty in the top window redraws the whole window
+ */
+static bool tree_dirty(Layer *layer) {
+  if (layer->dirty)
+    return true;
+  for (Layer *child = layer->first_child; child != NULL; child = child->next_sibling) {
+    if (tree_dirty(child))
+      return true;
+  }
+  return false;
+}
+
+static void clear_dirty(Layer *layer) {
+  layer->dirty = false;
+  for (Layer *child = layer->first_child; child != NULL; child = child->next_sibling) {
+    clear_dirty(child);
+  }
+}
+
+static void render_tree(Layer *layer, GContext *ctx) {
+  if (layer->hidden) {
+    clear_dirty(layer);
+    return;
+  }
+  layer->dirty = false;
+  if (layer->update_proc != NULL) {
+    host_stats.layer_updates++;
+    layer->update_proc(layer, ctx);
+  }
+  for (Layer *child = layer->first_child; child != NULL; child = child->next_sibling) {
+    render_tree(child, ctx);
+  }
+}
+
+void host_render(void) {
+  if (window_count == 0)
+    return;
+  GContext ctx;
+  memset(&ctx, 0, sizeof(ctx));
+  ctx.stroke_width = 1;
+  ctx.antialiased = PBL_IF_COLOR_ELSE(true, false);
+  host_stats.frames++;
+  render_tree(&window_stack[window_count - 1]->root, &ctx);
+}
+
+static void render_if_dirty() {
+  if (render_enabled && window_count > 0 && tree_dirty(&window_stack[window_count - 1]->root))
+    host_render();
+}
+
+void host_set_render(bool enabled) {
+  render_enabled = enabled;
+}
+
+/*
+ * ------------------------------------------------------------------------------------------
+ * Windows and clicks
+ */
+Window *window_create(void) {
+  Window *window = calloc(1, sizeof(Window));
+  layer_init(&window->root, GRect(0, 0, PBL_DISPLAY_WIDTH, PBL_DISPLAY_HEIGHT));
+  window->root.window = window;
+  return window;
+}
+
+void window_destroy(Window *window) {
+  if (window == NULL)
+    return;
+  window_stack_remove(window, false);
+  layer_deinit(&window->root);
+  free(window);
+}
+
+void window_set_window_handlers(Window *window, WindowHandlers handlers) {
+  window->handlers = handlers;
+}
+
+void window_set_background_color(Window *window, GColor background_color) {
+  window->background_color = background_color;
+  window->root.dirty = true;
+}
+
+Layer *window_get_root_layer(const Window *window) {
+  return (Layer *) &window->root;
+}
+
+/*
+ * Click subscriptions are made while the provider runs for a window
+ */
+static void configure_clicks(Window *window) {
+  memset(window->buttons, 0, sizeof(window->buttons));
+  configuring_window = window;
+  if (window->click_config_provider != NULL)
+    window->click_config_provider(window->click_context != NULL ? window->click_context : window);
+  configuring_window = NULL;
+}
+
+void window_set_click_config_provider(Window *window, ClickConfigProvider click_config_provider) {
+  window_set_click_config_provider_with_context(window, click_config_provider, NULL);
+}
+
+void window_set_click_config_provider_with_context(Window *window, ClickConfigProvider click_config_provider, void *context) {
+  window->click_config_provider = click_config_provider;
+  window->click_context = context;
+  configure_clicks(window);
+}
+
+void window_single_click_subscribe(ButtonId button_id, ClickHandler handler) {
+  if (configuring_window != NULL)
+    configuring_window->buttons[button_id].single = handler;
+}
+
+void window_long_click_subscribe(ButtonId button_id, uint16_t delay_ms, ClickHandler down_handler, ClickHandler up_handler) {
+  if (configuring_window != NULL) {
+    configuring_window->buttons[button_id].long_down = down_handler;
+    configuring_window->buttons[button_id].long_up = up_handler;
+  }
+}
+
+Window *window_stack_get_top_window(void) {
+  return window_count == 0 ? NULL : window_stack[window_count - 1];
+}
+
+void window_stack_push(Window *window, bool animated) {
+  if (window_count >= MAX_WINDOWS)
+    return;
+  Window *previous = window_stack_get_top_window();
+  if (previous != NULL && previous->handlers.disappear != NULL)
+    previous->handlers.disappear(previous);
+  window_stack[window_count++] = window;
+  if (!window->loaded) {
+    window->loaded = true;
+    if (window->handlers.load != NULL)
+      window->handlers.load(window);
+  }
+  if (window->handlers.appear != NULL)
+    window->handlers.appear(window);
+  window->root.dirty = true;
+}
+
+bool window_stack_remove(Window *window, bool animated) {
+  for (uint8_t i = 0; i < window_count; i++) {
+    if (window_stack[i] == window) {
+      bool was_top = (i == window_count - 1);
+      if (was_top && window->handlers.disappear != NULL)
+        window->handlers.disappear(window);
+      memmove(&window_stack[i], &window_stack[i + 1], (window_count - i - 1) * sizeof(Window *));
+      window_count--;
+      if (window->loaded) {
+        window->loaded = false;
+        if (window->handlers.unload != NULL)
+          window->handlers.unload(window);
+      }
+      Window *top = window_stack_get_top_window();
+      if (was_top && top != NULL) {
+        if (top->handlers.appear != NULL)
+          top->handlers.appear(top);
+        top->root.dirty = true;
+      }
+      return true;
+    }
+  }
+  return false;
+}
+
+/*
+ * Back with no handler pops the window, as on the watch
+ */
+void host_button_click(ButtonId button_id) {
+  Window *top = window_stack_get_top_window();
+  if (top == NULL)
+    return;
+  if (top->buttons[button_id].single != NULL) {
+    top->buttons[button_id].single(NULL, top->click_context != NULL ? top->click_context : top);
+  } else if (button_id == BUTTON_ID_BACK) {
+    window_stack_remove(top, true);
+  }
+  render_if_dirty();
+}
+
+void host_button_long_click(ButtonId button_id) {
+  Window *top = window_stack_get_top_window();
+  if (top == NULL)
+    return;
+  void *context = top->click_context != NULL ? top->click_context : top;
+  if (top->buttons[button_id].long_down != NULL)
+    top->buttons[button_id].long_down(NULL, context);
+  if (top->buttons[button_id].long_up != NULL)
+    top->buttons[button_id].long_up(NULL, context);
+  render_if_dirty();
+}
+
+/*
+ * ------------------------------------------------------------------------------------------
+ * Menus
+ */
+static void menu_layer_update(Layer *layer, GContext *ctx) {
+  MenuLayer *menu_layer = (MenuLayer *) layer;
+  if (menu_layer->callbacks.get_num_rows == NULL)
+    return;
+  uint16_t sections = menu_layer->callbacks.get_num_sections != NULL ? menu_layer->callbacks.get_num_sections(menu_layer, menu_layer->context) : 1;
+  for (uint16_t s = 0; s < sections; s++) {
+    if (menu_layer->callbacks.draw_header != NULL)
+      menu_layer->callbacks.draw_header(ctx, layer, s, menu_layer->context);
+    uint16_t rows = menu_layer->callbacks.get_num_rows(menu_layer, s, menu_layer->context);
+    for (uint16_t r = 0; r < rows; r++) {
+      MenuIndex index = { s, r };
+      if (menu_layer->callbacks.draw_row != NULL)
+        menu_layer->callbacks.draw_row(ctx, layer, &index, menu_layer->context);
+    }
+  }
+}
+
+MenuLayer *menu_layer_create(GRect frame) {
+  MenuLayer *menu_layer = calloc(1, sizeof(MenuLayer));
+  layer_init(&menu_layer->layer, frame);
+  menu_layer->layer.update_proc = menu_layer_update;
+  return menu_layer;
+}
+
+void menu_layer_destroy(MenuLayer *menu_layer) {
+  if (menu_layer == NULL)
+    return;
+  for (uint8_t i = 0; i < window_count; i++) {
+    if (window_stack[i]->menu == menu_layer)
+      window_stack[i]->menu = NULL;
+  }
+  layer_deinit(&menu_layer->layer);
+  free(menu_layer);
+}
+
+Layer *menu_layer_get_layer(const MenuLayer *menu_layer) {
+  return (Layer *) &menu_layer->layer;
+}
+
+void menu_layer_set_callbacks(MenuLayer *menu_layer, void *callback_context, MenuLayerCallbacks callbacks) {
+  menu_layer->callbacks = callbacks;
+  menu_layer->context = callback_context;
+  menu_layer->layer.dirty = true;
+}
+
+static uint16_t menu_rows(MenuLayer *menu_layer) {
+  return menu_layer->callbacks.get_num_rows == NULL ? 0 : menu_layer->callbacks.get_num_rows(menu_layer, menu_layer->selected.section, menu_layer->context);
+}
+
+static void menu_up(ClickRecognizerRef recognizer, void *context) {
+  MenuLayer *menu_layer = ((Window *) context)->menu;
+  if (menu_layer != NULL && menu_layer->selected.row > 0) {
+    menu_layer->selected.row--;
+    menu_layer->layer.dirty = true;
+  }
+}
+
+static void menu_down(ClickRecognizerRef recognizer, void *context) {
+  MenuLayer *menu_layer = ((Window *) context)->menu;
+  if (menu_layer != NULL && menu_layer->selected.row + 1 < menu_rows(menu_layer)) {
+    menu_layer->selected.row++;
+    menu_layer->layer.dirty = true;
+  }
+}
+
+static void menu_select(ClickRecognizerRef recognizer, void *context) {
+  MenuLayer *menu_layer = ((Window *) context)->menu;
+  if (menu_layer != NULL && menu_layer->callbacks.select_click != NULL)
+    menu_layer->callbacks.select_click(menu_layer, &menu_layer->selected, menu_layer->context);
+}
+
+static void menu_select_long(ClickRecognizerRef recognizer, void *context) {
+  MenuLayer *menu_layer = ((Window *) context)->menu;
+  if (menu_layer != NULL && menu_layer->callbacks.select_long_click != NULL)
+    menu_layer->callbacks.select_long_click(menu_layer, &menu_layer->selected, menu_layer->context);
+}
+
+static void menu_click_config_provider(void *context) {
+  window_single_click_subscribe(BUTTON_ID_UP, menu_up);
+  window_single_click_subscribe(BUTTON_ID_DOWN, menu_down);
+  window_single_click_subscribe(BUTTON_ID_SELECT, menu_select);
+  window_long_click_subscribe(BUTTON_ID_SELECT, 0, menu_select_long, NULL);
+}
+
+void menu_layer_set_click_config_onto_window(MenuLayer *menu_layer, Window *window) {
+  window->menu = menu_layer;
+  window_set_click_config_provider_with_context(window, menu_click_config_provider, window);
+}
+
+MenuIndex menu_layer_get_selected_index(const MenuLayer *menu_layer) {
+  return menu_layer->selected;
+}
+
+void menu_layer_set_center_focused(MenuLayer *menu_layer, bool center_focused) {
+}
+
+void menu_layer_set_normal_colors(MenuLayer *menu_layer, GColor background, GColor foreground) {
+}
+
+void menu_layer_set_highlight_colors(MenuLayer *menu_layer, GColor background, GColor foreground) {
+}
+
+void menu_cell_basic_draw(GContext *ctx, const Layer *cell_layer, const char *title, const char *subtitle, GBitmap *icon) {
+  host_stats.draw_calls++;
+}
+
+/*
+ * ------------------------------------------------------------------------------------------
+ * Animation - runs to completion on the virtual clock then destroys itself (SDK 3 behaviour)
+ */
+PropertyAnimation *property_animation_create_layer_frame(Layer *layer, GRect *from_frame, GRect *to_frame) {
+  PropertyAnimation *property_animation = calloc(1, sizeof(PropertyAnimation));
+  Animation *animation = &property_animation->animation;
+  animation->layer = layer;
+  animation->from_frame = from_frame != NULL ? *from_frame : layer->frame;
+  animation->to_frame = to_frame != NULL ? *to_frame : layer->frame;
+  animation->duration = 250;
+  return property_animation;
+}
+
+void animation_set_duration(Animation *animation, uint32_t duration_ms) {
+  animation->duration = duration_ms;
+}
+
+void animation_set_handlers(Animation *animation, AnimationHandlers callbacks, void *context) {
+  animation->handlers = callbacks;
+  animation->context = context;
+}
+
+static void animation_complete(void *data) {
+  Animation *animation = data;
+  layer_set_frame(animation->layer, animation->to_frame);
+  if (animation->handlers.stopped != NULL)
+    animation->handlers.stopped(animation, true, animation->context);
+  free(animation);
+}
+
+bool animation_schedule(Animation *animation) {
+  layer_set_frame(animation->layer, animation->from_frame);
+  if (animation->handlers.started != NULL)
+    animation->handlers.started(animation, animation->context);
+  timer_add(animation->duration, animation_complete, animation, true);
+  return true;
+}
+
+/*
+ * ------------------------------------------------------------------------------------------
+ * Dictation - the driver decides what was "heard"
+ */
+DictationSession *dictation_session_create(uint32_t buffer_size, DictationSessionStatusCallback callback, void *callback_context) {
+  DictationSession *session = calloc(1, sizeof(DictationSession));
+  session->callback = callback;
+  session->context = callback_context;
+  return session;
+}
+
+void dictation_session_destroy(DictationSession *session) {
+  free(session);
+}
+
+void dictation_session_enable_confirmation(DictationSession *session, bool is_enabled) {
+}
+
+void dictation_session_enable_error_dialogs(DictationSession *session, bool is_enabled) {
+}
+
+static void dictation_complete(void *data) {
+  DictationSession *session = data;
+  session->callback(session, dictation_status, dictation_status == DictationSessionStatusSuccess ? dictation_text : NULL, session->context);
+}
+
+DictationSessionStatus dictation_session_start(DictationSession *session) {
+  timer_add(0, dictation_complete, session, true);
+  return DictationSessionStatusSuccess;
+}
+
+DictationSessionStatus dictation_session_stop(DictationSession *session) {
+  return DictationSessionStatusSuccess;
+}
+
+void host_dictation_set_result(DictationSessionStatus status, const char *transcription) {
+  dictation_status = status;
+  strncpy(dictation_text, transcription != NULL ? transcription : "", sizeof(dictation_text) - 1);
+}
+
+/*
+ * ------------------------------------------------------------------------------------------
+ * Stats
+ */
+void host_stats_reset(void) {
+  memset(&host_stats, 0, sizeof(host_stats));
+}
@@ -0,0 +1,153 @@
+/*
+ * Morpheuz Sleep Monitor
+ *
+ * Copyright (c) 2013-2016 James Fowler
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/*
+ * Control surface for the host PebbleOS shim. The app only ever sees pebble.h; drivers
+ * (simulators, benchmarks) use this to run the virtual clock and play the outside world.
+ */
+
+#ifndef PEBBLE_HOST_H_
+#define PEBBLE_HOST_H_
+
+#include "pebble.h"
+
+// src/main.c's main(), renamed by the Makefile so drivers can have their own
+int host_app_main(void);
+
+/*
+ * Virtual clock. Nothing moves unless a driver runs it - timers, ticks, accelerometer
+ * batches, wakeups and AppMessage traffic are all dispatched in time order from here.
+ */
+void host_clock_set(time_t now);
+uint64_t host_clock_now_ms(void);
+void host_clock_run_until_ms(uint64_t until_ms);
+void host_clock_advance_ms(uint64_t delta_ms);
+
+/*
+ * Launch
+ */
+typedef void (*HostEventLoop)(void);
+void host_set_event_loop(HostEventLoop event_loop);
+void host_set_launch(AppLaunchReason reason, uint32_t args);
+void host_set_wakeup_launch(WakeupId wakeup_id, int32_t cookie);
+
+/*
+ * Accelerometer - timestamps are filled in before the source is asked for x, y, z (and
+ * optionally did_vibrate); samples taken while a vibe runs are then flagged by the shim
+ */
+typedef void (*HostAccelSource)(AccelData *data, uint32_t num_samples, void *context);
+void host_accel_set_source(HostAccelSource source, void *context);
+uint32_t host_accel_rate(void);
+uint32_t host_accel_samples_per_update(void);
+
+/*
+ * The phone. The handler sees every outbound message and returns APP_MSG_OK to ACK it.
+ * Replies go back through host_phone_send_* and arrive after the link latency.
+ */
+typedef AppMessageResult (*HostPhoneHandler)(DictionaryIterator *iter, void *context);
+void host_phone_set_handler(HostPhoneHandler handler, void *context);
+void host_phone_set_latency_ms(uint32_t latency_ms);
+void host_phone_send_tuplets(const Tuplet *tuplets, uint8_t count);
+
+/*
+ * Environment
+ */
+void host_set_bluetooth(bool connected);
+void host_set_battery(BatteryChargeState charge);
+void host_set_24h_style(bool is_24h);
+void host_set_log_level(uint8_t log_level);
+void host_dictation_set_result(DictationSessionStatus status, const char *transcription);
+void host_button_click(ButtonId button_id);
+void host_button_long_click(ButtonId button_id);
+
+/*
+ * Persistent storage lives for the life of the process; reset between runs. host_persist_used
+ * gives the bytes held and how many keys hold them.
+ */
+void host_persist_reset(void);
+uint32_t host_persist_used(uint16_t *keys);
+
+/*
+ * Data logging. Items wait in a spool on the watch and drain to the phone at drain_bytes_per_sec
+ * while bluetooth is connected; a log that would overflow the spool gets DATA_LOGGING_FULL.
+ * Everything drained or still spooled is delivered and can be read back by tag.
+ */
+void host_data_logging_set_spool(uint32_t spool_bytes, uint32_t drain_bytes_per_sec);
+const uint8_t *host_data_logging_bytes(uint32_t tag, size_t *length);
+uint32_t host_data_logging_spooled(void);
+
+/*
+ * Rendering - the dirty window is redrawn after each dispatched event, as on the watch
+ */
+void host_set_render(bool enabled);
+void host_render(void);
+
+/*
+ * Scheduled wakeups
+ */
+typedef struct {
+  WakeupId id;
+  time_t timestamp;
+  int32_t cookie;
+} HostWakeup;
+uint8_t host_wakeup_list(HostWakeup *wakeups, uint8_t max);
+
+/*
+ * Counters for everything that costs power on the watch
+ */
+typedef struct {
+  uint32_t timers_fired;
+  uint32_t ticks;
+  uint32_t accel_batches;
+  uint32_t accel_samples;
+  uint32_t accel_peeks;
+  uint32_t taps;
+  uint32_t wakeups_fired;
+  uint32_t persist_reads;
+  uint32_t persist_writes;
+  uint32_t persist_bytes_written;
+  uint32_t dlog_items;
+  uint32_t dlog_bytes;
+  uint32_t dlog_full;
+  uint32_t dlog_spool_max;
+  uint32_t messages_sent;
+  uint32_t messages_acked;
+  uint32_t messages_failed;
+  uint32_t outbox_busy;
+  uint32_t message_bytes_sent;
+  uint32_t messages_received;
+  uint32_t resource_loads;
+  uint32_t bitmaps_created;
+  uint32_t frames;
+  uint32_t layer_updates;
+  uint32_t draw_calls;
+  uint32_t frame_buffer_captures;
+  uint32_t vibes;
+  uint32_t lights;
+} HostStats;
+
+extern HostStats host_stats;
+void host_stats_reset(void);
+
+#endif /* PEBBLE_HOST_H_ */
@@ -0,0 +1,164 @@
+/*
+ * Morpheuz Sleep Monitor
+ *
+ * Copyright (c) 2013-2016 James Fowler
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/*
+ * Quick smart alarm check. Runs still nights through the real app with the smart alarm window
+ * set, and puts movement into the window part way through a minute:
+ *
+ *   sustained  every sample moving for 10s, quick alarm on  - goes off before the minute tick
+ *   minute     the same with the quick alarm off             - waits for the tick
+ *   knock      one sample, quick alarm on                    - waits for the tick
+ *
+ *   quickcheck
+ *
+ * Exits 1 if any of them goes off at the wrong time.
+ */
+
+#include "pebble_host.h"
+
+#define main host_app_main
+#include "morpheuz.h"
+#undef main
+
+#define MS_PER_MINUTE (60 * 1000)
+#define START 1476657000            // 2016-10-16 22:30 UTC
+#define START_MINS (22 * 60 + 30)
+#define FROM_HR 6
+#define TO_HR 7
+#define MOVE_AFTER_MS (10 * MS_PER_MINUTE + 20 * 1000)
+#define MOVE_MS (10 * 1000)
+
+typedef struct {
+  const char *name;
+  bool quick_alarm;
+  bool sustained;
+  bool before_tick;
+} Scenario;
+
+static const Scenario scenarios[] = {
+  { "sustained", true, true, true },
+  { "minute", false, true, false },
+  { "knock", true, false, false },
+};
+
+static uint32_t seed = 1;
+static uint64_t move_ms;
+static uint64_t move_end_ms;
+static uint64_t gone_off_ms;
+static uint32_t failures;
+
+static uint32_t next_random() {
+  seed = seed * 1103515245 + 12345;
+  return (seed >> 16) & 0x7fff;
+}
+
+/*
+ * Sensor noise lying still, with the movement or the knock put in. The alarm is looked for
+ * before every batch as the quick alarm can go off between ticks.
+ */
+static void still_source(AccelData *data, uint32_t num_samples, void *context) {
+  if (gone_off_ms == 0 && get_internal_data()->gone_off > 0) {
+    gone_off_ms = host_clock_now_ms();
+  }
+  for (uint32_t i = 0; i < num_samples; i++) {
+    int16_t movement = 0;
+    if (data[i].timestamp >= move_ms && data[i].timestamp < move_end_ms) {
+      movement = i % 2 ? 800 : -800;
+    }
+    data[i].x = (int16_t) (next_random() % 7) - 3 + movement;
+    data[i].y = (int16_t) (next_random() % 7) - 3;
+    data[i].z = -1000 + (int16_t) (next_random() % 7) - 3;
+  }
+}
+
+/*
+ * Runs inside app_event_loop - a night for each scenario, started at 22:30 and run on to the
+ * minute tick after the movement
+ */
+static void check_loop() {
+  for (uint8_t s = 0; s < ARRAY_LENGTH(scenarios); s++) {
+    const Scenario *scenario = &scenarios[s];
+    uint64_t night_ms = (uint64_t) (START + s * TWENTY_FOUR_HOURS_IN_SECONDS) * 1000;
+    host_clock_run_until_ms(night_ms);
+    cancel_alarm();
+    reset_sleep_period();
+    if (get_internal_data()->gone_off != 0) {
+      // The last night ran on to the limit with no phone to send it to - the first reset only
+      // puts up the notice, so reset again as you would from the menu
+      reset_sleep_period();
+    }
+    get_config_data()->quick_alarm = scenario->quick_alarm;
+    gone_off_ms = 0;
+
+    uint64_t window_ms = night_ms + (uint64_t) (MINS_IN_DAY + FROM_HR * 60 - START_MINS) * MS_PER_MINUTE;
+    move_ms = window_ms + MOVE_AFTER_MS;
+    move_end_ms = move_ms + (scenario->sustained ? MOVE_MS : 1);
+    uint64_t tick_ms = (move_ms / MS_PER_MINUTE + 1) * MS_PER_MINUTE;
+
+    host_clock_run_until_ms(tick_ms - 1);
+    bool before_tick = gone_off_ms != 0;
+    uint64_t before_tick_ms = gone_off_ms;
+    host_clock_run_until_ms(tick_ms + 1000);
+    if (gone_off_ms == 0 && get_internal_data()->gone_off > 0) {
+      gone_off_ms = host_clock_now_ms();
+    }
+
+    if (before_tick != scenario->before_tick || gone_off_ms == 0) {
+      failures++;
+      printf("%s: went off %s\n", scenario->name, gone_off_ms == 0 ? "never" : before_tick ? "before the tick" : "at the tick");
+    } else if (before_tick) {
+      printf("%s: went off %.1fs after the movement started, %.1fs before the tick\n", scenario->name,
+             (before_tick_ms - move_ms) / 1000.0, (tick_ms - before_tick_ms) / 1000.0);
+    } else {
+      printf("%s: waited for the tick\n", scenario->name);
+    }
+  }
+}
+
+int main(int argc, char *argv[]) {
+  setenv("TZ", "UTC", 1);
+  tzset();
+
+  ConfigData config;
+  memset(&config, 0, sizeof(config));
+  config.config_ver = CONFIG_VER;
+  config.smart = true;
+  config.fromhr = FROM_HR;
+  config.frommin = 0;
+  config.tohr = TO_HR;
+  config.tomin = 0;
+  config.from = to_mins(config.fromhr, config.frommin);
+  config.to = to_mins(config.tohr, config.tomin);
+
+  host_persist_reset();
+  persist_write_data(PERSIST_CONFIG_KEY, &config, sizeof(config));
+  host_set_bluetooth(false);
+  host_clock_set(START - 60);
+  host_accel_set_source(still_source, NULL);
+  host_set_event_loop(check_loop);
+  host_app_main();
+
+  printf("quick alarm: %u scenarios, %u failures\n", (unsigned) ARRAY_LENGTH(scenarios), failures);
+  return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,266 @@
+/*
+ * Morpheuz Sleep Monitor
+ *
+ * Copyright (c) 2013-2016 James Fowler
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+/*
+ * Event trace decoder. Turns the hex of a trace dump - as app.js logs it after "TRACE ", or
+ * nightsim -T prints it after "trace " - into a timeline, oldest first, one event a line in
+ * local time.
+ *
+ *   tracedecode [file]
+ *
+ * Reads stdin without a file. Lines without a trace are ignored, so a whole phone log can be fed
+ * in. Exits 1 if a dump isn't whole events, has an event it doesn't know or goes back in time.
+ *
+ * Times are local to TZ (UTC if unset), the same as nightsim.
+ */
+
+#include "pebble_host.h"
+
+#define main host_app_main
+#include "morpheuz.h"
+#undef main
+
+#define MAX_LINE 8192
+
+/*
+ * Names for what's in the events
+ */
+static const char *key_name(uint16_t key) {
+  if (key == KEY_POINT) return "keyPoint";
+  if (key == KEY_CTRL) return "keyCtrl";
+  if (key == KEY_FROM) return "keyFrom";
+  if (key == KEY_TO) return "keyTo";
+  if (key == KEY_BASE) return "keyBase";
+  if (key == KEY_VERSION) return "keyVersion";
+  if (key == KEY_GONEOFF) return "keyGoneoff";
+  if (key == KEY_TRANSMIT) return "keyTransmit";
+  if (key == KEY_AUTO_RESET) return "keyAutoReset";
+  if (key == KEY_SNOOZES) return "keySnoozes";
+  if (key == KEY_FAULT) return "keyFault";
+  if (key == KEY_POINTS) return "keyPoints";
+  if (key == KEY_SEQ) return "keySeq";
+  if (key == KEY_COUNTERS) return "keyCounters";
+  if (key == KEY_TRACE) return "keyTrace";
+  return "?";
+}
+
+static void persist_name(uint16_t key, char *name, size_t size) {
+  if (key == PERSIST_CONFIG_KEY)
+    snprintf(name, size, "config");
+  else if (key == PERSIST_PRESET_KEY)
+    snprintf(name, size, "presets");
+  else if (key == PERSIST_CHART_KEY)
+    snprintf(name, size, "chart");
+  else if (key == PERSIST_HISTORY_KEY)
+    snprintf(name, size, "history index");
+  else if (key == PERSIST_COUNTERS_KEY)
+    snprintf(name, size, "counters");
+  else if (key >= PERSIST_MEMORY_REGION_KEY && key < PERSIST_MEMORY_REGION_KEY + INTERNAL_REGIONS)
+    snprintf(name, size, "internal region %d", key - PERSIST_MEMORY_REGION_KEY);
+  else if (key >= PERSIST_HISTORY_SEGMENT_KEY)
+    snprintf(name, size, "history segment %d", key - PERSIST_HISTORY_SEGMENT_KEY);
+  else
+    snprintf(name, size, "key %u", key);
+}
+
+static const char *launch_name(uint8_t reason) {
+  switch (reason) {
+    case APP_LAUNCH_SYSTEM: return "system";
+    case APP_LAUNCH_USER: return "user";
+    case APP_LAUNCH_PHONE: return "phone";
+    case APP_LAUNCH_WAKEUP: return "wakeup";
+    case APP_LAUNCH_WORKER: return "worker";
+    case APP_LAUNCH_QUICK_LAUNCH: return "quick launch";
+    case APP_LAUNCH_TIMELINE_ACTION: return "timeline";
+    default: return "?";
+  }
+}
+
+static const char *cookie_name(uint16_t cookie) {
+  switch (cookie) {
+    case WAKEUP_AUTO_RESTART: return "auto restart";
+    case WAKEUP_FOR_TRANSMIT: return "transmit";
+    case WAKEUP_LAZARUS: return "lazarus";
+    default: return "?";
+  }
+}
+
+static const char *smart_name(uint8_t decision) {
+  switch (decision) {
+    case SMART_BELOW: return "below threshold";
+    case SMART_ABOVE: return "above threshold, fired";
+    case SMART_LAST_MINUTE: return "last minute, fired";
+    case SMART_QUICK: return "quick, fired";
+    default: return "?";
+  }
+}
+
+/*
+ * One event on one line - false if it isn't one we know
+ */
+static bool print_event(const TraceEvent *event, int32_t *threshold) {
+  char text[64];
+  time_t t = event->time;
+  strftime(text, sizeof(text), "%Y-%m-%d %H:%M:%S", localtime(&t));
+  printf("%s  ", text);
+  switch (event->type) {
+    case TRACE_START:
+      printf("start, launched by %s", launch_name(event->detail));
+      if (event->detail == APP_LAUNCH_WAKEUP)
+        printf(" (%s)", cookie_name(event->value));
+      break;
+    case TRACE_EXIT:
+      printf("exit, %s", event->detail == EXIT_LAZARUS ? "abnormal - lazarus in 5 minutes"
+                         : event->detail == EXIT_FOR_SYNC ? "requested - back to sync" : "requested");
+      break;
+    case TRACE_RESET:
+      printf("reset, new night");
+      break;
+    case TRACE_ACCEL_GAP:
+      printf("accelerometer quiet for %us", event->value);
+      break;
+    case TRACE_VIBE_DISCARD:
+      printf("batch discarded, %u samples vibrating, %u in a row", event->detail, event->value);
+      break;
+    case TRACE_DOZE:
+      printf(event->detail ? "dozing" : "awake");
+      break;
+    case TRACE_FAULT:
+      printf("fault %u", event->detail);
+      break;
+    case TRACE_SEND:
+      printf("send %s", key_name(event->value));
+      if (event->value == KEY_POINTS)
+        printf(" from %d", (event->detail & ~TRACE_ACKED) + LAST_SENT_INIT);
+      printf(event->detail & TRACE_ACKED ? ", acked" : "");
+      break;
+    case TRACE_ACK:
+      printf("acked");
+      break;
+    case TRACE_FAIL:
+      printf("send failed, result %u", event->value);
+      break;
+    case TRACE_PERSIST:
+    case TRACE_PERSIST_FAIL:
+      persist_name(event->value, text, sizeof(text));
+      if (event->type == TRACE_PERSIST)
+        printf("persist %s, %u bytes", text, event->detail);
+      else
+        printf("persist %s failed", text);
+      break;
+    case TRACE_WAKEUP:
+      printf("wakeup %s in %u minutes%s", cookie_name(event->detail & ~TRACE_REJECTED), event->value,
+             event->detail & TRACE_REJECTED ? " rejected" : "");
+      break;
+    case TRACE_SMART:
+      printf("smart alarm point %u %s", event->value, smart_name(event->detail));
+      if (*threshold >= 0)
+        printf(" (threshold %ld)", (long) *threshold);
+      break;
+    case TRACE_THRESHOLD:
+      *threshold = event->value;
+      printf("smart alarm threshold %u", event->value);
+      break;
+    case TRACE_DUMP:
+      printf("trace asked for");
+      break;
+    default:
+      printf("unknown event %u\n", event->type);
+      return false;
+  }
+  printf("\n");
+  return true;
+}
+
+static int hex_digit(char c) {
+  if (c >= '0' && c <= '9')
+    return c - '0';
+  if (c >= 'a' && c <= 'f')
+    return c - 'a' + 10;
+  if (c >= 'A' && c <= 'F')
+    return c - 'A' + 10;
+  return -1;
+}
+
+/*
+ * A dump - the hex after "trace " or "TRACE " on a line
+ */
+static bool decode_line(const char *line) {
+  const char *hex = strstr(line, "trace ");
+  if (hex == NULL)
+    hex = strstr(line, "TRACE ");
+  if (hex == NULL)
+    return true;
+  hex += strlen("trace ");
+
+  static uint8_t bytes[MAX_LINE / 2];
+  size_t length = 0;
+  for (; hex_digit(hex[0]) >= 0 && hex_digit(hex[1]) >= 0 && length < sizeof(bytes); hex += 2)
+    bytes[length++] = hex_digit(hex[0]) << 4 | hex_digit(hex[1]);
+
+  if (length % sizeof(TraceEvent) != 0) {
+    fprintf(stderr, "trace of %zu bytes isn't whole events\n", length);
+    return false;
+  }
+
+  bool ok = true;
+  uint32_t last_time = 0;
+  int32_t threshold = -1;
+  for (size_t pos = 0; pos < length; pos += sizeof(TraceEvent)) {
+    TraceEvent event;
+    memcpy(&event, bytes + pos, sizeof(event));
+    if (event.type == 0)
+      continue;
+    if (event.time < last_time) {
+      fprintf(stderr, "event %zu goes back in time\n", pos / sizeof(TraceEvent));
+      ok = false;
+    }
+    last_time = event.time;
+    ok = print_event(&event, &threshold) && ok;
+  }
+  printf("%zu events\n", length / sizeof(TraceEvent));
+  return ok;
+}
+
+int main(int argc, char *argv[]) {
+  FILE *in = stdin;
+  if (argc > 2 || (argc == 2 && argv[1][0] == '-')) {
+    fprintf(stderr, "usage: tracedecode [file]\n");
+    return 1;
+  }
+  if (argc == 2 && (in = fopen(argv[1], "r")) == NULL) {
+    perror(argv[1]);
+    return 1;
+  }
+
+  if (getenv("TZ") == NULL)
+    setenv("TZ", "UTC", 1);
+  tzset();
+
+  static char line[MAX_LINE];
+  bool ok = true;
+  while (fgets(line, sizeof(line), in) != NULL) {
+    ok = decode_line(line) && ok;
+  }
+  return ok ? 0 : 1;
+}
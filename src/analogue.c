@@ -26,6 +26,7 @@
 #include "analogue.h"
 #include "morpheuz.h"
 #include "rootui.h"
+#include "dial_tables.h"
   
 #ifdef PBL_RECT
 
@@ -54,6 +55,10 @@ static int16_t progress_2;
 static bool is_visible = false;
 static bool g_call_post_init;
 
+#ifdef CACHE_DIAL
+static GBitmap *dial_cache;
+#endif
+
 /*
  * Draws marks around the circumference of the clock face
  * inner = pixels innermost
@@ -92,13 +97,92 @@ static void draw_marks(Layer *layer, GContext *ctx, int inner, int outer, int st
 }
 
 /*
- * Update the clockface layer if it needs it
+ * As draw_marks, but for marks on DIAL_STEP boundaries, which come straight from the tables
+ * inner = ring innermost
+ * outer = ring outermost
+ * start, stop, step = multiples of DIAL_STEP
+ * skip_hours = leave out the marks the hour marks sit on top of
  */
-static void bg_update_proc(Layer *layer, GContext *ctx) {
+static void draw_dial_marks(Layer *layer, GContext *ctx, uint8_t inner, uint8_t outer, int start, int stop, int step, int width, GColor color, bool skip_hours) {
+  graphics_context_set_stroke_color(ctx, color);
+
+  GRect bounds = layer_get_bounds(layer);
+  const GPoint center = grect_center_point(&bounds);
+
+  graphics_context_set_stroke_width(ctx, width);
+  for (int i = start; i < stop; i += step) {
+    if (skip_hours && i % 120 == 0) {
+      continue;
+    }
+    uint8_t position = i / DIAL_STEP;
+    graphics_draw_line(ctx, dial_point(center, inner, position), dial_point(center, outer, position));
+  }
+}
+
+/*
+ * The parts of the face that never change - background, minute and hour marks
+ */
+static void draw_dial(Layer *layer, GContext *ctx) {
 
   graphics_context_set_fill_color(ctx, BACKGROUND_COLOR);
   graphics_fill_rect(ctx, layer_get_bounds(layer), 0, GCornerNone);
 
+  // Minute marks
+  draw_dial_marks(layer, ctx, DIAL_RING_MIN, DIAL_RING_CLOCK, 0, 1440, MINUTE_STEP, WIDTH_MINUTES, MINUTE_MARK_COLOR, false);
+
+  // Hour marks
+  draw_dial_marks(layer, ctx, DIAL_RING_HOUR, DIAL_RING_CLOCK, 0, 1440, 120, WIDTH_HOUR_MARKS, HOUR_MARK_COLOR, false);
+}
+
+#ifdef CACHE_DIAL
+/*
+ * Keep a copy of the dial just drawn, straight from the frame buffer. Only done once the layer
+ * is fully on screen (it slides in) and lined up with the left edge so rows copy as they are.
+ */
+static void capture_dial(Layer *layer, GContext *ctx) {
+  GRect frame = layer_get_frame(layer);
+  GBitmap *frame_buffer = graphics_capture_frame_buffer(ctx);
+  if (frame_buffer == NULL) {
+    return;
+  }
+  GRect screen = gbitmap_get_bounds(frame_buffer);
+  if (frame.origin.x == 0 && frame.origin.y >= 0 && frame.size.w <= screen.size.w && frame.origin.y + frame.size.h <= screen.size.h) {
+    GBitmap *cache = gbitmap_create_blank(frame.size, gbitmap_get_format(frame_buffer));
+    if (cache != NULL) {
+      uint16_t screen_row = gbitmap_get_bytes_per_row(frame_buffer);
+      uint16_t cache_row = gbitmap_get_bytes_per_row(cache);
+      uint8_t *from = gbitmap_get_data(frame_buffer) + frame.origin.y * screen_row;
+      uint8_t *to = gbitmap_get_data(cache);
+      for (int16_t y = 0; y < frame.size.h; y++, from += screen_row, to += cache_row) {
+        memcpy(to, from, cache_row);
+      }
+      dial_cache = cache;
+    }
+  }
+  graphics_release_frame_buffer(ctx, frame_buffer);
+}
+#endif
+
+/*
+ * Update the clockface layer if it needs it. The dial comes from the cache where there is one,
+ * then the smart alarm, start and progress marks go on top.
+ */
+static void bg_update_proc(Layer *layer, GContext *ctx) {
+
+  count_event(COUNT_DRAW_DIAL);
+
+  #ifdef CACHE_DIAL
+    if (dial_cache != NULL) {
+      graphics_context_set_compositing_mode(ctx, GCompOpAssign);
+      graphics_draw_bitmap_in_rect(ctx, dial_cache, layer_get_bounds(layer));
+    } else {
+      draw_dial(layer, ctx);
+      capture_dial(layer, ctx);
+    }
+  #else
+    draw_dial(layer, ctx);
+  #endif
+
   graphics_context_set_fill_color(ctx, ANALOGUE_COLOR);
 
   #ifdef PBL_COLOR
@@ -111,24 +195,18 @@ static void bg_update_proc(Layer *layer, GContext *ctx) {
     draw_marks(layer, ctx, OUTER_STOP, OUTER, to_time, to_time + 1, 1, WIDTH_SMART_POINTS, TO_TIME_COLOR);
   }
 
-  // Minute marks
-  draw_marks(layer, ctx, MIN, CLOCK, 0, 1440, MINUTE_STEP, WIDTH_MINUTES, MINUTE_MARK_COLOR);
-
   // Show reset point
   if (start_time != -1) {
     draw_marks(layer, ctx, OUTER_STOP, OUTER, start_time, start_time + 1, 1, WIDTH_SMART_POINTS, START_TIME_COLOR);
 
-    // Progress line
+    // Progress line - under the hour marks, which are already drawn, so leave those positions alone
     if (progress_1 != -1) {
-      draw_marks(layer, ctx, MIN, CLOCK, start_time_round, progress_1, PROGRESS_STEP, WIDTH_MINUTES, PROGRESS_COLOR);
+      draw_dial_marks(layer, ctx, DIAL_RING_MIN, DIAL_RING_CLOCK, start_time_round, progress_1, PROGRESS_STEP, WIDTH_MINUTES, PROGRESS_COLOR, true);
       if (progress_2 != -1) {
-        draw_marks(layer, ctx, MIN, CLOCK, 0, progress_2, PROGRESS_STEP, WIDTH_MINUTES, PROGRESS_COLOR);
+        draw_dial_marks(layer, ctx, DIAL_RING_MIN, DIAL_RING_CLOCK, 0, progress_2, PROGRESS_STEP, WIDTH_MINUTES, PROGRESS_COLOR, true);
       }
     }
   }
-  
-  // Hour marks
-  draw_marks(layer, ctx, HOUR, CLOCK, 0, 1440, 120, WIDTH_HOUR_MARKS, HOUR_MARK_COLOR);
 
 }
 
@@ -139,14 +217,14 @@ EXTFN void analogue_set_smart_times() {
   show_smart_points = get_config_data()->smart;
   from_time = (get_config_data()->from * 2) % 1440;
   to_time = (get_config_data()->to * 2) % 1440;
-  if (is_visible)
-    layer_mark_dirty(analogue_layer);
+  redraw_request(REDRAW_DIAL);
 }
 
 /*
  * Record the base time for display on the analogue clock. Trigger an update of the layer.
  */
 EXTFN void analogue_set_base(time_t base) {
+  int16_t previous = start_time;
   if (base == 0) {
     start_time = -1;
     start_time_round = 0;
@@ -155,14 +233,16 @@ EXTFN void analogue_set_base(time_t base) {
     start_time = (time->tm_hour * 120 + time->tm_min * 2) % 1440;
     start_time_round = start_time - (start_time % 24);
   }
-  if (is_visible)
-    layer_mark_dirty(analogue_layer);
+  if (start_time != previous)
+    redraw_request(REDRAW_DIAL);
 }
 
 /*
  * Mark progress on the analogue clock. Progress 1-54. Trigger an update of the layer
  */
 EXTFN void analogue_set_progress(uint8_t progress_level_in) {
+  int16_t previous_1 = progress_1;
+  int16_t previous_2 = progress_2;
   progress_1 = start_time_round + ((int16_t) progress_level_in) * 20;
   if (progress_1 >= 1440) {
     progress_2 = progress_1 - 1440;
@@ -170,14 +250,15 @@ EXTFN void analogue_set_progress(uint8_t progress_level_in) {
   } else {
     progress_2 = -1;
   }
-  if (is_visible)
-    layer_mark_dirty(analogue_layer);
+  if (progress_1 != previous_1 || progress_2 != previous_2)
+    redraw_request(REDRAW_DIAL);
 }
 
 /*
  * Plot the normal time display on the clock
  */
 static void hands_update_proc(Layer *layer, GContext *ctx) {
+  count_event(COUNT_DRAW_HANDS);
   GRect bounds = layer_get_bounds(layer);
 
   time_t now = time(NULL);
@@ -211,8 +292,16 @@ static void hands_update_proc(Layer *layer, GContext *ctx) {
  * Trigger the refresh of the time
  */
 EXTFN void analogue_minute_tick() {
-  if (is_visible)
-    layer_mark_dirty(hands_layer);
+  redraw_request(REDRAW_HANDS);
+}
+
+/*
+ * Hide or show the face. The hands go too so a redraw asked of them doesn't mark anything while
+ * the face is away.
+ */
+static void face_hidden(bool hidden) {
+  layer_set_hidden(analogue_layer, hidden);
+  layer_set_hidden(hands_layer, hidden);
 }
 
 /**
@@ -244,6 +333,11 @@ EXTFN void analogue_window_load(Window *window) {
   gpath_move_to(hour_arrow, center);
 
   hands_layer = macro_layer_create(GRect(0, 0, 144, 144), analogue_layer, hands_update_proc);
+
+  // Off screen until slid in - hidden so it isn't drawn with everything else
+  face_hidden(true);
+  redraw_register(REDRAW_DIAL, analogue_layer);
+  redraw_register(REDRAW_HANDS, hands_layer);
 }
 
 /*
@@ -252,6 +346,8 @@ EXTFN void analogue_window_load(Window *window) {
 static void animation_stopped(Animation *animation, bool finished, void *data) {
   if (is_visible) {
     bed_visible(false);
+  } else {
+    face_hidden(true);
   }
   if (g_call_post_init) {
     app_timer_register(250, post_init_hook, NULL);
@@ -273,6 +369,7 @@ static void start_animation(GRect *start, GRect *finish) {
  */
 EXTFN void analogue_visible(bool visible, bool call_post_init) {
   if (visible && !is_visible) {
+    face_hidden(false);
     start_animation(&ANALOGUE_START, &ANALOGUE_FINISH);
   } else if (!visible && is_visible) {
     start_animation(&ANALOGUE_FINISH, &ANALOGUE_START);
@@ -289,6 +386,10 @@ EXTFN void analogue_visible(bool visible, bool call_post_init) {
  * Unload the analogue watchface
  */
 EXTFN void analogue_window_unload() {
+  #ifdef CACHE_DIAL
+    gbitmap_destroy(dial_cache);
+    dial_cache = NULL;
+  #endif
   gpath_destroy(minute_arrow);
   gpath_destroy(hour_arrow);
   layer_destroy(hands_layer);
@@ -56,14 +56,54 @@ static struct PropertyAnimation *moon_animation;
 
 static ChartData chart_data;
 
+// ChartData as it was before the points were packed - only kept to bring a saved chart forward
+#define CHART_VER_UNPACKED 42
+typedef struct {
+  uint8_t chart_ver;
+  uint32_t base;
+  uint16_t gone_off;
+  uint8_t highest_entry;
+  uint16_t points[LIMIT];
+  bool ignore[LIMIT];
+  uint8_t snoozes;
+  uint32_t from;
+  uint32_t to;
+  bool smart;
+} ChartDataUnpacked;
+
 static Layer *bar_layer;
 static TextLayer *chart_date;
 
 static int16_t bar_height;
 static int16_t bar_width;
 
+// The chart as painted - runs of segments in the same colour as one rect each, then the markers.
+// Worked out once for the night shown, so a paint is just a walk down it.
+typedef struct {
+  uint8_t left;
+  uint8_t width;
+  GColor color;
+} ChartRun;
+
+typedef struct {
+  uint8_t runs;
+  ChartRun run[LIMIT];
+  GRect earliest;
+  GRect latest;
+  GRect asleep;
+} ChartModel;
+
+static ChartModel chart_model;
+
+static void build_chart_model();
+
 static char date_text[25];
 
+#ifdef ENABLE_HISTORY
+static uint8_t chart_night;
+static uint32_t latest_base;
+#endif
+
 #ifdef TESTING_BUILD
 static int16_t dummy_data[] = { 1835, 2300, 775, 806, 1112, -2, 1142, 826, 815, 2210, 1190, 998, 1053, 1388, 1177, 1033, 1532, 1366, 96, 147, 2736, 310, 92, 1806, 790, 992, 33, 2174, 382, 117, 519, 177, 452, 690, 532, 773, 878, 1413, 1175, 1187, 863, 223, 1805, 960, 83, 2053, 1050, 484, 913, 784, 1784, 54, -1, -1, -1, -1, -1, -1, -1, -1 };
 #endif
@@ -74,14 +114,14 @@ static void reset_chart_data() {
   for (int i = 0; i < LIMIT; i++) {
     if (dummy_data[i] != -2) {
       if (dummy_data[i] != -1) {
-      chart_data.points[i] = dummy_data[i];
+      set_point(chart_data.points, i, dummy_data[i]);
       } else {
-        chart_data.points[i] = 0;
+        set_point(chart_data.points, i, 0);
       }
-      chart_data.ignore[i] = false;
+      set_ignore(chart_data.ignore, i, false);
     } else {
-      chart_data.points[i] = 0;
-      chart_data.ignore[i] = true;
+      set_point(chart_data.points, i, 0);
+      set_ignore(chart_data.ignore, i, true);
     }
   }
   chart_data.highest_entry = 59;
@@ -95,24 +135,52 @@ static void reset_chart_data() {
   #endif
 }
 
-/*
- * Read the chart data
- */
-static void read_chart_data() {
-  int read = persist_read_data(PERSIST_CHART_KEY, &chart_data, sizeof(chart_data));
-  if (read != sizeof(chart_data) || chart_data.chart_ver != CHART_VER) {
-    reset_chart_data();
-  }
-}
-
 /*
  * Save the chart data structure
  */
 static void save_chart_data() {
   LOG_DEBUG("save_chart_data (%d)", sizeof(chart_data));
   int written = persist_write_data(PERSIST_CHART_KEY, &chart_data, sizeof(chart_data));
+  trace_persist(PERSIST_CHART_KEY, written);
   if (written != sizeof(chart_data)) {
     LOG_ERROR("save_chart_data error (%d)", written);
+  } else {
+    count_add(COUNT_PERSIST_BYTES, written);
+  }
+}
+
+/*
+ * Bring a chart saved before the points were packed forward and save it in the new layout
+ */
+static void pack_chart_data(ChartDataUnpacked *unpacked) {
+  memset(&chart_data, 0, sizeof(chart_data));
+  chart_data.chart_ver = CHART_VER;
+  chart_data.base = unpacked->base;
+  chart_data.gone_off = unpacked->gone_off;
+  chart_data.highest_entry = unpacked->highest_entry;
+  for (uint8_t i = 0; i < LIMIT; i++) {
+    set_point(chart_data.points, i, unpacked->points[i]);
+    set_ignore(chart_data.ignore, i, unpacked->ignore[i]);
+  }
+  chart_data.snoozes = unpacked->snoozes;
+  chart_data.from = unpacked->from;
+  chart_data.to = unpacked->to;
+  chart_data.smart = unpacked->smart;
+  save_chart_data();
+}
+
+/*
+ * Read the chart data
+ */
+static void read_chart_data() {
+  ChartDataUnpacked unpacked;
+  int read = persist_read_data(PERSIST_CHART_KEY, &unpacked, sizeof(unpacked));
+  if (read == sizeof(chart_data) && unpacked.chart_ver == CHART_VER) {
+    memcpy(&chart_data, &unpacked, sizeof(chart_data));
+  } else if (read == sizeof(unpacked) && unpacked.chart_ver == CHART_VER_UNPACKED) {
+    pack_chart_data(&unpacked);
+  } else {
+    reset_chart_data();
   }
 }
 
@@ -124,15 +192,22 @@ EXTFN void store_chart_data() {
   chart_data.base = get_internal_data()->base;
   chart_data.gone_off = get_internal_data()->gone_off;
   chart_data.highest_entry = get_internal_data()->highest_entry;
-  for (int i = 0; i < LIMIT; i++) {
-    chart_data.points[i] = get_internal_data()->points[i];
-    chart_data.ignore[i] = get_internal_data()->ignore[i];
-  }
+  memcpy(chart_data.points, get_internal_data()->points, sizeof(chart_data.points));
+  memcpy(chart_data.ignore, get_internal_data()->ignore, sizeof(chart_data.ignore));
   chart_data.snoozes = get_internal_data()->snoozes;
   chart_data.from = get_config_data()->from;
   chart_data.to = get_config_data()->to;
   chart_data.smart = get_config_data()->smart;
   save_chart_data();
+  #ifdef ENABLE_HISTORY
+  // Paged back to an older night - leave that on screen, the new one is there when paged forward
+  if (chart_showing && chart_night == 0) {
+  #else
+  if (chart_showing) {
+  #endif
+    build_chart_model();
+    layer_mark_dirty(bar_layer);
+  }
 }
 
 /*
@@ -173,11 +248,75 @@ static void single_click_handler(ClickRecognizerRef recognizer, void *context) {
   }
 }
 
+#ifdef ENABLE_HISTORY
+/*
+ * Load a night - 0 is the last one charted, then back through the history (skipping any the
+ * last chart already covers). The index says which slot that is, so only that night is read.
+ */
+static bool load_chart_night(uint8_t night) {
+  if (night == 0) {
+    read_chart_data();
+    return true;
+  }
+  HistoryIndex index;
+  history_read_index(&index);
+  uint8_t found = 0;
+  for (uint8_t i = 0; i < HISTORY_NIGHTS; i++) {
+    uint32_t base = history_night_base(&index, i);
+    if (base == 0 || (latest_base != 0 && base >= latest_base) || ++found != night) {
+      continue;
+    }
+    ChartData history_data;
+    if (!history_read_night(&index, i, &history_data)) {
+      // Doesn't check out - pass over it as if it wasn't there
+      found--;
+      continue;
+    }
+    chart_data = history_data;
+    return true;
+  }
+  return false;
+}
+
+/*
+ * Show the night that has just been loaded and keep the chart up a while longer
+ */
+static void chart_night_changed() {
+  build_chart_model();
+  layer_mark_dirty(bar_layer);
+  app_timer_reschedule(chart_timer, CHART_DISPLAY_MS);
+}
+
+/*
+ * Up goes back a night
+ */
+static void up_click_handler(ClickRecognizerRef recognizer, void *context) {
+  if (load_chart_night(chart_night + 1)) {
+    chart_night++;
+    chart_night_changed();
+  }
+}
+
+/*
+ * Down comes forward a night
+ */
+static void down_click_handler(ClickRecognizerRef recognizer, void *context) {
+  if (chart_night > 0 && load_chart_night(chart_night - 1)) {
+    chart_night--;
+    chart_night_changed();
+  }
+}
+#endif
+
 /*
  * Button config
  */
 static void chart_click_config_provider(Window *window) {
   window_single_click_subscribe(BUTTON_ID_BACK, single_click_handler);
+#ifdef ENABLE_HISTORY
+  window_single_click_subscribe(BUTTON_ID_UP, up_click_handler);
+  window_single_click_subscribe(BUTTON_ID_DOWN, down_click_handler);
+#endif
 }
 
 /*
@@ -207,147 +346,185 @@ static int32_t x_from_position(uint8_t position) {
 }
 
 /*
- * Draw a bar for a particular 10 minute slice
+ * Colour of a 10 minute slice - GColorClear where nothing is drawn
  */
-static void draw_bar_sector(GContext *ctx, GColor color, uint8_t position, int32_t stroke_width) {
-  int32_t x = x_from_position(position);
-
-  graphics_context_set_stroke_width(ctx, stroke_width);
-  graphics_context_set_stroke_color(ctx, color);
-  graphics_draw_line(ctx, GPoint(x, 0), GPoint(x, bar_height-7));
+static GColor segment_color(uint8_t i) {
+  if (get_ignore(chart_data.ignore, i)) {
+    return CHART_IGNORE_COLOR;
+  }
+  uint16_t height = get_point(chart_data.points, i);
+  if (height > AWAKE_ABOVE) {
+    return CHART_AWAKE_COLOR;
+  } else if (height > LIGHT_ABOVE) {
+    return CHART_LIGHT_COLOR;
+  } else if (height > 0) {
+    return CHART_DEEP_COLOR;
+  }
+  return GColorClear;
 }
 
 /*
- * Update the chart
+ * Add a slice to the bars - it joins the last run if that is the same colour and reaches it
  */
-static void bar_layer_update_callback(Layer *layer, GContext *ctx) {
+static void add_segment(uint8_t i, int32_t stroke_width) {
+  GColor color = segment_color(i);
+  if (gcolor_equal(color, GColorClear)) {
+    return;
+  }
+  int32_t left = x_from_position(i) - stroke_width / 2;
+  if (chart_model.runs > 0) {
+    ChartRun *last = &chart_model.run[chart_model.runs - 1];
+    if (gcolor_equal(last->color, color) && last->left + last->width >= left) {
+      last->width = left + stroke_width - last->left;
+      return;
+    }
+  }
+  ChartRun *run = &chart_model.run[chart_model.runs++];
+  run->left = left < 0 ? 0 : left;
+  run->width = left + stroke_width - run->left;
+  run->color = color;
+}
 
-  // Fill background
-  graphics_context_set_fill_color(ctx, CHART_BACKGROUND_COLOR);
-  graphics_fill_rect(ctx, layer_get_bounds(layer), 0, GCornerNone);
-  
-  graphics_context_set_fill_color(ctx, CHART_INDICATOR_BACKGROUND_COLOR);
-  graphics_fill_rect(ctx, GRect(0,bar_height - 5, bar_width, 5), 0, GCornerNone);
-  
-  // Only do this if there is a chart to display
-  if (chart_data.base != 0) {
-    
-    int32_t stroke_width = calc_stroke_width();
-
-    // Paint restless, light, deep and ignore
-    for (uint8_t i = 0; i <= chart_data.highest_entry; i++) {
-      if (!chart_data.ignore[i]) {
-        uint16_t height = chart_data.points[i];
-        if (height > AWAKE_ABOVE) {
-          draw_bar_sector(ctx, CHART_AWAKE_COLOR, i, stroke_width);
-        } else if (height > LIGHT_ABOVE) {
-          draw_bar_sector(ctx, CHART_LIGHT_COLOR, i, stroke_width);
-        } else if (height > 0) {
-          draw_bar_sector(ctx, CHART_DEEP_COLOR, i, stroke_width);
-        }
-      } else {
-        draw_bar_sector(ctx, CHART_IGNORE_COLOR, i, stroke_width);
-      }
+/*
+ * Which slice a time of day (minutes) falls in, counting from the start of the night. LIMIT + 1
+ * if it doesn't.
+ */
+static uint8_t segment_for_time(uint32_t base_hrs_mins, uint32_t mins) {
+  uint32_t before = base_hrs_mins;
+  for (uint8_t i = 0; i <= LIMIT; i++) {
+    uint32_t after = next_after(before);
+    if (mins >= before && mins <= after) {
+      return i;
     }
-  
-    // Remember the positions of the gone to sleep and woke up markers
-    int8_t gone_to_sleep_i = 0;
-    int8_t woke_up_i = 0;
-
-    // Work out the gone to sleep position
-    for (uint8_t i = 0; i <= chart_data.highest_entry; i++) {
-      if (!chart_data.ignore[i]) {
-        if (chart_data.points[i] <= AWAKE_ABOVE && i < chart_data.highest_entry) {
-          gone_to_sleep_i = i;
-          break;
-        }
-      }
+    before = after;
+  }
+  return LIMIT + 1;
+}
+
+/*
+ * A smart alarm blobby on the indicator line, if the time is on the chart
+ */
+static GRect smart_marker(uint32_t base_hrs_mins, uint32_t mins, int32_t stroke_width) {
+  uint8_t i = segment_for_time(base_hrs_mins, mins);
+  if (i > LIMIT) {
+    return GRectZero;
+  }
+  return GRect(x_from_position(i) - stroke_width, bar_height - 5, stroke_width * 2, 5);
+}
+
+/*
+ * First segment asleep. The night still being recorded has it in the running sleep statistics
+ * (as long as they cover everything charted) - anything else is looked for.
+ */
+static int8_t gone_to_sleep_position() {
+  SleepStats *stats = get_sleep_stats();
+  if (chart_data.base == get_internal_data()->base && stats->completed >= chart_data.highest_entry) {
+    return stats->sleeping && stats->onset < chart_data.highest_entry ? stats->onset : 0;
+  }
+  for (uint8_t i = 0; i < chart_data.highest_entry; i++) {
+    if (!get_ignore(chart_data.ignore, i) && get_point(chart_data.points, i) <= AWAKE_ABOVE) {
+      return i;
     }
+  }
+  return 0;
+}
 
-    // Calculate base as a time
-    time_t base = chart_data.base;
-    struct tm *time = localtime(&base);
-
-    // Strange to do this here, but we have the data so might as well fill in the text too
-    strftime(date_text, sizeof(date_text), clock_is_24h_style() ? DATE_TIME_FORMAT_24 : DATE_TIME_FORMAT_12, time);
-    text_layer_set_text(chart_date, date_text);
-
-    uint32_t base_hrs_mins = to_mins(time->tm_hour, time->tm_min);
-
-    uint32_t before = 0;
-
-    // Only bother with the smart alarm markers if there actually was one set
-    if (chart_data.smart) {
-      
-      // Paint smart alarm start blobby
-      before = base_hrs_mins;
-      for (uint8_t i = 0; i <= LIMIT; i++) {
-        uint32_t after = next_after(before);
-        if (chart_data.from >= before && chart_data.from <= after) {
-          int32_t early_left = x_from_position(i) - stroke_width;
-          graphics_context_set_stroke_color(ctx, CHART_SLEEP_SMART_EARLIEST_COLOR);
-          graphics_context_set_fill_color(ctx, CHART_SLEEP_SMART_EARLIEST_COLOR);
-          graphics_fill_rect(ctx, GRect(early_left,bar_height - 5, stroke_width * 2, 5), 0, GCornerNone);
-          break;
-        }
-        before = after;
-      }
+/*
+ * Work out what the chart shows for chart_data - the bars, the smart alarm markers and the time
+ * spent asleep - and put the date up
+ */
+static void build_chart_model() {
+  memset(&chart_model, 0, sizeof(chart_model));
 
-      // Paint smart alarm end blobby
-      before = base_hrs_mins;
-      for (uint8_t i = 0; i <= LIMIT; i++) {
-        uint32_t after = next_after(before);
-        if (chart_data.to >= before && chart_data.to <= after) {
-          int32_t late_left = x_from_position(i) - stroke_width;
-          graphics_context_set_stroke_color(ctx, CHART_SLEEP_SMART_LATEST_COLOR);
-          graphics_context_set_fill_color(ctx, CHART_SLEEP_SMART_LATEST_COLOR);
-          graphics_fill_rect(ctx, GRect(late_left,bar_height - 5, stroke_width * 2, 5), 0, GCornerNone);
-          break;
-        }
-        before = after;
-      }
+  // Only do this if there is a chart to display
+  if (chart_data.base == 0) {
+    text_layer_set_text(chart_date, NO_CHART_RECORDED);
+    return;
+  }
+
+  int32_t stroke_width = calc_stroke_width();
+
+  // Restless, light, deep and ignore
+  for (uint8_t i = 0; i <= chart_data.highest_entry; i++) {
+    add_segment(i, stroke_width);
+  }
+
+  // Remember the positions of the gone to sleep and woke up markers
+  int8_t gone_to_sleep_i = gone_to_sleep_position();
+  int8_t woke_up_i = 0;
+
+  // Calculate base as a time
+  time_t base = chart_data.base;
+  struct tm *time = localtime(&base);
+
+  strftime(date_text, sizeof(date_text), clock_is_24h_style() ? DATE_TIME_FORMAT_24 : DATE_TIME_FORMAT_12, time);
+  text_layer_set_text(chart_date, date_text);
+
+  uint32_t base_hrs_mins = to_mins(time->tm_hour, time->tm_min);
+
+  // Only bother with the smart alarm markers if there actually was one set
+  if (chart_data.smart) {
+    chart_model.earliest = smart_marker(base_hrs_mins, chart_data.from, stroke_width);
+    chart_model.latest = smart_marker(base_hrs_mins, chart_data.to, stroke_width);
+  }
+
+  // Work out the wake up point
+  if (chart_data.gone_off != 0) {
+
+    // First way - if the alarm has gone off then we can assume this is it
+    uint8_t i = segment_for_time(base_hrs_mins, chart_data.gone_off);
+    if (i <= LIMIT) {
+      woke_up_i = i;
     }
+  } else {
 
-    // Work out the wake up point
-    if (chart_data.gone_off != 0) {
-    
-      // First way - if the alarm has gone off then we can assume this is it
-      before = base_hrs_mins;
-      for (uint8_t i = 0; i <= LIMIT; i++) {
-        uint32_t after = next_after(before);
-        if (chart_data.gone_off >= before && chart_data.gone_off <= after) {
+    // Otherwise calculate back from the end until we get something over the awake level
+    for (uint8_t i = chart_data.highest_entry; i > 0; i--) {
+      if (!get_ignore(chart_data.ignore, i)) {
+        if (get_point(chart_data.points, i) > AWAKE_ABOVE) {
           woke_up_i = i;
           break;
         }
-        before = after;
-      }
-    } else {
-      
-      // Otherwise calculate back from the end until we get something over the awake level
-      for (uint8_t i = chart_data.highest_entry; i > 0; i--) {
-        if (!chart_data.ignore[i]) {
-          if (chart_data.points[i] > AWAKE_ABOVE) {
-            woke_up_i = i;
-            break;
-          }
-        }  
       }
     }
-  
-    // Now is a good time to record a horizontal bar for time spent asleep
-    graphics_context_set_stroke_width(ctx, 1);
-    int32_t sleep_left = x_from_position(gone_to_sleep_i);
-    int32_t sleep_width = x_from_position(woke_up_i) - sleep_left + stroke_width;
+  }
 
-    graphics_context_set_stroke_color(ctx, CHART_SLEEP_AWAKE_MARKER_COLOR);
-    graphics_context_set_fill_color(ctx, CHART_SLEEP_AWAKE_MARKER_COLOR);
-    graphics_fill_rect(ctx, GRect(sleep_left,bar_height - 4, sleep_width, 2), 0, GCornerNone);
+  // Horizontal bar for time spent asleep
+  int32_t sleep_left = x_from_position(gone_to_sleep_i);
+  int32_t sleep_width = x_from_position(woke_up_i) - sleep_left + stroke_width;
+  chart_model.asleep = GRect(sleep_left, bar_height - 4, sleep_width, 2);
+}
 
-  } else {
-    
-    // Or there was no data
-    text_layer_set_text(chart_date, NO_CHART_RECORDED);
+/*
+ * Fill a rect in a colour (nothing if it is empty)
+ */
+static void fill_chart_rect(GContext *ctx, GRect rect, GColor color) {
+  if (rect.size.w > 0) {
+    graphics_context_set_fill_color(ctx, color);
+    graphics_fill_rect(ctx, rect, 0, GCornerNone);
   }
+}
+
+/*
+ * Update the chart - everything has been worked out by build_chart_model
+ */
+static void bar_layer_update_callback(Layer *layer, GContext *ctx) {
+
+  count_event(COUNT_DRAW_CHART);
+
+  // Fill background
+  fill_chart_rect(ctx, layer_get_bounds(layer), CHART_BACKGROUND_COLOR);
+  fill_chart_rect(ctx, GRect(0, bar_height - 5, bar_width, 5), CHART_INDICATOR_BACKGROUND_COLOR);
+
+  // Bars, down to just above the indicator line
+  for (uint8_t i = 0; i < chart_model.runs; i++) {
+    ChartRun *run = &chart_model.run[i];
+    fill_chart_rect(ctx, GRect(run->left, 0, run->width, bar_height - 6), run->color);
+  }
+
+  fill_chart_rect(ctx, chart_model.earliest, CHART_SLEEP_SMART_EARLIEST_COLOR);
+  fill_chart_rect(ctx, chart_model.latest, CHART_SLEEP_SMART_LATEST_COLOR);
+  fill_chart_rect(ctx, chart_model.asleep, CHART_SLEEP_AWAKE_MARKER_COLOR);
 
   // Add trim
   graphics_context_set_stroke_width(ctx, 1);
@@ -363,6 +540,10 @@ EXTFN void chart_load(Window *window) {
   chart_window = window;
   
   read_chart_data();
+#ifdef ENABLE_HISTORY
+  chart_night = 0;
+  latest_base = chart_data.base;
+#endif
 
   window_set_background_color(chart_window, BACKGROUND_COLOR);
 
@@ -396,6 +577,7 @@ EXTFN void chart_load(Window *window) {
   chart_date = macro_text_layer_create(GRect(0, bar_top + bar_height - 5, width, 31), window_layer, GColorWhite, BACKGROUND_COLOR, fonts_get_system_font(FONT_KEY_GOTHIC_24), GTextAlignmentCenter);
 
   bar_layer = macro_layer_create(GRect(bar_left, bar_top, bar_width, bar_height), window_layer, &bar_layer_update_callback);
+  build_chart_model();
 
   moon_animation = property_animation_create_layer_frame(bitmap_layer_get_layer_jf(chart_moon.layer), &MOON_START, &MOON_FINISH);
   animation_set_duration((Animation*) moon_animation, 750);
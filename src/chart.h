@@ -26,18 +26,42 @@
 #include "morpheuz.h"
 
 // Change CHART_VER only if the ChartData struct changes
-#define CHART_VER 42
+#define CHART_VER 43
 typedef struct {
   uint8_t chart_ver;
   uint32_t base;
   uint16_t gone_off;
   uint8_t highest_entry;
-  uint16_t points[LIMIT];
-  bool ignore[LIMIT];
+  uint8_t points[PACKED_POINTS_SIZE(LIMIT)];
+  uint8_t ignore[IGNORE_BITSET_SIZE];
   uint8_t snoozes;
   uint32_t from;
   uint32_t to;
   bool smart;
 } ChartData;
 
+#ifdef ENABLE_HISTORY
+
+// Change HISTORY_VER only if the HistoryIndex struct or the night encoding changes
+#define HISTORY_VER 1
+typedef struct {
+  uint32_t base;
+  int32_t checksum;
+  uint8_t length;
+  uint8_t segments;
+} HistoryNight;
+
+typedef struct {
+  uint8_t history_ver;
+  uint8_t newest;
+  HistoryNight nights[HISTORY_NIGHTS];
+} HistoryIndex;
+
+void history_read_index(HistoryIndex *index);
+uint32_t history_night_base(HistoryIndex *index, uint8_t nights_ago);
+bool history_read_night(HistoryIndex *index, uint8_t nights_ago, ChartData *chart);
+uint8_t history_count();
+
+#endif
+
 
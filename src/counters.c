@@ -0,0 +1,106 @@
+/*
+ * Morpheuz Sleep Monitor
+ *
+ * Copyright (c) 2013-2016 James Fowler
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include "pebble.h"
+#include "morpheuz.h"
+
+#ifdef ENABLE_COUNTERS
+
+/*
+ * What the app has done over the night - how often the accelerometer called, how long that took,
+ * what was drawn, said to the phone, written to flash and woken for. Kept under
+ * PERSIST_COUNTERS_KEY with the base of the night they belong to, so a restart during the night
+ * carries on counting and a new night starts from nothing.
+ */
+typedef struct {
+  uint32_t base;
+  uint32_t values[COUNTERS];
+} Counters;
+
+static Counters counters;
+
+/*
+ * Count one
+ */
+EXTFN void count_event(CounterId id) {
+  counters.values[id]++;
+}
+
+/*
+ * Count more than one (bytes or milliseconds)
+ */
+EXTFN void count_add(CounterId id, uint32_t amount) {
+  counters.values[id] += amount;
+}
+
+/*
+ * Milliseconds from some point - only good for the difference between two calls
+ */
+EXTFN uint32_t count_clock_ms() {
+  time_t seconds;
+  uint16_t ms;
+  time_ms(&seconds, &ms);
+  return (uint32_t) seconds * 1000 + ms;
+}
+
+/*
+ * Start counting a new night
+ */
+EXTFN void counters_clear() {
+  memset(&counters, 0, sizeof(counters));
+  counters.base = get_internal_data()->base;
+}
+
+/*
+ * Pick up the counts for the night being recorded (after read_internal_data)
+ */
+EXTFN void counters_read() {
+  int read = persist_read_data(PERSIST_COUNTERS_KEY, &counters, sizeof(counters));
+  if (read != sizeof(counters) || counters.base != get_internal_data()->base) {
+    counters_clear();
+  }
+}
+
+/*
+ * Keep the counts through a restart
+ */
+EXTFN void counters_save() {
+  int written = persist_write_data(PERSIST_COUNTERS_KEY, &counters, sizeof(counters));
+  trace_persist(PERSIST_COUNTERS_KEY, written);
+  if (written != sizeof(counters)) {
+    LOG_ERROR("counters_save error (%d)", written);
+  } else {
+    count_add(COUNT_PERSIST_BYTES, written);
+  }
+}
+
+/*
+ * The counts as they stand, with those kept elsewhere filled in
+ */
+EXTFN void counters_snapshot(uint32_t *values) {
+  memcpy(values, counters.values, sizeof(counters.values));
+  values[COUNT_MASKED_SAMPLES] = get_internal_data()->masked_samples;
+  values[COUNT_RAW_DROPPED] = raw_capture_dropped();
+}
+
+#endif
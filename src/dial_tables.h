@@ -0,0 +1,47 @@
+/*
+ * Generated by host/gen_dial_tables.py from analogue.h - do not edit
+ *
+ * Offsets from the centre of the 144x144 dial for each DIAL_STEP position in the first
+ * quarter, for each ring. The other quarters are the same turned through 90 degrees.
+ */
+
+#ifndef DIAL_TABLES_H_
+#define DIAL_TABLES_H_
+
+#define DIAL_STEP 12
+#define DIAL_QUADRANT 30
+
+enum DialRings {
+  DIAL_RING_MIN,
+  DIAL_RING_HOUR,
+  DIAL_RING_CLOCK,
+  DIAL_RINGS
+};
+
+static const int8_t dial_table[DIAL_RINGS][DIAL_QUADRANT][2] = {
+  // MIN (62 pixels)
+  { { 0, -62 }, { 3, -61 }, { 6, -61 }, { 9, -61 }, { 12, -60 }, { 16, -59 }, { 19, -58 }, { 22, -57 }, { 25, -56 }, { 28, -55 }, { 30, -53 }, { 33, -51 }, { 36, -50 }, { 39, -48 }, { 41, -46 }, { 43, -43 }, { 46, -41 }, { 48, -39 }, { 50, -36 }, { 51, -33 }, { 53, -31 }, { 55, -28 }, { 56, -25 }, { 57, -22 }, { 58, -19 }, { 59, -16 }, { 60, -12 }, { 61, -9 }, { 61, -6 }, { 61, -3 } },
+  // HOUR (58 pixels)
+  { { 0, -58 }, { 3, -57 }, { 6, -57 }, { 9, -57 }, { 12, -56 }, { 15, -56 }, { 17, -55 }, { 20, -54 }, { 23, -52 }, { 26, -51 }, { 28, -50 }, { 31, -48 }, { 34, -46 }, { 36, -45 }, { 38, -43 }, { 41, -41 }, { 43, -38 }, { 45, -36 }, { 46, -34 }, { 48, -31 }, { 50, -29 }, { 51, -26 }, { 52, -23 }, { 54, -20 }, { 55, -17 }, { 56, -15 }, { 56, -12 }, { 57, -9 }, { 57, -6 }, { 57, -3 } },
+  // CLOCK (66 pixels)
+  { { 0, -66 }, { 3, -65 }, { 6, -65 }, { 10, -65 }, { 13, -64 }, { 17, -63 }, { 20, -62 }, { 23, -61 }, { 26, -60 }, { 29, -58 }, { 32, -57 }, { 35, -55 }, { 38, -53 }, { 41, -51 }, { 44, -49 }, { 46, -46 }, { 49, -44 }, { 51, -41 }, { 53, -38 }, { 55, -35 }, { 57, -33 }, { 58, -29 }, { 60, -26 }, { 61, -23 }, { 62, -20 }, { 63, -17 }, { 64, -13 }, { 65, -10 }, { 65, -6 }, { 65, -3 } }
+};
+
+/*
+ * Point on a ring for a position (0 to 1440 / DIAL_STEP - 1, clockwise from 12)
+ */
+static inline GPoint dial_point(GPoint center, uint8_t ring, uint8_t position) {
+  const int8_t *d = dial_table[ring][position % DIAL_QUADRANT];
+  switch (position / DIAL_QUADRANT) {
+    case 1:
+      return GPoint(center.x - d[1], center.y + d[0]);
+    case 2:
+      return GPoint(center.x - d[0], center.y - d[1]);
+    case 3:
+      return GPoint(center.x + d[1], center.y - d[0]);
+    default:
+      return GPoint(center.x + d[0], center.y + d[1]);
+  }
+}
+
+#endif /* DIAL_TABLES_H_ */
@@ -0,0 +1,283 @@
+/*
+ * Morpheuz Sleep Monitor
+ *
+ * Copyright (c) 2013-2016 James Fowler
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "pebble.h"
+#include "morpheuz.h"
+#include "chart.h"
+
+#ifdef ENABLE_HISTORY
+
+/*
+ * History of previous nights. A small index under PERSIST_HISTORY_KEY holds the base time, size,
+ * segment count and checksum of each night in a ring of HISTORY_NIGHTS. Each night is compressed
+ * and spread over up to HISTORY_MAX_SEGMENTS keys from PERSIST_HISTORY_SEGMENT_KEY, so one night
+ * can be read without touching the others.
+ *
+ * A night is encoded as highest_entry, flags (1 = smart), snoozes, then gone_off, from and to as
+ * varints, the ignore flags as a bitset and finally each point as a zigzag varint of the difference
+ * from the one before.
+ */
+
+#define HISTORY_BUFFER_SIZE (HISTORY_SEGMENT_SIZE * HISTORY_MAX_SEGMENTS - 1)
+#define HISTORY_FLAG_SMART 1
+
+/*
+ * Add a varint - false if it doesn't fit
+ */
+static bool put_varint(uint8_t *buffer, uint8_t *pos, uint32_t value) {
+  do {
+    if (*pos >= HISTORY_BUFFER_SIZE) {
+      return false;
+    }
+    uint8_t byte = value & 0x7F;
+    value >>= 7;
+    buffer[(*pos)++] = byte | (value != 0 ? 0x80 : 0);
+  } while (value != 0);
+  return true;
+}
+
+/*
+ * Take a varint - false if the data runs out first
+ */
+static bool get_varint(uint8_t *buffer, uint8_t *pos, uint8_t length, uint32_t *value) {
+  *value = 0;
+  for (uint8_t shift = 0; shift < 32; shift += 7) {
+    if (*pos >= length) {
+      return false;
+    }
+    uint8_t byte = buffer[(*pos)++];
+    *value |= ((uint32_t) (byte & 0x7F)) << shift;
+    if ((byte & 0x80) == 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+/*
+ * Compress the night into the buffer, returning the length (0 if it doesn't fit)
+ */
+static uint8_t encode_night(InternalData *night, ConfigData *config, uint8_t *buffer) {
+  uint8_t pos = 0;
+  buffer[pos++] = night->highest_entry;
+  buffer[pos++] = config->smart ? HISTORY_FLAG_SMART : 0;
+  buffer[pos++] = night->snoozes;
+  if (!put_varint(buffer, &pos, night->gone_off) || !put_varint(buffer, &pos, config->from) || !put_varint(buffer, &pos, config->to)) {
+    return 0;
+  }
+
+  uint8_t bitset_size = night->highest_entry / 8 + 1;
+  memcpy(buffer + pos, night->ignore, bitset_size);
+  pos += bitset_size;
+
+  int32_t previous = 0;
+  for (uint8_t i = 0; i <= night->highest_entry; i++) {
+    int32_t point = get_point(night->points, i);
+    int32_t delta = point - previous;
+    if (!put_varint(buffer, &pos, (uint32_t) ((delta << 1) ^ (delta >> 31)))) {
+      return 0;
+    }
+    previous = point;
+  }
+  return pos;
+}
+
+/*
+ * Expand a night back into chart form
+ */
+static bool decode_night(uint8_t *buffer, uint8_t length, ChartData *chart) {
+  uint8_t pos = 3;
+  uint32_t gone_off, from, to;
+  if (length < pos || buffer[0] >= LIMIT || !get_varint(buffer, &pos, length, &gone_off) || !get_varint(buffer, &pos, length, &from)
+      || !get_varint(buffer, &pos, length, &to)) {
+    return false;
+  }
+  memset(chart, 0, sizeof(ChartData));
+  chart->chart_ver = CHART_VER;
+  chart->highest_entry = buffer[0];
+  chart->smart = buffer[1] & HISTORY_FLAG_SMART;
+  chart->snoozes = buffer[2];
+  chart->gone_off = gone_off;
+  chart->from = from;
+  chart->to = to;
+
+  uint8_t bitset_size = chart->highest_entry / 8 + 1;
+  if (pos + bitset_size > length) {
+    return false;
+  }
+  memcpy(chart->ignore, buffer + pos, bitset_size);
+  pos += bitset_size;
+
+  int32_t previous = 0;
+  for (uint8_t i = 0; i <= chart->highest_entry; i++) {
+    uint32_t zigzag;
+    if (!get_varint(buffer, &pos, length, &zigzag)) {
+      return false;
+    }
+    previous += (int32_t) (zigzag >> 1) ^ -(int32_t) (zigzag & 1);
+    set_point(chart->points, i, previous);
+  }
+  return true;
+}
+
+/*
+ * Key for a segment of the night in a slot of the ring
+ */
+static uint32_t segment_key(uint8_t slot, uint8_t segment) {
+  return PERSIST_HISTORY_SEGMENT_KEY + slot * HISTORY_MAX_SEGMENTS + segment;
+}
+
+/*
+ * Read the index (or start an empty one)
+ */
+EXTFN void history_read_index(HistoryIndex *index) {
+  int read = persist_read_data(PERSIST_HISTORY_KEY, index, sizeof(HistoryIndex));
+  if (read != sizeof(HistoryIndex) || index->history_ver != HISTORY_VER || index->newest >= HISTORY_NIGHTS) {
+    memset(index, 0, sizeof(HistoryIndex));
+    index->history_ver = HISTORY_VER;
+    index->newest = HISTORY_NIGHTS - 1;
+  }
+}
+
+/*
+ * Add the night just finished to the ring, replacing the oldest. Called before the internal data
+ * is cleared for the next night; one that never got past its first segment isn't kept. Only the
+ * segments the night needs are written, and any left over from the night it replaces are deleted.
+ */
+EXTFN void history_store_night() {
+  InternalData *night = get_internal_data();
+  if (!night->has_been_reset || night->base == 0 || night->highest_entry == 0) {
+    return;
+  }
+
+  HistoryIndex index;
+  history_read_index(&index);
+
+  // Same night stored already (e.g. a reset straight after a reset)
+  if (index.nights[index.newest].base == night->base) {
+    return;
+  }
+
+  uint8_t buffer[HISTORY_BUFFER_SIZE];
+  uint8_t length = encode_night(night, get_config_data(), buffer);
+  if (length == 0) {
+    LOG_ERROR("history_store_night too big");
+    return;
+  }
+
+  uint8_t slot = (index.newest + 1) % HISTORY_NIGHTS;
+  HistoryNight *entry = &index.nights[slot];
+  uint8_t segments = (length + HISTORY_SEGMENT_SIZE - 1) / HISTORY_SEGMENT_SIZE;
+  for (uint8_t segment = 0; segment < segments; segment++) {
+    uint8_t offset = segment * HISTORY_SEGMENT_SIZE;
+    uint8_t size = length - offset < HISTORY_SEGMENT_SIZE ? length - offset : HISTORY_SEGMENT_SIZE;
+    int written = persist_write_data(segment_key(slot, segment), buffer + offset, size);
+    trace_persist(segment_key(slot, segment), written);
+    if (written != size) {
+      LOG_ERROR("history_store_night error (%d)", written);
+      return;
+    }
+    count_add(COUNT_PERSIST_BYTES, written);
+  }
+  for (uint8_t segment = segments; segment < entry->segments; segment++) {
+    persist_delete(segment_key(slot, segment));
+  }
+
+  entry->base = night->base;
+  entry->checksum = dirty_checksum(buffer, length);
+  entry->length = length;
+  entry->segments = segments;
+  index.newest = slot;
+  LOG_DEBUG("history_store_night %d bytes %d segments", length, segments);
+  int written = persist_write_data(PERSIST_HISTORY_KEY, &index, sizeof(index));
+  trace_persist(PERSIST_HISTORY_KEY, written);
+  if (written != sizeof(index)) {
+    LOG_ERROR("history_store_night index error (%d)", written);
+  } else {
+    count_add(COUNT_PERSIST_BYTES, written);
+  }
+}
+
+/*
+ * Base time of a night in the ring from the index alone - 0 if there isn't one
+ */
+EXTFN uint32_t history_night_base(HistoryIndex *index, uint8_t nights_ago) {
+  if (nights_ago >= HISTORY_NIGHTS) {
+    return 0;
+  }
+  return index->nights[(index->newest + HISTORY_NIGHTS - nights_ago) % HISTORY_NIGHTS].base;
+}
+
+/*
+ * Read a night from the ring given its index - 0 is the most recent. False if there isn't one or it doesn't check out.
+ */
+EXTFN bool history_read_night(HistoryIndex *index, uint8_t nights_ago, ChartData *chart) {
+  if (nights_ago >= HISTORY_NIGHTS) {
+    return false;
+  }
+
+  uint8_t slot = (index->newest + HISTORY_NIGHTS - nights_ago) % HISTORY_NIGHTS;
+  HistoryNight *entry = &index->nights[slot];
+  if (entry->base == 0 || entry->segments > HISTORY_MAX_SEGMENTS) {
+    return false;
+  }
+
+  uint8_t buffer[HISTORY_BUFFER_SIZE];
+  uint8_t read_so_far = 0;
+  for (uint8_t segment = 0; segment < entry->segments; segment++) {
+    uint8_t size = entry->length - read_so_far < HISTORY_SEGMENT_SIZE ? entry->length - read_so_far : HISTORY_SEGMENT_SIZE;
+    if (persist_read_data(segment_key(slot, segment), buffer + read_so_far, size) != size) {
+      return false;
+    }
+    read_so_far += size;
+  }
+
+  if (read_so_far != entry->length || dirty_checksum(buffer, entry->length) != entry->checksum) {
+    LOG_ERROR("history_read_night checksum");
+    return false;
+  }
+
+  if (!decode_night(buffer, entry->length, chart)) {
+    return false;
+  }
+  chart->base = entry->base;
+  return true;
+}
+
+/*
+ * How many nights are held
+ */
+EXTFN uint8_t history_count() {
+  HistoryIndex index;
+  history_read_index(&index);
+  uint8_t count = 0;
+  for (uint8_t i = 0; i < HISTORY_NIGHTS; i++) {
+    if (index.nights[i].base != 0) {
+      count++;
+    }
+  }
+  return count;
+}
+
+#endif
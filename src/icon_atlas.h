@@ -0,0 +1,20 @@
+/*
+ * Generated by host/gen_icon_atlas.py from the icon images - do not edit
+ *
+ * Where each status icon sits in RESOURCE_ID_STATUS_ICONS.
+ */
+
+#ifndef ICON_ATLAS_H_
+#define ICON_ATLAS_H_
+
+#define ATLAS_BATTERY GRect(0, 0, 24, 12) // battery_icon.png
+#define ATLAS_BATTERY_CHARGE GRect(24, 0, 24, 12) // battery_charge.png
+#define ATLAS_COMMS GRect(48, 0, 9, 12) // comms.png
+#define ATLAS_BLUETOOTH GRect(57, 0, 9, 12) // bluetooth.png
+#define ATLAS_RECORD GRect(66, 0, 10, 12) // record.png
+#define ATLAS_ALARM_RING GRect(76, 0, 12, 12) // alarm-ring-icon.png
+#define ATLAS_ALARM GRect(88, 0, 12, 12) // alarm-icon.png
+#define ATLAS_IGNORE GRect(100, 0, 9, 12) // ignore.png
+#define ATLAS_EXPORT GRect(109, 0, 10, 12) // export.png
+
+#endif /* ICON_ATLAS_H_ */
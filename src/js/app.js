@@ -91,6 +91,15 @@
     }, {
       n : "lazarus",
       d : "Y"
+    }, {
+      n : "quickalarm",
+      d : "N"
+    }, {
+      n : "rawcapture",
+      d : "N"
+    }, {
+      n : "defersync",
+      d : "N"
     }, {
       n : "autoReset",
       d : "0"
@@ -222,17 +231,24 @@
 
   });
 
+  // Sliding window transmit - whether the watch has already been told about the current gap
+  var gapReported = false;
+
   /*
-   * Return a control value back ACK
+   * Return a control value back ACK (with how far we've got for windowed transmits)
    */
-  function callWatchApp(ctrlVal) {
+  function callWatchApp(ctrlVal, seqAcked) {
     function decodeKeyCtrl(ctrlVal, keyVal, name) {
       return (ctrlVal & keyVal) ? name + " " : "";
     }
-    console.log("ACK " + decodeKeyCtrl(ctrlVal, MorpheuzConfig.mConst().ctrlTransmitDone, "ctrlTransmitDone") + decodeKeyCtrl(ctrlVal, MorpheuzConfig.mConst().ctrlVersionDone, "ctrlVersionDone") + decodeKeyCtrl(ctrlVal, MorpheuzConfig.mConst().ctrlGoneOffDone, "ctrlGoneOffDone") + decodeKeyCtrl(ctrlVal, MorpheuzConfig.mConst().ctrlSnoozesDone, "ctrlSnoozesDone") + decodeKeyCtrl(ctrlVal, MorpheuzConfig.mConst().ctrlDoNext, "ctrlDoNext") + decodeKeyCtrl(ctrlVal, MorpheuzConfig.mConst().ctrlSetLastSent, "ctrlSetLastSent") + decodeKeyCtrl(ctrlVal, MorpheuzConfig.mConst().ctrlLazarus, "ctrlLazarus"));
-    Pebble.sendAppMessage({
+    console.log("ACK " + decodeKeyCtrl(ctrlVal, MorpheuzConfig.mConst().ctrlTransmitDone, "ctrlTransmitDone") + decodeKeyCtrl(ctrlVal, MorpheuzConfig.mConst().ctrlVersionDone, "ctrlVersionDone") + decodeKeyCtrl(ctrlVal, MorpheuzConfig.mConst().ctrlGoneOffDone, "ctrlGoneOffDone") + decodeKeyCtrl(ctrlVal, MorpheuzConfig.mConst().ctrlSnoozesDone, "ctrlSnoozesDone") + decodeKeyCtrl(ctrlVal, MorpheuzConfig.mConst().ctrlDoNext, "ctrlDoNext") + decodeKeyCtrl(ctrlVal, MorpheuzConfig.mConst().ctrlSetLastSent, "ctrlSetLastSent") + decodeKeyCtrl(ctrlVal, MorpheuzConfig.mConst().ctrlLazarus, "ctrlLazarus") + decodeKeyCtrl(ctrlVal, MorpheuzConfig.mConst().ctrlQuickAlarm, "ctrlQuickAlarm") + decodeKeyCtrl(ctrlVal, MorpheuzConfig.mConst().ctrlRawCapture, "ctrlRawCapture") + decodeKeyCtrl(ctrlVal, MorpheuzConfig.mConst().ctrlDeferSync, "ctrlDeferSync") + decodeKeyCtrl(ctrlVal, MorpheuzConfig.mConst().ctrlTraceDump, "ctrlTraceDump") + decodeKeyCtrl(ctrlVal, MorpheuzConfig.mConst().ctrlGap, "ctrlGap"));
+    var message = {
       "keyCtrl" : ctrlVal
-    });
+    };
+    if (typeof seqAcked !== "undefined") {
+      message.keySeq = seqAcked;
+    }
+    Pebble.sendAppMessage(message);
   }
 
   /*
@@ -243,6 +259,27 @@
     // Build a response for the watchapp
     var ctrlVal = 0;
 
+    // Windowed chunk - first and last items covered. Anything after a gap is dropped and the
+    // watch told, once, to go back to the gap. Overlaps are fine. The next item expected is
+    // kept in storage so a restarted JS doesn't accept a chunk it can't place; without it
+    // we expect the start (-4, auto reset) and the watch resends everything.
+    var seqFirst, seqLast;
+    var seqExpected = parseInt(MorpheuzUtil.getWithDef("seqExpected", "-4"), 10);
+    if (typeof e.payload.keySeq !== "undefined") {
+      var seq = parseInt(e.payload.keySeq, 10);
+      seqFirst = seq >> 16;
+      seqLast = seq & 0xFFFF;
+      console.log("MSG seq first=" + seqFirst + ", last=" + seqLast);
+      if (seqFirst > seqExpected) {
+        if (!gapReported) {
+          gapReported = true;
+          callWatchApp(MorpheuzConfig.mConst().ctrlGap, seqExpected - 1);
+        }
+        return;
+      }
+      gapReported = false;
+    }
+
     // Incoming version number
     if (typeof e.payload.keyVersion !== "undefined") {
       var version = parseInt(e.payload.keyVersion, 10);
@@ -253,6 +290,22 @@
       if (lazarus !== "N") {
         ctrlVal = ctrlVal | MorpheuzConfig.mConst().ctrlLazarus;
       }
+      var quickAlarm = MorpheuzUtil.getNoDef("quickalarm");
+      if (quickAlarm === "Y") {
+        ctrlVal = ctrlVal | MorpheuzConfig.mConst().ctrlQuickAlarm;
+      }
+      var rawCapture = MorpheuzUtil.getNoDef("rawcapture");
+      if (rawCapture === "Y") {
+        ctrlVal = ctrlVal | MorpheuzConfig.mConst().ctrlRawCapture;
+      }
+      var deferSync = MorpheuzUtil.getNoDef("defersync");
+      if (deferSync === "Y") {
+        ctrlVal = ctrlVal | MorpheuzConfig.mConst().ctrlDeferSync;
+      }
+      var traceDump = MorpheuzUtil.getNoDef("tracedump");
+      if (traceDump === "Y") {
+        ctrlVal = ctrlVal | MorpheuzConfig.mConst().ctrlTraceDump;
+      }
     }
 
     // Incoming origin timestamp - this is a reset
@@ -343,6 +396,19 @@
       ctrlVal = ctrlVal | MorpheuzConfig.mConst().ctrlDoNext | MorpheuzConfig.mConst().ctrlSetLastSent;
     }
 
+    // Incoming data points in bulk - first index then 16 bit little endian values
+    // (must follow base as a reset clears the points)
+    if (typeof e.payload.keyPoints !== "undefined") {
+      var points = e.payload.keyPoints;
+      var first = points[0];
+      var count = (points.length - 1) / 2;
+      console.log("MSG points first=" + first + ", count=" + count);
+      for (var p = 0; p < count; p++) {
+        storePointInfo(first + p, points[1 + p * 2] | (points[2 + p * 2] << 8));
+      }
+      ctrlVal = ctrlVal | MorpheuzConfig.mConst().ctrlDoNext | MorpheuzConfig.mConst().ctrlSetLastSent;
+    }
+
     // Store the snoozes
     if (typeof e.payload.keySnoozes !== "undefined") {
       var snoozes = parseInt(e.payload.keySnoozes, 10);
@@ -351,6 +417,17 @@
       ctrlVal = ctrlVal | MorpheuzConfig.mConst().ctrlSnoozesDone | MorpheuzConfig.mConst().ctrlDoNext;
     }
     
+    // Counters for the night - 32 bit little endian values (come with transmit so must be stored first)
+    if (typeof e.payload.keyCounters !== "undefined") {
+      var packed = e.payload.keyCounters;
+      var counters = [];
+      for (var c = 0; c + 3 < packed.length; c += 4) {
+        counters.push((packed[c] | (packed[c + 1] << 8) | (packed[c + 2] << 16) | (packed[c + 3] << 24)) >>> 0);
+      }
+      console.log("MSG counters=" + counters.join(","));
+      MorpheuzUtil.setNoDef("counters", counters.join(","));
+    }
+
     // Incoming transmit to automatics
     if (typeof e.payload.keyTransmit !== "undefined") {
       console.log("MSG transmit");
@@ -358,6 +435,27 @@
       ctrlVal = ctrlVal | MorpheuzConfig.mConst().ctrlTransmitDone;
     }
 
+    // Trace chunk - next and end as 16 bit little endian then 8 byte events
+    if (typeof e.payload.keyTrace !== "undefined") {
+      var chunk = e.payload.keyTrace;
+      var traceFirst = chunk[0] | (chunk[1] << 8);
+      var end = chunk[2] | (chunk[3] << 8);
+      var trace = MorpheuzUtil.getNoDef("trace");
+      if (trace === null || traceFirst !== parseInt(MorpheuzUtil.getNoDef("traceNext"), 10)) {
+        trace = "";
+      }
+      for (var t = 4; t < chunk.length; t++) {
+        trace = trace + ("0" + chunk[t].toString(16)).slice(-2);
+      }
+      var traceNext = (traceFirst + (chunk.length - 4) / 8) & 0xFFFF;
+      MorpheuzUtil.setNoDef("trace", trace);
+      MorpheuzUtil.setNoDef("traceNext", traceNext);
+      if (traceNext === end) {
+        console.log("TRACE " + trace);
+        MorpheuzUtil.setNoDef("tracedump", "N");
+      }
+    }
+
     // Fault detected
     if (typeof e.payload.keyFault !== "undefined") {
       var faultCode = parseInt(e.payload.keyFault, 10);
@@ -374,12 +472,20 @@
       ctrlVal = ctrlVal | MorpheuzConfig.mConst().ctrlDoNext | MorpheuzConfig.mConst().ctrlSetLastSent;
     }
 
+    // Windowed acks are cumulative - a base starts the sequence again
+    if (typeof seqLast !== "undefined") {
+      if (typeof e.payload.keyBase !== "undefined" || seqLast + 1 > seqExpected) {
+        seqExpected = seqLast + 1;
+      }
+      MorpheuzUtil.setNoDef("seqExpected", seqExpected);
+    }
+
     // Respond back to watchapp here - we need assured positive delivery -
     // cannot
     // trust that it has reached the phone - must make
     // sure it has reached and been processed by the Pebble App and Javascript
     if (ctrlVal !== 0) {
-      callWatchApp(ctrlVal);
+      callWatchApp(ctrlVal, typeof seqLast !== "undefined" ? seqExpected - 1 : undefined);
     }
 
   });
@@ -439,6 +545,9 @@
       MorpheuzUtil.setNoDef("swpdo", configData.swpdo);
       MorpheuzUtil.setNoDef("usage", configData.usage);
       MorpheuzUtil.setNoDef("lazarus", configData.lazarus);
+      MorpheuzUtil.setNoDef("quickalarm", configData.quickalarm);
+      MorpheuzUtil.setNoDef("rawcapture", configData.rawcapture);
+      MorpheuzUtil.setNoDef("defersync", configData.defersync);
       MorpheuzUtil.setNoDef("lifx-token", configData.lifxtoken);
       MorpheuzUtil.setNoDef("lifx-time", configData.lifxtime);
       MorpheuzUtil.setNoDef("hueip", configData.hueip);
@@ -449,6 +558,15 @@
       MorpheuzUtil.setNoDef("age", configData.age);
       MorpheuzUtil.setNoDef("doemail", configData.doemail);
 
+      // Trace dump if requested - repeated on the next version exchange until it completes
+      if (configData.tracedump === "Y") {
+        console.log("Trace dump requested");
+        MorpheuzUtil.setNoDef("tracedump", "Y");
+        MorpheuzUtil.setNoDef("trace", "");
+        MorpheuzUtil.setNoDef("traceNext", -1);
+        callWatchApp(MorpheuzConfig.mConst().ctrlTraceDump);
+      }
+
       // Test if requested
       if (configData.testsettings === "Y") {
         console.log("Test settings requested");
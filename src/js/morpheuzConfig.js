@@ -52,6 +52,11 @@
       ctrlSetLastSent : 16,
       ctrlLazarus : 32,
       ctrlSnoozesDone : 64,
+      ctrlGap : 128,
+      ctrlQuickAlarm : 256,
+      ctrlRawCapture : 512,
+      ctrlDeferSync : 2048,
+      ctrlTraceDump : 4096,
       displayDateFmt : "WWW, NNN dd, yyyy hh:mm",
       swpUrlDate : "yyyy-MM-ddThh:mm:00",
       timeout : 4000,
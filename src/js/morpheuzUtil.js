@@ -150,6 +150,7 @@
     var pLat = MorpheuzUtil.getWithDef("lat", "");
     var pLong = MorpheuzUtil.getWithDef("long", "");
     var fault = MorpheuzUtil.getWithDef("fault", 0);
+    var counters = MorpheuzUtil.getWithDef("counters", "");
 
     var extra = "";
     if (noset === "N") {
@@ -166,6 +167,9 @@
       }
       var usage = MorpheuzUtil.getWithDef("usage", "Y");
       var lazarus = MorpheuzUtil.getWithDef("lazarus", "Y");
+      var quickAlarm = MorpheuzUtil.getWithDef("quickalarm", "N");
+      var rawCapture = MorpheuzUtil.getWithDef("rawcapture", "N");
+      var deferSync = MorpheuzUtil.getWithDef("defersync", "N");
       var hueip = MorpheuzUtil.getWithDef("hueip", "");
       var hueusername = MorpheuzUtil.getWithDef("hueusername", "");
       var hueid = MorpheuzUtil.getWithDef("hueid", "");
@@ -175,10 +179,10 @@
       var doEmail = MorpheuzUtil.getWithDef("doemail", "");
       var estat = MorpheuzUtil.getWithDef("estat", "");
 
-      extra = "&pouser=" + encodeURIComponent(pouser) + "&postat=" + encodeURIComponent(postat) + "&potoken=" + encodeURIComponent(potoken) + "&swpdo=" + swpdo + "&swpstat=" + encodeURIComponent(swpstat) + "&exptime=" + encodeURIComponent(exptime) + "&usage=" + usage + "&lazarus=" + lazarus + "&lifxtoken=" + lifxToken + "&lifxtime=" + lifxTime + "&hueip=" + hueip + "&hueuser=" + encodeURIComponent(hueusername) + "&hueid=" + hueid + "&ifkey=" + ifkey + "&ifserver=" + encodeURIComponent(ifserver) + "&ifstat=" + encodeURIComponent(ifstat) + "&doemail=" + doEmail + "&estat=" + encodeURIComponent(estat);
+      extra = "&pouser=" + encodeURIComponent(pouser) + "&postat=" + encodeURIComponent(postat) + "&potoken=" + encodeURIComponent(potoken) + "&swpdo=" + swpdo + "&swpstat=" + encodeURIComponent(swpstat) + "&exptime=" + encodeURIComponent(exptime) + "&usage=" + usage + "&lazarus=" + lazarus + "&quickalarm=" + quickAlarm + "&rawcapture=" + rawCapture + "&defersync=" + deferSync + "&lifxtoken=" + lifxToken + "&lifxtime=" + lifxTime + "&hueip=" + hueip + "&hueuser=" + encodeURIComponent(hueusername) + "&hueid=" + hueid + "&ifkey=" + ifkey + "&ifserver=" + encodeURIComponent(ifserver) + "&ifstat=" + encodeURIComponent(ifstat) + "&doemail=" + doEmail + "&estat=" + encodeURIComponent(estat);
     }
 
-    var url = MorpheuzConfig.mConst().url + version + ".html" + "?base=" + base + "&graphx=" + graphx + "&fromhr=" + fromhr + "&tohr=" + tohr + "&frommin=" + frommin + "&tomin=" + tomin + "&smart=" + smart + "&vers=" + version + "&goneoff=" + goneOff + "&emailto=" + encodeURIComponent(emailto) + "&token=" + token + "&age=" + age + "&noset=" + noset + "&zz=" + snoozes + "&lat=" + pLat + "&long=" + pLong + "&fault=" + fault + extra;
+    var url = MorpheuzConfig.mConst().url + version + ".html" + "?base=" + base + "&graphx=" + graphx + "&fromhr=" + fromhr + "&tohr=" + tohr + "&frommin=" + frommin + "&tomin=" + tomin + "&smart=" + smart + "&vers=" + version + "&goneoff=" + goneOff + "&emailto=" + encodeURIComponent(emailto) + "&token=" + token + "&age=" + age + "&noset=" + noset + "&zz=" + snoozes + "&lat=" + pLat + "&long=" + pLong + "&fault=" + fault + "&ctr=" + counters + extra;
 
     console.log("url=" + url + " (len=" + url.length + ")");
     return url;
@@ -69,6 +69,9 @@ static void handle_init() {
   #ifdef PBL_RECT
   LOG_INFO("PBL_RECT");
   #endif
+
+  // Pick up the trace before anything logs - lazarus saves it on every way out, chart launch included
+  trace_read();
   
   // Create primary window
   ui.primary_window = window_create();
@@ -104,4 +107,5 @@ EXTFN int main(void) {
   handle_init();
   app_event_loop();
   lazarus();
+  return 0;
 }
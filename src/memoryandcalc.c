@@ -30,9 +30,11 @@
 VERSION_EXTERNAL;
 
 static InternalData internal_data;
+static SleepStats sleep_stats;
+static FeatureRing feature_ring;
 static ConfigData config_data;
 static bool save_config_requested = false;
-static int32_t internal_data_checksum;
+static int32_t region_checksum[INTERNAL_REGIONS];
 static bool no_record_warning = true;
 static uint8_t last_progress_highest_entry = 254;
 
@@ -44,36 +46,243 @@ static int8_t new_last_sent;
 static time_t last_request;
 static time_t last_response;
 static uint8_t last_error_code_sent = 0;
+static bool defer_sync = false;
+static bool sync_requested = false;
+static int32_t threshold_traced = -1;
+
+// Sliding window transmit - chunks sent but not yet acknowledged by the JS, oldest first
+static bool window_active = false;
+static int8_t window_next;
+static int8_t window_last[TRANSMIT_WINDOW];
+static uint8_t window_count;
+
+// Outbound queue - single value messages, most urgent first, sent one at a time as the outbox frees
+typedef struct {
+  uint32_t key;
+  int32_t value;
+} OutboundMessage;
+
+typedef enum {
+  PRIORITY_URGENT = 0,
+  PRIORITY_SUMMARY,
+  PRIORITY_POINTS
+} OutboundPriority;
+
+static OutboundMessage outbound[OUTBOUND_QUEUE_SIZE];
+static uint8_t outbound_count;
+static bool outbox_in_flight = false;
+static uint8_t backoff = 0;
+static AppTimer *backoff_timer = NULL;
+
+#ifdef ENABLE_TRACE
+// Trace dump the phone asked for - next event to send and where the trace ended when asked
+static bool trace_dumping = false;
+static uint16_t trace_dump_next;
+static uint16_t trace_dump_end;
+#endif
+
+#ifdef ENABLE_BULK_POINTS
+static bool bulk_enabled = false;
+static DataLoggingSessionRef bulk_session = NULL;
+#endif
+
+// InternalData is persisted in regions, each under its own key, so a save only writes what changed
+typedef struct {
+  uint8_t offset;
+  uint8_t size;
+} InternalRegion;
+
+#define POINTS_REGION(n) { offsetof(InternalData, points) + PACKED_POINTS_SIZE((n) * POINTS_PER_REGION), PACKED_POINTS_SIZE(POINTS_PER_REGION) }
+
+static const InternalRegion internal_regions[INTERNAL_REGIONS] = {
+  { 0, offsetof(InternalData, points) },
+  POINTS_REGION(0), POINTS_REGION(1), POINTS_REGION(2), POINTS_REGION(3), POINTS_REGION(4), POINTS_REGION(5),
+  { offsetof(InternalData, ignore), sizeof(internal_data.ignore) },
+  { offsetof(InternalData, has_been_reset), sizeof(InternalData) - offsetof(InternalData, has_been_reset) }
+};
+
+// InternalData as it was saved in one lump under PERSIST_MEMORY_KEY, before the points were
+// packed - only kept to bring saved data forward
+typedef struct {
+  uint8_t internal_ver;
+  uint32_t base;
+  uint16_t gone_off;
+  uint8_t highest_entry;
+  int8_t last_sent;
+  uint16_t points[LIMIT];
+  bool ignore[LIMIT];
+  bool has_been_reset;
+  bool gone_off_sent;
+  bool transmit_sent;
+  bool stopped;
+  uint8_t snoozes;
+  bool snoozes_sent;
+  uint8_t error_code;
+} InternalDataUnpacked;
 
 static void transmit_next_data(void *data);
+static void transmit_points_or_background_data(int8_t last_sent);
 static void reset_sleep_period_action(void *data);
 static bool at_limit(int32_t offset);
 static int32_t calc_offset();
 
 extern AppTimer *auto_shutdown_timer; 
 
+static void send_next();
+
 /*
- * Send a message to javascript
+ * Start a message to javascript
  */
-static void send_to_phone(const uint32_t key, int32_t tophone) {
-
-  Tuplet tuplet = TupletInteger(key, tophone);
+static DictionaryIterator *begin_to_phone() {
 
   DictionaryIterator *iter;
   app_message_outbox_begin(&iter);
 
   if (iter == NULL) {
     LOG_WARN("no outbox");
-    return;
   }
 
-  dict_write_tuplet(iter, &tuplet);
+  return iter;
+}
+
+/*
+ * Finish and send a message to javascript
+ */
+static bool end_to_phone(DictionaryIterator *iter) {
+
   dict_write_end(iter);
 
   if (app_message_outbox_send() == APP_MSG_OK) {
     last_request = time(NULL);
+    outbox_in_flight = true;
+    count_event(COUNT_MESSAGES_SENT);
+    return true;
+  }
+
+  return false;
+}
+
+/*
+ * Faults and the version first, then what the night came to, then points
+ */
+static OutboundPriority outbound_priority(uint32_t key) {
+  if (key == KEY_FAULT || key == KEY_VERSION) {
+    return PRIORITY_URGENT;
+  } else if (key == KEY_GONEOFF || key == KEY_SNOOZES) {
+    return PRIORITY_SUMMARY;
+  }
+  return PRIORITY_POINTS;
+}
+
+/*
+ * Queue a message behind any as urgent. There's one per key - a newer value replaces the one
+ * waiting, unless keep_newer (putting back one that failed) and there is one waiting already.
+ */
+static void queue_outbound(uint32_t key, int32_t value, bool keep_newer) {
+  for (uint8_t i = 0; i < outbound_count; i++) {
+    if (outbound[i].key == key) {
+      if (!keep_newer) {
+        outbound[i].value = value;
+      }
+      return;
+    }
+  }
+  if (outbound_count == OUTBOUND_QUEUE_SIZE) {
+    LOG_WARN("outbound full, dropping %ld", outbound[outbound_count - 1].key);
+    outbound_count--;
+  }
+  uint8_t pos = outbound_count;
+  while (pos > 0 && outbound_priority(outbound[pos - 1].key) > outbound_priority(key)) {
+    pos--;
+  }
+  memmove(outbound + pos + 1, outbound + pos, (outbound_count - pos) * sizeof(OutboundMessage));
+  outbound[pos].key = key;
+  outbound[pos].value = value;
+  outbound_count++;
+}
+
+/*
+ * Try again after a failure, waiting twice as long each time it fails in a row. Without a
+ * connection there's no point - the next minute or the reconnect will be back.
+ */
+static void backoff_done(void *data) {
+  backoff_timer = NULL;
+  // A failed window starts again from the last point the JS has - which may only have had it in
+  // progress - as the minute would
+  if (!window_active && internal_data.last_sent < (int8_t) internal_data.highest_entry) {
+    transmit_points_or_background_data(internal_data.last_sent);
+  } else {
+    send_next();
+  }
+}
+
+static void retry_later() {
+  if (backoff_timer != NULL || !bluetooth_connection_service_peek()) {
+    return;
+  }
+  uint32_t delay = SHORT_RETRY_MS << backoff;
+  if (delay < OUTBOX_BACKOFF_MAX_MS) {
+    backoff++;
+  } else {
+    delay = OUTBOX_BACKOFF_MAX_MS;
+  }
+  backoff_timer = app_timer_register(delay, backoff_done, NULL);
+}
+
+#ifdef ENABLE_COUNTERS
+/*
+ * The night's counters go with the transmit marker, so the JS has them for the report
+ */
+static void write_counters(DictionaryIterator *iter) {
+  uint32_t values[COUNTERS];
+  uint8_t packed[COUNTERS_SIZE];
+  counters_snapshot(values);
+  for (uint8_t i = 0; i < COUNTERS; i++) {
+    packed[i * 4] = values[i] & 0xFF;
+    packed[i * 4 + 1] = (values[i] >> 8) & 0xFF;
+    packed[i * 4 + 2] = (values[i] >> 16) & 0xFF;
+    packed[i * 4 + 3] = values[i] >> 24;
   }
+  dict_write_data(iter, KEY_COUNTERS, packed, COUNTERS_SIZE);
+}
+#endif
 
+/*
+ * Send the message at the front of the queue
+ */
+static void send_outbound() {
+
+  DictionaryIterator *iter = begin_to_phone();
+
+  if (iter == NULL) {
+    retry_later();
+    return;
+  }
+
+  Tuplet tuplet = TupletInteger(outbound[0].key, outbound[0].value);
+  dict_write_tuplet(iter, &tuplet);
+
+  #ifdef ENABLE_COUNTERS
+  if (outbound[0].key == KEY_TRANSMIT) {
+    write_counters(iter);
+  }
+  #endif
+
+  if (end_to_phone(iter)) {
+    trace_event(TRACE_SEND, 0, outbound[0].key);
+    outbound_count--;
+    memmove(outbound, outbound + 1, outbound_count * sizeof(OutboundMessage));
+  } else {
+    retry_later();
+  }
+}
+
+/*
+ * Send a message to javascript
+ */
+static void send_to_phone(const uint32_t key, int32_t tophone) {
+  queue_outbound(key, tophone, false);
+  send_next();
 }
 
 /*
@@ -90,6 +299,224 @@ static void send_point(uint8_t point, uint16_t biggest, bool ignore) {
   send_to_phone(KEY_POINT, to_phone);
 }
 
+/*
+ * One of the header values that precede the points - returns the key
+ */
+static uint32_t header_value(int8_t last_sent, int32_t *value) {
+  switch (last_sent) {
+    case -4:
+      *value = config_data.auto_reset ? 1 : 0;
+      return KEY_AUTO_RESET;
+    case -3:
+      *value = config_data.smart ? (int32_t) config_data.from : -1;
+      return KEY_FROM;
+    case -2:
+      *value = config_data.smart ? (int32_t) config_data.to : -1;
+      return KEY_TO;
+    default:
+      *value = internal_data.base;
+      return KEY_BASE;
+  }
+}
+
+/*
+ * Add one of the header values that precede the points
+ */
+static void write_header_value(DictionaryIterator *iter, int8_t last_sent) {
+  int32_t value;
+  uint32_t key = header_value(last_sent, &value);
+  dict_write_int32(iter, key, value);
+}
+
+/*
+ * Send the next chunk if the window has room - any outstanding header values then up to
+ * POINTS_PER_CHUNK points packed as the first index followed by each value as 16 bits little
+ * endian (5000 when ignored, as send_point). KEY_SEQ tags the chunk with the first and last
+ * items it covers so the JS can spot a gap.
+ */
+static void send_window() {
+
+  if (!window_active || window_count >= TRANSMIT_WINDOW || window_next > (int8_t) internal_data.highest_entry) {
+    return;
+  }
+
+  DictionaryIterator *iter = begin_to_phone();
+
+  if (iter == NULL) {
+    retry_later();
+    return;
+  }
+
+  int8_t next = window_next;
+  for (; next < 0; next++) {
+    write_header_value(iter, next);
+  }
+
+  uint8_t packed[POINTS_BULK_SIZE(POINTS_PER_CHUNK)];
+  uint8_t count = 0;
+  packed[0] = next;
+  for (; next <= (int8_t) internal_data.highest_entry && count < POINTS_PER_CHUNK; next++, count++) {
+    uint16_t value = get_ignore(internal_data.ignore, next) ? 5000 : get_point(internal_data.points, next);
+    packed[1 + count * 2] = value & 0xFF;
+    packed[2 + count * 2] = value >> 8;
+    previous_to_phone = join_value(next, value);
+  }
+  dict_write_data(iter, KEY_POINTS, packed, POINTS_BULK_SIZE(count));
+  dict_write_int32(iter, KEY_SEQ, join_value(window_next, next - 1));
+
+  if (end_to_phone(iter)) {
+    trace_event(TRACE_SEND, window_next - LAST_SENT_INIT, KEY_POINTS);
+    window_last[window_count++] = next - 1;
+    window_next = next;
+  } else {
+    retry_later();
+  }
+}
+
+#ifdef ENABLE_TRACE
+/*
+ * The next chunk of a trace dump - the events themselves aren't traced
+ */
+static void send_trace() {
+
+  DictionaryIterator *iter = begin_to_phone();
+
+  if (iter == NULL) {
+    retry_later();
+    return;
+  }
+
+  uint8_t chunk[TRACE_CHUNK_SIZE(TRACE_EVENTS_PER_CHUNK)];
+  TraceEvent events[TRACE_EVENTS_PER_CHUNK];
+  uint8_t count = trace_copy(trace_dump_next, events, TRACE_EVENTS_PER_CHUNK);
+  if ((uint16_t) (trace_dump_end - trace_dump_next) < count) {
+    count = trace_dump_end - trace_dump_next;
+  }
+  chunk[0] = trace_dump_next & 0xFF;
+  chunk[1] = trace_dump_next >> 8;
+  chunk[2] = trace_dump_end & 0xFF;
+  chunk[3] = trace_dump_end >> 8;
+  memcpy(chunk + 4, events, count * sizeof(TraceEvent));
+  dict_write_data(iter, KEY_TRACE, chunk, TRACE_CHUNK_SIZE(count));
+
+  if (end_to_phone(iter)) {
+    trace_dump_next += count;
+    trace_dumping = trace_dump_next != trace_dump_end;
+  } else {
+    retry_later();
+  }
+}
+#endif
+
+/*
+ * One message to the outbox if it's free - urgent ones, then the window's chunks, then the rest.
+ * An outbox that has been quiet for a minute has lost its callback and counts as free.
+ */
+static void send_next() {
+  if ((outbox_in_flight && time(NULL) - last_request < ONE_MINUTE) || backoff_timer != NULL) {
+    return;
+  }
+  outbox_in_flight = false;
+  if (outbound_count > 0 && outbound_priority(outbound[0].key) < PRIORITY_POINTS) {
+    send_outbound();
+    return;
+  }
+  send_window();
+  if (!outbox_in_flight && backoff_timer == NULL && outbound_count > 0) {
+    send_outbound();
+  }
+  #ifdef ENABLE_TRACE
+  if (!outbox_in_flight && backoff_timer == NULL && trace_dumping) {
+    send_trace();
+  }
+  #endif
+}
+
+/*
+ * Open the window at an item - either where the JS has confirmed up to or where it found a gap
+ */
+static void start_window(int8_t from) {
+  window_active = true;
+  window_next = from;
+  window_count = 0;
+  send_next();
+}
+
+/*
+ * Cumulative acknowledgement - everything up to and including acked has been stored by the JS
+ */
+static void window_ack(int8_t acked) {
+  uint8_t done = 0;
+  while (done < window_count && window_last[done] <= acked) {
+    done++;
+  }
+  window_count -= done;
+  memmove(window_last, window_last + done, window_count * sizeof(window_last[0]));
+  if (window_count == 0 && window_next > (int8_t) internal_data.highest_entry) {
+    window_active = false;
+  }
+}
+
+/*
+ * Outbox delivered to the phone - keep the pipeline full without waiting for the JS
+ */
+static void out_sent_handler(DictionaryIterator *iter, void *context) {
+  count_event(COUNT_MESSAGES_ACKED);
+  if (dict_find(iter, KEY_TRACE) == NULL) {
+    trace_acked();
+  }
+  outbox_in_flight = false;
+  backoff = 0;
+  send_next();
+}
+
+/*
+ * Outbox not delivered - if it was part of the window go back to what the JS has confirmed,
+ * otherwise put the message back. Either way back off before trying again.
+ */
+static void out_failed_handler(DictionaryIterator *iter, AppMessageResult reason, void *context) {
+  count_event(COUNT_MESSAGES_FAILED);
+  outbox_in_flight = false;
+  #ifdef ENABLE_TRACE
+  Tuple *trace_tuple = dict_find(iter, KEY_TRACE);
+  if (trace_tuple != NULL) {
+    const uint8_t *chunk = (const uint8_t *) trace_tuple->value;
+    trace_dump_next = chunk[0] | (chunk[1] << 8);
+    trace_dumping = true;
+    retry_later();
+    return;
+  }
+  #endif
+  trace_event(TRACE_FAIL, 0, reason);
+  if (dict_find(iter, KEY_SEQ) != NULL) {
+    window_active = false;
+    window_count = 0;
+  } else {
+    Tuple *tuple = dict_read_first(iter);
+    if (tuple != NULL) {
+      queue_outbound(tuple->key, tuple->value->int32, true);
+    }
+  }
+  retry_later();
+}
+
+/*
+ * The whole night has reached the phone
+ */
+static void transmit_done() {
+  internal_data.transmit_sent = true;
+  set_icon(true, IS_EXPORT);
+  // If we're waiting for previous nights data to be sent, it now has been, reset and go
+  if (complete_outstanding) {
+    app_timer_register(COMPLETE_OUTSTANDING_MS, reset_sleep_period_action, NULL);
+  }
+  // If Morpheuz has woken to send data, then once the data is sent, speed up the shutdown
+  // Normally around for 5 minutes but no need for that once data has been sent
+  if (auto_shutdown_timer != NULL) {
+    app_timer_reschedule(auto_shutdown_timer, TEN_SECONDS_MS);
+  }
+}
+
 /*
  * Incoming message handler
  */
@@ -103,26 +530,33 @@ static void in_received_handler(DictionaryIterator *iter, void *context) {
 
     // If transmit is done then mark it
     if (ctrl_value & CTRL_TRANSMIT_DONE) {
-      internal_data.transmit_sent = true;
-      set_icon(true, IS_EXPORT);
-      // If we're waiting for previous nights data to be sent, it now has been, reset and go
-      if (complete_outstanding) {
-        app_timer_register(COMPLETE_OUTSTANDING_MS, reset_sleep_period_action, NULL);
-      }
-      // If Morpheuz has woken to send data, then once the data is sent, speed up the shutdown
-      // Normally around for 5 minutes but no need for that once data has been sent
-      if (auto_shutdown_timer != NULL) {
-        app_timer_reschedule(auto_shutdown_timer, TEN_SECONDS_MS);
-      }
+      transmit_done();
     }
 
     // If version is done then mark it
     if (ctrl_value & CTRL_VERSION_DONE) {
       version_sent = true;
       config_data.lazarus = ctrl_value & CTRL_LAZARUS;
+      config_data.quick_alarm = ctrl_value & CTRL_QUICK_ALARM;
       trigger_config_save();
+      raw_capture_set(ctrl_value & CTRL_RAW_CAPTURE);
+      defer_sync = ctrl_value & CTRL_DEFER_SYNC;
+      #ifdef ENABLE_BULK_POINTS
+      bulk_enabled = ctrl_value & CTRL_BULK;
+      #endif
     }
 
+    #ifdef ENABLE_TRACE
+    // The phone wants to see the trace - everything held as it stands now
+    if (ctrl_value & CTRL_TRACE_DUMP) {
+      trace_event(TRACE_DUMP, 0, 0);
+      trace_dump_next = trace_oldest();
+      trace_dump_end = trace_next();
+      trace_dumping = true;
+      send_next();
+    }
+    #endif
+
     // If gone off is done then mark that
     if (ctrl_value & CTRL_GONEOFF_DONE) {
       internal_data.gone_off_sent = true;
@@ -133,16 +567,34 @@ static void in_received_handler(DictionaryIterator *iter, void *context) {
       internal_data.snoozes_sent = true;
     }
 
+    // Windowed acks say how far the JS has got
+    Tuple *seq_tuple = dict_find(iter, KEY_SEQ);
+
     // Only let the last sent become it's new value after confirmation
     // from the JS
     if (ctrl_value & CTRL_SET_LAST_SENT) {
-      LOG_DEBUG("in_received_handler - CTRL_SET_LAST_SENT to %d", new_last_sent);
-      internal_data.last_sent = new_last_sent;
+      if (seq_tuple) {
+        internal_data.last_sent = seq_tuple->value->int32;
+        window_ack(internal_data.last_sent);
+      } else {
+        internal_data.last_sent = new_last_sent;
+      }
+      LOG_DEBUG("in_received_handler - CTRL_SET_LAST_SENT to %d", internal_data.last_sent);
+    }
+
+    // JS missed a chunk - resend from the gap only
+    if ((ctrl_value & CTRL_GAP) && seq_tuple) {
+      internal_data.last_sent = seq_tuple->value->int32;
+      start_window(internal_data.last_sent + 1);
     }
 
     // If the request is to continue then do so.
     if (ctrl_value & CTRL_DO_NEXT) {
-      app_timer_register(SHORT_RETRY_MS, transmit_next_data, NULL);
+      if (window_active) {
+        send_next();
+      } else {
+        app_timer_register(SHORT_RETRY_MS, transmit_next_data, NULL);
+      }
     }
 
     // Yes - must have comms
@@ -177,45 +629,107 @@ EXTFN void open_comms() {
 
   // Register message handlers
   app_message_register_inbox_received(in_received_handler);
+  app_message_register_outbox_sent(out_sent_handler);
+  app_message_register_outbox_failed(out_failed_handler);
 
   // Incoming size
-  Tuplet in_values[] = { TupletInteger(KEY_CTRL, 0) };
+  Tuplet in_values[] = { TupletInteger(KEY_CTRL, 0), TupletInteger(KEY_SEQ, 0) };
 
   uint32_t inbound_size = dict_calc_buffer_size_from_tuplets(in_values, ARRAY_LENGTH(in_values)) + FUDGE;
 
-  LOG_DEBUG("I(%ld) O(%ld)", inbound_size, inbound_size);
+  // Outgoing size - biggest is a chunk with the header values, its points and the sequence
+  uint32_t outbound_size = dict_calc_buffer_size(6, sizeof(int32_t), sizeof(int32_t), sizeof(int32_t), sizeof(int32_t), POINTS_BULK_SIZE(POINTS_PER_CHUNK), sizeof(int32_t)) + FUDGE;
+
+  #ifdef ENABLE_COUNTERS
+  // Unless the transmit marker with the counters is bigger
+  uint32_t transmit_size = dict_calc_buffer_size(2, sizeof(int32_t), COUNTERS_SIZE) + FUDGE;
+  if (transmit_size > outbound_size) {
+    outbound_size = transmit_size;
+  }
+  #endif
+
+  #ifdef ENABLE_TRACE
+  // Or a chunk of trace
+  uint32_t trace_size = dict_calc_buffer_size(1, TRACE_CHUNK_SIZE(TRACE_EVENTS_PER_CHUNK)) + FUDGE;
+  if (trace_size > outbound_size) {
+    outbound_size = trace_size;
+  }
+  #endif
+
+  LOG_DEBUG("I(%ld) O(%ld)", inbound_size, outbound_size);
 
   // Open buffers
-  app_message_open(inbound_size, inbound_size);
+  app_message_open(inbound_size, outbound_size);
 
   // Tell JS our version and keep trying until a reply happens
   app_timer_register(VERSION_SEND_INTERVAL_MS, send_version, NULL);
 }
 
 /*
- * Save the internal data structure
+ * Save the internal data structure - only the regions that have changed since they were last
+ * read or written (most minutes that is one block of points)
  */
 EXTFN void save_internal_data() {
   internal_data.internal_ver = INTERNAL_VER;
-  int32_t checksum = dirty_checksum(&internal_data, sizeof(internal_data));
-  if (checksum != internal_data_checksum) {
-    LOG_DEBUG("save_internal_data (%d)", sizeof(internal_data));
-    int written = persist_write_data(PERSIST_MEMORY_KEY, &internal_data, sizeof(internal_data));
-    if (written != sizeof(internal_data)) {
-      LOG_ERROR("save_internal_data error (%d)", written);
-    } else {
-      internal_data_checksum = checksum;
+  uint8_t *data = (uint8_t *) &internal_data;
+  bool changed = false;
+  for (uint8_t i = 0; i < INTERNAL_REGIONS; i++) {
+    const InternalRegion *region = &internal_regions[i];
+    int32_t checksum = dirty_checksum(data + region->offset, region->size);
+    if (checksum != region_checksum[i]) {
+      LOG_DEBUG("save_internal_data region %d (%d)", i, region->size);
+      int written = persist_write_data(PERSIST_MEMORY_REGION_KEY + i, data + region->offset, region->size);
+      trace_persist(PERSIST_MEMORY_REGION_KEY + i, written);
+      if (written != region->size) {
+        LOG_ERROR("save_internal_data error (%d)", written);
+      } else {
+        region_checksum[i] = checksum;
+        count_add(COUNT_PERSIST_BYTES, written);
+      }
+      changed = true;
     }
-  } else {
+  }
+  if (!changed) {
     LOG_DEBUG("save_internal_data no change");
   }
 }
 
+/*
+ * Keep the features of the minute just gone. Minutes skipped over are cleared to not measured, and
+ * if the clock has gone back the ring starts again.
+ */
+EXTFN void store_minute_features(MinuteFeatures *features) {
+  uint32_t minute = time(NULL) / ONE_MINUTE - 1;
+  if (minute < feature_ring.newest || minute - feature_ring.newest >= FEATURE_MINUTES) {
+    memset(feature_ring.minutes, 0, sizeof(feature_ring.minutes));
+  } else {
+    for (uint32_t skipped = feature_ring.newest + 1; skipped < minute; skipped++) {
+      memset(&feature_ring.minutes[skipped % FEATURE_MINUTES], 0, sizeof(MinuteFeatures));
+    }
+  }
+  feature_ring.minutes[minute % FEATURE_MINUTES] = *features;
+  feature_ring.newest = minute;
+}
+
+/*
+ * Features of a recent minute - 0 is the minute just gone. False if it has dropped off the ring,
+ * was never stored or wasn't measured (dozing or skipped).
+ */
+EXTFN bool get_minute_features(uint8_t minutes_ago, MinuteFeatures *features) {
+  uint32_t minute = time(NULL) / ONE_MINUTE - 1 - minutes_ago;
+  if (feature_ring.newest == 0 || minute > feature_ring.newest || feature_ring.newest - minute >= FEATURE_MINUTES) {
+    return false;
+  }
+  *features = feature_ring.minutes[minute % FEATURE_MINUTES];
+  return features->measured;
+}
+
 /*
  * Save internal data based on a timer (every few minutes)
  */
 static void save_internal_data_timer(void *data) {
   save_internal_data();
+  trace_checkpoint();
   app_timer_register(PERSIST_MEMORY_MS, save_internal_data_timer, NULL);
 }
 
@@ -224,6 +738,48 @@ static void save_internal_data_timer(void *data) {
  */
 static void clear_internal_data() {
   memset(&internal_data, 0, sizeof(internal_data));
+  memset(&sleep_stats, 0, sizeof(sleep_stats));
+}
+
+/*
+ * Fold a completed segment into the sleep statistics
+ */
+static void sleep_stats_add(uint8_t i) {
+  if (get_ignore(internal_data.ignore, i)) {
+    return;
+  }
+
+  uint16_t value = get_point(internal_data.points, i);
+
+  // Sleep starts at the first segment where we are not moving for the whole 10 minutes
+  if (!sleep_stats.sleeping && value <= AWAKE_ABOVE) {
+    sleep_stats.sleeping = true;
+    sleep_stats.onset = i;
+  }
+  if (sleep_stats.sleeping) {
+    sleep_stats.total += value;
+    sleep_stats.count++;
+  }
+}
+
+/*
+ * Bring the sleep statistics up to highest_entry. Start again if the night has gone backwards
+ * (change of time) or a completed segment has changed.
+ */
+static void sleep_stats_update(bool rebuild) {
+  if (rebuild || sleep_stats.completed > internal_data.highest_entry) {
+    memset(&sleep_stats, 0, sizeof(sleep_stats));
+  }
+  while (sleep_stats.completed < internal_data.highest_entry) {
+    sleep_stats_add(sleep_stats.completed++);
+  }
+}
+
+/*
+ * Provide the sleep statistics to other units
+ */
+EXTFN SleepStats *get_sleep_stats() {
+  return &sleep_stats;
 }
 
 /*
@@ -237,13 +793,49 @@ static void set_progress_based_on_persist() {
   }
 }
 
+/*
+ * Bring data saved before the points were packed forward and save it in the new layout
+ */
+static void pack_internal_data(InternalDataUnpacked *unpacked) {
+  internal_data.base = unpacked->base;
+  internal_data.gone_off = unpacked->gone_off;
+  internal_data.highest_entry = unpacked->highest_entry;
+  internal_data.last_sent = unpacked->last_sent;
+  for (uint8_t i = 0; i < LIMIT; i++) {
+    set_point(internal_data.points, i, unpacked->points[i]);
+    set_ignore(internal_data.ignore, i, unpacked->ignore[i]);
+  }
+  internal_data.has_been_reset = unpacked->has_been_reset;
+  internal_data.gone_off_sent = unpacked->gone_off_sent;
+  internal_data.transmit_sent = unpacked->transmit_sent;
+  internal_data.stopped = unpacked->stopped;
+  internal_data.snoozes = unpacked->snoozes;
+  internal_data.snoozes_sent = unpacked->snoozes_sent;
+  internal_data.error_code = unpacked->error_code;
+  memset(region_checksum, 0, sizeof(region_checksum));
+  save_internal_data();
+}
+
 /*
  * Read the internal data (or create it if missing)
  */
 EXTFN void read_internal_data() {
   clear_internal_data();
-  persist_read_data(PERSIST_MEMORY_KEY, &internal_data, sizeof(internal_data));
-  internal_data_checksum = dirty_checksum(&internal_data, sizeof(internal_data));
+  if (persist_exists(PERSIST_MEMORY_REGION_KEY)) {
+    uint8_t *data = (uint8_t *) &internal_data;
+    for (uint8_t i = 0; i < INTERNAL_REGIONS; i++) {
+      persist_read_data(PERSIST_MEMORY_REGION_KEY + i, data + internal_regions[i].offset, internal_regions[i].size);
+      region_checksum[i] = dirty_checksum(data + internal_regions[i].offset, internal_regions[i].size);
+    }
+  } else if (persist_exists(PERSIST_MEMORY_KEY)) {
+    // Saved as one lump by an earlier version - pack it and move it into regions
+    InternalDataUnpacked unpacked;
+    memset(&unpacked, 0, sizeof(unpacked));
+    persist_read_data(PERSIST_MEMORY_KEY, &unpacked, sizeof(unpacked));
+    pack_internal_data(&unpacked);
+    persist_delete(PERSIST_MEMORY_KEY);
+  }
+  sleep_stats_update(true);
   analogue_set_base(internal_data.base);
   set_progress_based_on_persist();
   set_icon(internal_data.transmit_sent, IS_EXPORT);
@@ -263,8 +855,11 @@ EXTFN InternalData *get_internal_data() {
 EXTFN void save_config_data(void *data) {
   LOG_DEBUG("save_config_data (%d)", sizeof(config_data));
   int written = persist_write_data(PERSIST_CONFIG_KEY, &config_data, sizeof(config_data));
+  trace_persist(PERSIST_CONFIG_KEY, written);
   if (written != sizeof(config_data)) {
     LOG_ERROR("save_config_data error (%d)", written);
+  } else {
+    count_add(COUNT_PERSIST_BYTES, written);
   }
   save_config_requested = false;
 }
@@ -326,10 +921,13 @@ static void reset_resend_common() {
  */
 static void reset_sleep_period_action(void *data) {
   complete_outstanding = false;
+  history_store_night();
   clear_internal_data();
   reset_resend_common();
   internal_data.base = time(NULL);
   internal_data.has_been_reset = true;
+  counters_clear();
+  trace_event(TRACE_RESET, 0, 0);
   set_icon(true, IS_RECORD);
   set_icon(false, IS_IGNORE);
   analogue_set_base(internal_data.base);
@@ -409,8 +1007,9 @@ EXTFN void set_ignore_on_current_time_segment() {
     return;
   }
 
-  internal_data.ignore[offset] = !internal_data.ignore[offset];
-  set_icon(internal_data.ignore[offset], IS_IGNORE);
+  set_ignore(internal_data.ignore, offset, !get_ignore(internal_data.ignore, offset));
+  set_icon(get_ignore(internal_data.ignore, offset), IS_IGNORE);
+  sleep_stats_update(offset < sleep_stats.completed);
 
 }
 
@@ -428,19 +1027,64 @@ static void store_point_info(uint16_t point) {
   }
 
   set_icon(true, IS_RECORD);
-  set_icon(internal_data.ignore[offset], IS_IGNORE);
+  set_icon(get_ignore(internal_data.ignore, offset), IS_IGNORE);
 
   // Remember the highest entry
   internal_data.highest_entry = offset;
+  sleep_stats_update(false);
 
   // Now store entries
-  if (point > internal_data.points[offset])
-    internal_data.points[offset] = point;
+  if (point > get_point(internal_data.points, offset))
+    set_point(internal_data.points, offset, point);
 
   // Show the progress bar
   set_progress_based_on_persist();
 }
 
+/*
+ * Average movement since we went to sleep - the completed segments from the sleep statistics plus
+ * the one in progress. Points in progress can build up value over the 10 minute period, so sleep
+ * can't start on one, but once asleep it counts.
+ */
+EXTFN int32_t smart_alarm_threshold() {
+  int32_t total = sleep_stats.total;
+  int32_t count = sleep_stats.count;
+  if (sleep_stats.sleeping && !get_ignore(internal_data.ignore, internal_data.highest_entry)) {
+    total += get_point(internal_data.points, internal_data.highest_entry);
+    count++;
+  }
+
+  // Avoid a divide by zero. If this happens then it will trigger the alarm immediately.
+  return count > 0 ? total / count : 0;
+}
+
+/*
+ * Are we doing smart alarm thing - not if it has already happened or the user has requested a stop
+ */
+static bool smart_alarm_armed() {
+  return config_data.smart && internal_data.gone_off == 0 && !internal_data.stopped;
+}
+
+/*
+ * Local time of day in minutes
+ */
+static uint32_t minutes_now() {
+  time_t timeNow = time(NULL);
+  struct tm *time = localtime(&timeNow);
+  return to_mins(time->tm_hour, time->tm_min);
+}
+
+/*
+ * Is the smart alarm in its window or going to be within lead minutes
+ */
+EXTFN bool smart_alarm_due(uint16_t lead) {
+  if (!smart_alarm_armed())
+    return false;
+  uint32_t now = minutes_now();
+  uint32_t until = (config_data.from + MINS_IN_DAY - now) % MINS_IN_DAY;
+  return until <= lead || (now >= config_data.from && now <= config_data.to + 1);
+}
+
 /*
  * Perform smart alarm function
  */
@@ -450,43 +1094,26 @@ static bool smart_alarm(uint16_t point) {
   uint32_t before;
   uint32_t after;
 
-  // Are we doing smart alarm thing, we are and it has already happened or the user has requested a stop
-  if (!config_data.smart || internal_data.gone_off > 0 || internal_data.stopped)
+  if (!smart_alarm_armed())
     return false;
 
   // Are we in the right timeframe
-  time_t timeNow = time(NULL);
-  struct tm *time = localtime(&timeNow);
-  now = to_mins(time->tm_hour, time->tm_min);
+  now = minutes_now();
 
   if (now >= config_data.from && now < config_data.to) {
 
-    // Work out the average
-    bool sleeping = false;
-    int32_t total = 0;
-    int32_t novals = 0;
-    for (uint8_t i = 0; i <= internal_data.highest_entry; i++) {
-      if (!internal_data.ignore[i]) {
-        // Ignore points until we have one where we are not moving for 10 minutes and it is a point we have finished with (points in progress can built up
-        // value over the 10 minute period)
-        if (!sleeping && internal_data.points[i] <= AWAKE_ABOVE && i < internal_data.highest_entry) {
-          sleeping = true;
-        }
-        if (sleeping) {
-          novals++;
-          total += internal_data.points[i];
-        } 
-      }
-    }
-
-    // Avoid a divide by zero. If this happens then it will trigger the alarm immediately.
-    int32_t threshold = novals > 0 ? total / novals : 0;
-
     // Has the current point exceeded the threshold value
+    int32_t threshold = smart_alarm_threshold();
+    if (threshold != threshold_traced) {
+      trace_event(TRACE_THRESHOLD, 0, threshold);
+      threshold_traced = threshold;
+    }
     if (point > threshold) {
+      trace_event(TRACE_SMART, SMART_ABOVE, point);
       internal_data.gone_off = now;
       return true;
     } else {
+      trace_event(TRACE_SMART, SMART_BELOW, point);
       return false;
     }
   }
@@ -496,6 +1123,7 @@ static bool smart_alarm(uint16_t point) {
 
   // Or failing that have we hit the last minute we can
   if (now == config_data.to || before == config_data.to || after == config_data.to) {
+    trace_event(TRACE_SMART, SMART_LAST_MINUTE, point);
     internal_data.gone_off = now;
     return true;
   }
@@ -504,41 +1132,223 @@ static bool smart_alarm(uint16_t point) {
   return false;
 }
 
+/*
+ * Quick smart alarm - look at each accelerometer batch in the window rather than waiting for the
+ * minute. QUICK_ALARM_HITS of the last QUICK_ALARM_BATCHES must be over the threshold so one knock
+ * doesn't set it off. The minute check still runs as before, this can only wake earlier.
+ */
+EXTFN void quick_alarm_sample(uint16_t biggest) {
+
+  static uint8_t recent = 0;
+
+  if (!config_data.quick_alarm || !smart_alarm_armed()) {
+    recent = 0;
+    return;
+  }
+
+  uint32_t now = minutes_now();
+
+  if (now < config_data.from || now >= config_data.to) {
+    recent = 0;
+    return;
+  }
+
+  recent = ((recent << 1) | (biggest > smart_alarm_threshold())) & ((1 << QUICK_ALARM_BATCHES) - 1);
+
+  uint8_t hits = 0;
+  for (uint8_t bits = recent; bits != 0; bits >>= 1) {
+    hits += bits & 1;
+  }
+
+  if (hits >= QUICK_ALARM_HITS) {
+    trace_event(TRACE_SMART, SMART_QUICK, biggest);
+    recent = 0;
+    internal_data.gone_off = now;
+    fire_alarm();
+  }
+}
+
 static void transmit_points_or_background_data(int8_t last_sent) {
 
   LOG_DEBUG("transmit_points_or_background_data %d", last_sent);
 
-  // Otherwise service as usual
-  switch (last_sent) {
-    case -4:
-      send_to_phone(KEY_AUTO_RESET, config_data.auto_reset ? 1 : 0);
-      break;
-    case -3:
-      send_to_phone(KEY_FROM, config_data.smart ? (int32_t) config_data.from : -1);
-      break;
-    case -2:
-      send_to_phone(KEY_TO, config_data.smart ? (int32_t) config_data.to : -1);
-      break;
-    case -1:
-      send_to_phone(KEY_BASE, internal_data.base);
-      break;
-    default:
-      // We've got a problem with the accelerometer API
-      if (internal_data.error_code != 0 && internal_data.error_code != last_error_code_sent) {
-        send_to_phone(KEY_FAULT, internal_data.error_code);
-        last_error_code_sent = internal_data.error_code;
-        return;
-      }
-      send_point(last_sent, internal_data.points[last_sent], internal_data.ignore[last_sent]);
-      break;
+  // We've got a problem with the accelerometer API
+  if (last_sent >= 0 && internal_data.error_code != 0 && internal_data.error_code != last_error_code_sent) {
+    send_to_phone(KEY_FAULT, internal_data.error_code);
+    last_error_code_sent = internal_data.error_code;
+    return;
+  }
+
+  // Catching up - a window of chunks (header if still to go, then points) in flight at once. Leave
+  // one that is making progress alone, otherwise start again from here.
+  if (last_sent < (int8_t) internal_data.highest_entry) {
+    if (!window_active || time(NULL) - last_response >= ONE_MINUTE) {
+      start_window(last_sent);
+    }
+    return;
   }
+
+  // Otherwise keep the point in progress up to date
+  send_point(last_sent, get_point(internal_data.points, last_sent), get_ignore(internal_data.ignore, last_sent));
   new_last_sent = last_sent;
 }
 
+#ifdef ENABLE_BULK_POINTS
+
+/*
+ * Log items for the phone - false if data logging won't take them just now
+ */
+static bool bulk_log(BulkItem *items, uint8_t count) {
+  if (bulk_session == NULL) {
+    bulk_session = data_logging_create(BULK_TAG, DATA_LOGGING_BYTE_ARRAY, sizeof(BulkItem), true);
+    if (bulk_session == NULL) {
+      return false;
+    }
+  }
+  DataLoggingResult result = data_logging_log(bulk_session, items, count);
+  if (result != DATA_LOGGING_SUCCESS) {
+    LOG_DEBUG("bulk_log %d", result);
+    return false;
+  }
+  return true;
+}
+
+static bool bulk_log_value(uint32_t key, int32_t value) {
+  BulkItem item = { .base = internal_data.base, .key = key, .value = value };
+  return bulk_log(&item, 1);
+}
+
+/*
+ * The counters as KEY_COUNTERS items in CounterId order, all in the one log
+ */
+static bool bulk_log_counters() {
+  #ifdef ENABLE_COUNTERS
+  uint32_t values[COUNTERS];
+  BulkItem items[COUNTERS];
+  counters_snapshot(values);
+  for (uint8_t i = 0; i < COUNTERS; i++) {
+    items[i].base = internal_data.base;
+    items[i].key = KEY_COUNTERS;
+    items[i].value = values[i];
+  }
+  return bulk_log(items, COUNTERS);
+  #else
+  return true;
+  #endif
+}
+
+/*
+ * Data logging owns what it has taken and gets it to the phone whenever it can, so once logged an
+ * item counts as sent and nothing waits on the JS. Points go once complete, the one in progress
+ * only when recording stops. Then the fault, snoozes, gone off and finally the counters and the
+ * transmit marker.
+ */
+static void bulk_transmit() {
+  int8_t last = at_limit(calc_offset()) ? (int8_t) internal_data.highest_entry : (int8_t) internal_data.highest_entry - 1;
+  BulkItem items[BULK_ITEMS_PER_LOG];
+  while (internal_data.last_sent < last) {
+    int8_t next = internal_data.last_sent == LAST_SENT_INIT ? LAST_SENT_INIT : internal_data.last_sent + 1;
+    uint8_t count = 0;
+    for (; next <= last && count < BULK_ITEMS_PER_LOG; next++, count++) {
+      items[count].base = internal_data.base;
+      if (next < 0) {
+        items[count].key = header_value(next, &items[count].value);
+      } else {
+        items[count].key = KEY_POINT;
+        items[count].value = join_value(next, get_ignore(internal_data.ignore, next) ? 5000 : get_point(internal_data.points, next));
+      }
+    }
+    if (!bulk_log(items, count)) {
+      return;
+    }
+    internal_data.last_sent = next - 1;
+  }
+
+  if (internal_data.error_code != 0 && internal_data.error_code != last_error_code_sent) {
+    if (!bulk_log_value(KEY_FAULT, internal_data.error_code)) {
+      return;
+    }
+    last_error_code_sent = internal_data.error_code;
+  }
+
+  if (internal_data.snoozes > 0 && !internal_data.snoozes_sent) {
+    if (!bulk_log_value(KEY_SNOOZES, internal_data.snoozes)) {
+      return;
+    }
+    internal_data.snoozes_sent = true;
+    internal_data.gone_off_sent = false;
+  }
+
+  if (internal_data.gone_off > 0 && !internal_data.gone_off_sent) {
+    store_chart_data();
+    if (!bulk_log_value(KEY_GONEOFF, internal_data.gone_off)) {
+      return;
+    }
+    internal_data.gone_off_sent = true;
+  }
+
+  if (!internal_data.transmit_sent && at_limit(calc_offset())) {
+    store_chart_data();
+    if (bulk_log_counters() && bulk_log_value(KEY_TRANSMIT, 0)) {
+      transmit_done();
+    }
+  }
+}
+
+/*
+ * Let the phone have what has been logged on the way out
+ */
+EXTFN void bulk_finish() {
+  if (bulk_session != NULL) {
+    data_logging_finish(bulk_session);
+    bulk_session = NULL;
+  }
+}
+
+#endif
+
+/*
+ * With deferred sync the radio stays quiet overnight. The night goes to the phone in one go once
+ * the alarm has gone off, recording has stopped or run out, or a wakeup to transmit asks for it -
+ * and from then on as normal.
+ */
+static bool sync_due() {
+  return !defer_sync || sync_requested || internal_data.gone_off > 0 || at_limit(calc_offset());
+}
+
+/*
+ * Sync now, whatever the deferred sync says
+ */
+EXTFN void request_sync() {
+  sync_requested = true;
+}
+
+/*
+ * A deferred sync still to happen - points not yet sent, or a finished night not yet marked as sent
+ */
+EXTFN bool sync_outstanding() {
+  return defer_sync && internal_data.has_been_reset && !internal_data.transmit_sent
+         && (internal_data.last_sent < (int8_t) internal_data.highest_entry || at_limit(calc_offset()));
+}
+
 /*
  * Send data to phone
  */
 static void transmit_data() {
+
+  // Nothing yet if deferred
+  if (!sync_due()) {
+    previous_to_phone = DUMMY_PREVIOUS_TO_PHONE;
+    return;
+  }
+
+  #ifdef ENABLE_BULK_POINTS
+  // Data logging gets there whether or not the phone is about right now
+  if (bulk_enabled && internal_data.has_been_reset) {
+    bulk_transmit();
+    return;
+  }
+  #endif
   
   // Retry will occur on the next minute, so no connection, no sweat
   // Also don't bother if initial state or we haven't done the version handshake yet
@@ -549,8 +1359,10 @@ static void transmit_data() {
   }
   
   // No comms if the last request went unanswered (out failed handler doesn't seem to spot too much)
+  // and it may never have reached the JS, so don't let the same point be skipped
   if (last_request > last_response) {
     set_icon(false, IS_COMMS);
+    previous_to_phone = DUMMY_PREVIOUS_TO_PHONE;
   }
   
   // Send either base, from, to (if last sent is -1) or a point
@@ -29,20 +29,50 @@
 
 static uint16_t biggest_movement_in_one_minute = 0;
 
+// Activity features for the minute so far
+static uint32_t minute_activity = 0;
+static uint32_t minute_variance = 0;
+static uint8_t minute_batches = 0;
+static uint8_t minute_moving = 0;
+static uint8_t minute_bursts = 0;
+static bool last_batch_moving = false;
+
 // This would be unnecessary but it seems that certain users are not getting callbacks on accelerometer or it has did_vibrate stuck
 // Need a definitive answer on this. Since this problem also occurred early in 2.x it would now seem prudent to never remove it.
 #define MAX_ALLOWED_TIME_WITHOUT_ACCEL_CALLBACK 60
 #define MAX_VIBRATES_IN_A_ROW 48
 static time_t last_sample;
 static uint8_t vibrates_in_a_row = 0;
+static uint8_t vibe_guard = 0;
+
+// Once deeply still for DOZE_AFTER_MINUTES the accelerometer data service is swapped for the tap
+// service and a single sample every DOZE_PEEK_MS, which wakes us far less often
+static bool dozing = false;
+static uint8_t still_minutes = 0;
+static AppTimer *doze_timer = NULL;
+static AccelData doze_rest;
+
+static void accel_data_handler(AccelData *data, uint32_t num_samples);
+static void store_sample(uint16_t biggest);
 
 /*
  * Store the error code for forwarding to the client side
  */
 static void set_error_code(uint8_t new_error_code) {
+  if (!(get_internal_data()->error_code & new_error_code)) {
+    trace_event(TRACE_FAULT, new_error_code, 0);
+  }
   get_internal_data()->error_code |= new_error_code;
 }
 
+/*
+ * Count the samples lost to vibration over the night
+ */
+static void count_masked_samples(uint8_t masked) {
+  InternalData *internal_data = get_internal_data();
+  internal_data->masked_samples = (internal_data->masked_samples > UINT16_MAX - masked) ? UINT16_MAX : internal_data->masked_samples + masked;
+}
+
 /*
  * Set the on-screen status text
  */
@@ -53,6 +83,151 @@ EXTFN void set_smart_status() {
   analogue_set_smart_times();
 }
 
+/*
+ * Full rate sampling
+ */
+static void accel_full() {
+  accel_data_service_subscribe(ACCEL_SAMPLES_PER_UPDATE, accel_data_handler);
+  accel_service_set_sampling_rate(ACCEL_SAMPLING_10HZ);
+}
+
+/*
+ * Back to full rate sampling
+ */
+static void wake_from_doze() {
+  if (!dozing)
+    return;
+  dozing = false;
+  trace_event(TRACE_DOZE, 0, 0);
+  still_minutes = 0;
+  if (doze_timer != NULL) {
+    app_timer_cancel(doze_timer);
+    doze_timer = NULL;
+  }
+  accel_tap_service_unsubscribe();
+  accel_full();
+}
+
+/*
+ * How far a sample is from where we were lying when we dozed off
+ */
+static uint16_t doze_deviation(AccelData *sample) {
+  uint16_t biggest = abs(sample->x - doze_rest.x);
+  if (abs(sample->y - doze_rest.y) > biggest)
+    biggest = abs(sample->y - doze_rest.y);
+  if (abs(sample->z - doze_rest.z) > biggest)
+    biggest = abs(sample->z - doze_rest.z);
+  return biggest;
+}
+
+/*
+ * Any tap means we're moving - record it as at least light movement before going back to full rate
+ */
+static void doze_tap_handler(AccelAxisType axis, int32_t direction) {
+  AccelData sample;
+  int peeked = accel_service_peek(&sample);
+  if (peeked == 0 && sample.did_vibrate) {
+    count_masked_samples(1);
+  } else {
+    last_sample = time(NULL);
+    uint16_t biggest = peeked == 0 ? doze_deviation(&sample) : 0;
+    store_sample(biggest > LIGHT_ABOVE ? biggest : LIGHT_ABOVE + 1);
+  }
+  wake_from_doze();
+}
+
+/*
+ * A single sample while dozing, measured against where we were lying when we dozed off. This is
+ * noise sized while still, the same as a batch's deviation - anything more and we're moving.
+ */
+static void doze_peek(void *data) {
+  doze_timer = NULL;
+  AccelData sample;
+  int peeked = accel_service_peek(&sample);
+  if (peeked == 0 && sample.did_vibrate) {
+    count_masked_samples(1);
+  } else if (peeked == 0) {
+    last_sample = time(NULL);
+    uint16_t biggest = doze_deviation(&sample);
+    store_sample(biggest);
+    if (biggest > LIGHT_ABOVE) {
+      wake_from_doze();
+      return;
+    }
+  }
+  doze_timer = app_timer_register(DOZE_PEEK_MS, doze_peek, NULL);
+}
+
+/*
+ * Swap the data service for the tap service and peeks
+ */
+static void start_doze() {
+  accel_data_service_unsubscribe();
+  if (accel_service_peek(&doze_rest) != 0) {
+    accel_full();
+    return;
+  }
+  dozing = true;
+  trace_event(TRACE_DOZE, 1, 0);
+  accel_tap_service_subscribe(doze_tap_handler);
+  doze_timer = app_timer_register(DOZE_PEEK_MS, doze_peek, NULL);
+}
+
+/*
+ * Decide each minute whether the accelerometer can doze. Only while recording, never for a power
+ * nap, a ringing alarm, a raw capture or with the smart alarm window coming up.
+ */
+static void schedule_accel(uint16_t biggest) {
+  if (biggest > LIGHT_ABOVE) {
+    still_minutes = 0;
+  } else if (still_minutes < DOZE_AFTER_MINUTES) {
+    still_minutes++;
+  }
+  if (!get_icon(IS_RECORD) || is_doing_powernap() || get_icon(IS_ALARM_RING) || smart_alarm_due(DOZE_ALARM_LEAD_MINUTES) || is_raw_capturing()) {
+    wake_from_doze();
+  } else if (!dozing && still_minutes >= DOZE_AFTER_MINUTES) {
+    start_doze();
+  }
+}
+
+/*
+ * Add a batch to the minute's features
+ */
+static void add_batch_features(uint16_t biggest, BatchFeatures *features) {
+  minute_activity += features->activity;
+  minute_variance = (minute_variance > UINT32_MAX - features->variance) ? UINT32_MAX : minute_variance + features->variance;
+  if (minute_batches < UINT8_MAX) {
+    minute_batches++;
+  }
+  bool moving = biggest > LIGHT_ABOVE;
+  if (moving) {
+    minute_moving++;
+    if (!last_batch_moving && minute_bursts < UINT8_MAX) {
+      minute_bursts++;
+    }
+  }
+  last_batch_moving = moving;
+}
+
+/*
+ * Keep the minute's features and start again. Nothing is added while dozing, so a dozing minute is
+ * stored as not measured.
+ */
+static void store_features() {
+  MinuteFeatures features;
+  features.activity = minute_activity > UINT16_MAX ? UINT16_MAX : minute_activity;
+  features.rms = minute_batches > 0 ? isqrt(minute_variance / minute_batches) : 0;
+  features.bursts = minute_bursts;
+  features.moving = minute_batches > 0 ? (minute_moving > minute_batches ? minute_batches : minute_moving) * 255 / minute_batches : 0;
+  features.measured = minute_batches > 0;
+  store_minute_features(&features);
+  minute_activity = 0;
+  minute_variance = 0;
+  minute_batches = 0;
+  minute_moving = 0;
+  minute_bursts = 0;
+}
+
 /*
  * Accumumate samples every minute
  */
@@ -75,6 +250,8 @@ EXTFN uint16_t every_minute_processing() {
   uint16_t last_biggest = biggest_movement_in_one_minute;
   power_nap_check(biggest_movement_in_one_minute);
   server_processing(biggest_movement_in_one_minute);
+  schedule_accel(biggest_movement_in_one_minute);
+  store_features();
   biggest_movement_in_one_minute = 0;
   return last_biggest;
 }
@@ -99,63 +276,153 @@ static uint16_t scale_accel(int16_t val) {
 }
 
 /*
- * Process deviation for an access
+ * Variance from a count, sum and sum of squares, rounded down
  */
-static void do_axis(int16_t val, uint16_t *biggest, uint32_t avg) {
-  uint16_t val_scale = scale_accel(val);
-  if (val_scale < avg)
-    val_scale = avg - val_scale;
-  else
-    val_scale -= avg;
-  if (val_scale > *biggest)
-    *biggest = val_scale;
+static uint32_t variance(uint32_t n, uint32_t sum, uint64_t sum_squares) {
+  return (n * sum_squares - (uint64_t) sum * sum) / ((uint64_t) n * n);
+}
+
+/*
+ * Largest deviation of any axis from its average across a batch, in one pass. The sample furthest
+ * from the average is always the smallest or largest, so a running sum, min and max per axis is
+ * all that's needed. Sums of squares and the change from the previous sample give the features
+ * while the samples are to hand.
+ *
+ * Samples taken while vibrating, and the VIBE_GUARD_SAMPLES after them while the motor runs down,
+ * are left out. guard carries the run down into the next batch. Returns false if fewer than
+ * VIBE_MIN_CLEAN_SAMPLES are left.
+ */
+EXTFN bool accel_batch_deviation(AccelData *data, uint32_t num_samples, uint8_t *guard, uint16_t *biggest, BatchFeatures *features) {
+  uint32_t sum_x = 0, sum_y = 0, sum_z = 0;
+  uint64_t sq_x = 0, sq_y = 0, sq_z = 0;
+  uint16_t min_x = UINT16_MAX, min_y = UINT16_MAX, min_z = UINT16_MAX;
+  uint16_t max_x = 0, max_y = 0, max_z = 0;
+  uint16_t last_x = 0, last_y = 0, last_z = 0;
+  bool have_last = false;
+  uint32_t activity = 0;
+  uint32_t clean = 0;
+  features->masked = 0;
+  AccelData *d = data;
+  for (uint32_t i = 0; i < num_samples; i++, d++) {
+    if (d->did_vibrate || *guard > 0) {
+      *guard = d->did_vibrate ? VIBE_GUARD_SAMPLES : *guard - 1;
+      features->masked++;
+      have_last = false;
+      continue;
+    }
+    clean++;
+    uint16_t x = scale_accel(d->x);
+    uint16_t y = scale_accel(d->y);
+    uint16_t z = scale_accel(d->z);
+    sum_x += x;
+    sum_y += y;
+    sum_z += z;
+    sq_x += (uint32_t) x * x;
+    sq_y += (uint32_t) y * y;
+    sq_z += (uint32_t) z * z;
+    if (have_last) {
+      uint32_t change = abs(x - last_x) + abs(y - last_y) + abs(z - last_z);
+      if (change > ACTIVITY_NOISE_FLOOR) {
+        activity += change - ACTIVITY_NOISE_FLOOR;
+      }
+    }
+    last_x = x;
+    last_y = y;
+    last_z = z;
+    have_last = true;
+    if (x < min_x) min_x = x;
+    if (x > max_x) max_x = x;
+    if (y < min_y) min_y = y;
+    if (y > max_y) max_y = y;
+    if (z < min_z) min_z = z;
+    if (z > max_z) max_z = z;
+  }
+
+  if (clean < VIBE_MIN_CLEAN_SAMPLES) {
+    return false;
+  }
+
+  // Integer average lies between min and max so none of these can go negative
+  uint16_t avg_x = sum_x / clean;
+  uint16_t avg_y = sum_y / clean;
+  uint16_t avg_z = sum_z / clean;
+  uint16_t deviation = 0;
+  if (max_x - avg_x > deviation) deviation = max_x - avg_x;
+  if (avg_x - min_x > deviation) deviation = avg_x - min_x;
+  if (max_y - avg_y > deviation) deviation = max_y - avg_y;
+  if (avg_y - min_y > deviation) deviation = avg_y - min_y;
+  if (max_z - avg_z > deviation) deviation = max_z - avg_z;
+  if (avg_z - min_z > deviation) deviation = avg_z - min_z;
+  *biggest = deviation;
+  features->activity = activity;
+  features->variance = variance(clean, sum_x, sq_x) + variance(clean, sum_y, sq_y) + variance(clean, sum_z, sq_z);
+  return true;
 }
 
 /*
  * Process accelerometer data
  */
-static void accel_data_handler(AccelData *data, uint32_t num_samples) {
+static void accel_batch(AccelData *data, uint32_t num_samples) {
   
   #ifndef ACC_FAILURE_TEST
-  // Last time callback was invoked
-  last_sample = time(NULL);
+  // Last time callback was invoked - a long wait for it goes in the trace
+  time_t now = time(NULL);
+  if (now - last_sample > TRACE_ACCEL_GAP_SECONDS) {
+    trace_event(TRACE_ACCEL_GAP, 0, now - last_sample > UINT16_MAX ? UINT16_MAX : now - last_sample);
+  }
+  last_sample = now;
   #endif
 
-  // Average the data
-  uint32_t avg_x = 0;
-  uint32_t avg_y = 0;
-  uint32_t avg_z = 0;
-  AccelData *dx = data;
-  for (uint32_t i = 0; i < num_samples; i++, dx++) {
-    // If vibe went off then discount everything - we're only loosing a 2.5 second set of samples, better than an
-    // unwanted spike. We count these as more than 48 (i.e. 2 minutes) in a row this might indicate a problem. We disregard if we are sounding the alarm.
-    if (dx->did_vibrate) {
-      if (!get_icon(IS_ALARM_RING)) {
-        vibrates_in_a_row++;
-      }
-      return;
+  // Research nights keep everything, vibrations included
+  raw_capture_batch(data, num_samples);
+
+  // Samples taken while the vibe was going are left out. If that leaves too few the batch goes - better than an
+  // unwanted spike. We count these as more than 48 (i.e. 2 minutes) in a row this might indicate a problem. We disregard if we are sounding the alarm.
+  uint16_t biggest;
+  BatchFeatures features;
+  bool usable = accel_batch_deviation(data, num_samples, &vibe_guard, &biggest, &features);
+  if (features.masked > 0) {
+    count_masked_samples(features.masked);
+  }
+  if (!usable) {
+    count_event(COUNT_DISCARDED_BATCHES);
+    if (!get_icon(IS_ALARM_RING)) {
+      vibrates_in_a_row++;
+      trace_event(TRACE_VIBE_DISCARD, features.masked, vibrates_in_a_row);
     }
-    avg_x += scale_accel(dx->x);
-    avg_y += scale_accel(dx->y);
-    avg_z += scale_accel(dx->z);
+    return;
   }
   
   vibrates_in_a_row = 0;
 
-  avg_x /= num_samples;
-  avg_y /= num_samples;
-  avg_z /= num_samples;
+  store_sample(biggest);
+  add_batch_features(biggest, &features);
+  quick_alarm_sample(biggest);
+}
 
-  // Work out deviations
-  uint16_t biggest = 0;
-  AccelData *d = data;
-  for (uint32_t i = 0; i < num_samples; i++, d++) {
-    do_axis(d->x, &biggest, avg_x);
-    do_axis(d->y, &biggest, avg_y);
-    do_axis(d->z, &biggest, avg_z);
-  }
+/*
+ * Accelerometer callback - counted and timed
+ */
+static void accel_data_handler(AccelData *data, uint32_t num_samples) {
+  uint32_t started = count_clock_ms();
+  accel_batch(data, num_samples);
+  count_event(COUNT_ACCEL_CALLBACKS);
+  count_add(COUNT_ACCEL_MS, count_clock_ms() - started);
+}
 
-  store_sample(biggest);
+/*
+ * Release the accelerometer, whichever way it's being read
+ */
+EXTFN void close_accel() {
+  if (doze_timer != NULL) {
+    app_timer_cancel(doze_timer);
+    doze_timer = NULL;
+  }
+  if (dozing) {
+    accel_tap_service_unsubscribe();
+    dozing = false;
+  }
+  accel_data_service_unsubscribe();
 }
 
 /*
@@ -169,8 +436,7 @@ EXTFN void init_morpheuz() {
   open_comms();
 
   // Accelerometer
-  accel_data_service_subscribe(25, accel_data_handler);
-  accel_service_set_sampling_rate(ACCEL_SAMPLING_10HZ);
+  accel_full();
 
   // Set the smart status
   set_smart_status();
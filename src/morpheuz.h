@@ -61,8 +61,14 @@
 
 // APLITE is optimised for space, BASALT/CHALK and above are optimised for battery life
 #ifndef PBL_PLATFORM_APLITE
-  #define CACHE_ICONS
+  #define CACHE_DIAL
+  #define CACHE_PROGRESS
   #define ENABLE_CHART_VIEWER
+  #define ENABLE_HISTORY
+  #define ENABLE_RAW_CAPTURE
+  #define ENABLE_BULK_POINTS
+  #define ENABLE_COUNTERS
+  #define ENABLE_TRACE
 #endif
   
 // Only do this to make greping for external functions easier (lot of space to be saved with statics)
@@ -91,6 +97,12 @@
   
 #define POWER_NAP_SETTLE 2
 #define CLOCK_UPDATE_THRESHOLD AWAKE_ABOVE
+#define QUICK_ALARM_BATCHES 4
+#define QUICK_ALARM_HITS 2
+#define ACCEL_SAMPLES_PER_UPDATE 25
+#define DOZE_AFTER_MINUTES 10
+#define DOZE_PEEK_MS (10*1000)
+#define DOZE_ALARM_LEAD_MINUTES 15
 #define SNOOZE_PERIOD_MS (9*60*1000)
 #define POST_MENU_ACTION_DISPLAY_UPDATE_MS 900
 #define MENU_ACTION_MS 750
@@ -183,6 +195,21 @@
 #define  KEY_AUTO_RESET MESSAGE_KEY_keyAutoReset
 #define  KEY_SNOOZES MESSAGE_KEY_keySnoozes
 #define  KEY_FAULT MESSAGE_KEY_keyFault
+#define  KEY_POINTS MESSAGE_KEY_keyPoints
+#define  KEY_SEQ MESSAGE_KEY_keySeq
+#define  KEY_COUNTERS MESSAGE_KEY_keyCounters
+#define  KEY_TRACE MESSAGE_KEY_keyTrace
+
+// Bulk points - first index then 16 bits per point
+#define POINTS_BULK_SIZE(count) (1 + (count) * 2)
+
+// Sliding window transmit - chunks in flight before the JS must ack, and points per chunk
+#define TRANSMIT_WINDOW 4
+#define POINTS_PER_CHUNK 15
+
+// Single value messages waiting for the outbox (one per key), and the longest a failed send backs off
+#define OUTBOUND_QUEUE_SIZE 6
+#define OUTBOX_BACKOFF_MAX_MS (16*1000)
 
 enum CtrlValues {
   CTRL_TRANSMIT_DONE = 1,
@@ -191,7 +218,13 @@ enum CtrlValues {
   CTRL_DO_NEXT = 8,
   CTRL_SET_LAST_SENT = 16,
   CTRL_LAZARUS = 32,
-  CTRL_SNOOZES_DONE = 64
+  CTRL_SNOOZES_DONE = 64,
+  CTRL_GAP = 128,
+  CTRL_QUICK_ALARM = 256,
+  CTRL_RAW_CAPTURE = 512,
+  CTRL_BULK = 1024,
+  CTRL_DEFER_SYNC = 2048,
+  CTRL_TRACE_DUMP = 4096
 };
 
 typedef enum {
@@ -204,11 +237,104 @@ typedef enum {
   IS_EXPORT
 } IconState;
 
+// Layers redrawn through redraw_request - each marked dirty at most once per flush
+typedef enum {
+  REDRAW_ICON_BAR = 0,
+  REDRAW_PROGRESS,
+  REDRAW_DIAL,
+  REDRAW_HANDS,
+  REDRAW_TARGETS
+} RedrawTarget;
+
 enum ErrorCodes {
   ERR_ACCEL_DATA_SERVICE_SUBSCRIBE_DEAD = 1,
   ERR_ACCEL_DATA_SERVICE_SUBSCRIBE_STUCK_VIBE = 2
 };
 
+// Per night counts of what the app has done. They go to the phone with the transmit marker as
+// KEY_COUNTERS - each 32 bits little endian in this order (only add to the end).
+typedef enum {
+  COUNT_ACCEL_CALLBACKS = 0,
+  COUNT_DISCARDED_BATCHES,
+  COUNT_ACCEL_MS,
+  COUNT_DRAW_PROGRESS,
+  COUNT_DRAW_ICON_BAR,
+  COUNT_DRAW_DIAL,
+  COUNT_DRAW_HANDS,
+  COUNT_DRAW_ROUND_TIME,
+  COUNT_DRAW_CHART,
+  COUNT_MESSAGES_SENT,
+  COUNT_MESSAGES_ACKED,
+  COUNT_MESSAGES_FAILED,
+  COUNT_PERSIST_BYTES,
+  COUNT_WAKEUPS,
+  COUNT_MASKED_SAMPLES,
+  COUNT_RAW_DROPPED,
+  COUNT_REDRAW_REQUESTS,
+  COUNT_MARK_ICON_BAR,    // one per RedrawTarget, in the same order
+  COUNT_MARK_PROGRESS,
+  COUNT_MARK_DIAL,
+  COUNT_MARK_HANDS,
+  COUNT_PROGRESS_COLUMNS,
+  COUNTERS
+} CounterId;
+
+#define COUNTERS_SIZE (COUNTERS * 4)
+
+// Event trace - the last TRACE_EVENTS events kept in a ring persisted as TRACE_PAGE_EVENTS a key
+// after the PERSIST_TRACE_KEY header, at most every TRACE_SAVE_SECONDS unless something out of the
+// ordinary has happened. The phone asks for it with CTRL_TRACE_DUMP and it comes back as KEY_TRACE
+// chunks - sequence number of the first event and of the end (uint16 each, little endian) then
+// the events as TraceEvent.
+#define TRACE_EVENTS 128
+#define TRACE_PAGE_EVENTS 16
+#define TRACE_SAVE_SECONDS (30*60)
+#define TRACE_PAGES (TRACE_EVENTS / TRACE_PAGE_EVENTS)
+#define TRACE_EVENTS_PER_CHUNK 12
+#define TRACE_CHUNK_SIZE(count) (4 + (count) * sizeof(TraceEvent))
+#define TRACE_ACCEL_GAP_SECONDS 15
+typedef enum {
+  TRACE_START = 1,      // detail launch reason, value wakeup cookie
+  TRACE_EXIT,           // detail ExitReason
+  TRACE_RESET,          // new night
+  TRACE_ACCEL_GAP,      // value seconds since the last accelerometer callback
+  TRACE_VIBE_DISCARD,   // detail samples masked, value batches discarded in a row
+  TRACE_DOZE,           // detail 1 dozing, 0 awake
+  TRACE_FAULT,          // detail error code
+  TRACE_SEND,           // value key, detail first point + 4 for KEY_POINTS, TRACE_ACKED once acked
+  TRACE_ACK,            // acked when the send is no longer the last event
+  TRACE_FAIL,           // value AppMessageResult
+  TRACE_PERSIST,        // value key, detail bytes (at most 255)
+  TRACE_PERSIST_FAIL,   // value key
+  TRACE_WAKEUP,         // detail cookie (TRACE_REJECTED if refused), value minutes ahead
+  TRACE_SMART,          // detail SmartDecision, value point
+  TRACE_THRESHOLD,      // value smart alarm threshold (only when it changes)
+  TRACE_DUMP            // phone asked for the trace
+} TraceType;
+
+#define TRACE_ACKED 0x80
+#define TRACE_REJECTED 0x80
+
+typedef enum {
+  SMART_BELOW = 0,
+  SMART_ABOVE,
+  SMART_LAST_MINUTE,
+  SMART_QUICK
+} SmartDecision;
+
+typedef enum {
+  EXIT_REQUESTED = 0,
+  EXIT_LAZARUS,
+  EXIT_FOR_SYNC
+} ExitReason;
+
+typedef struct {
+  uint32_t time;
+  uint8_t type;
+  uint8_t detail;
+  uint16_t value;
+} TraceEvent;
+
 /*
  * Thresholds
  */
@@ -223,6 +349,11 @@ enum Thresholds {
 #define PERSIST_CONFIG_KEY 12122
 #define PERSIST_PRESET_KEY 12123
 #define PERSIST_CHART_KEY 12124
+#define PERSIST_HISTORY_KEY 12125
+#define PERSIST_COUNTERS_KEY 12126
+#define PERSIST_TRACE_KEY 12140
+#define PERSIST_HISTORY_SEGMENT_KEY 12200
+#define PERSIST_MEMORY_REGION_KEY 12130
 #define PERSIST_MEMORY_MS (5*60*1000)
 #define PERSIST_CONFIG_MS 30000
 #define SHORT_RETRY_MS 200
@@ -244,6 +375,32 @@ enum Thresholds {
 
 #define MINS_IN_DAY 1440
 
+// Nights kept in the history ring, each compressed into up to HISTORY_MAX_SEGMENTS keys. The
+// worst night is 137 bytes in 3 keys, so with the index, InternalData, config, presets, chart,
+// counters and trace 12 nights come to 3936 of the 4096 bytes persist allows (historycheck
+// totals it, counting 12 bytes a key)
+#define HISTORY_NIGHTS 12
+#define HISTORY_SEGMENT_SIZE 64
+#define HISTORY_MAX_SEGMENTS 4
+
+// Raw accelerometer capture goes out through data logging in pages of RAW_PAGE_SIZE. At most
+// RAW_BUFFER_PAGES are held on the watch while data logging is full, after that batches are dropped.
+#define RAW_CAPTURE_TAG 0x4D5A5243
+#define RAW_PAGE_SIZE 256
+#define RAW_BUFFER_PAGES 4
+
+// Once the phone says it takes them (CTRL_BULK) completed points and the night's summary go out
+// through data logging instead. Each item is the night's base with the key and value of the
+// AppMessage it stands in for. PebbleKit JS can't read data logging so app.js never sets the bit,
+// only a native companion would (and nightsim -B).
+#define BULK_TAG 0x4D5A5054
+#define BULK_ITEMS_PER_LOG 8
+typedef struct {
+  uint32_t base;
+  uint32_t key;
+  int32_t value;
+} BulkItem;
+
 #define TWENTY_FOUR_HOURS_IN_SECONDS (24*60*60)
 #define ELEVEN_HOURS_IN_SECONDS (11*60*60)
 #define WAKEUP_AUTO_RESTART 1
@@ -255,16 +412,28 @@ enum Thresholds {
 #define MEDIUM_PRESET 1
 #define LATE_PRESET 2
 
+// InternalData persists as a header, LIMIT / POINTS_PER_REGION blocks of points, the ignore flags
+// and the trailing state, each under PERSIST_MEMORY_REGION_KEY onwards (POINTS_PER_REGION is even
+// so that blocks start on a packed pair)
+#define POINTS_PER_REGION 10
+#define INTERNAL_REGIONS (LIMIT / POINTS_PER_REGION + 3)
+
+// Points are packed as 12 bits each (use get_point/set_point) and the ignore flags as a bitset
+// (get_ignore/set_ignore)
+#define POINT_MAX 4095
+#define PACKED_POINTS_SIZE(count) ((count) * 3 / 2)
+#define IGNORE_BITSET_SIZE ((LIMIT + 7) / 8)
+
 // Change INTERNAL_VER only if the InternalData struct changes
-#define INTERNAL_VER 45
+#define INTERNAL_VER 46
 typedef struct {
   uint8_t internal_ver;
   uint32_t base;
   uint16_t gone_off;
   uint8_t highest_entry;
   int8_t last_sent;
-  uint16_t points[LIMIT];
-  bool ignore[LIMIT];
+  uint8_t points[PACKED_POINTS_SIZE(LIMIT)];
+  uint8_t ignore[IGNORE_BITSET_SIZE];
   bool has_been_reset;
   bool gone_off_sent;
   bool transmit_sent;
@@ -272,13 +441,59 @@ typedef struct {
   uint8_t snoozes;
   bool snoozes_sent;
   uint8_t error_code;
+  uint16_t masked_samples;
 } InternalData;
 
+// Samples left out after a vibration while the motor runs down, and how few clean samples are
+// too few to make anything of a batch
+#define VIBE_GUARD_SAMPLES 3
+#define VIBE_MIN_CLEAN_SAMPLES 5
+
+// What a batch of accelerometer samples shows beyond its biggest deviation. Activity is the
+// sample to sample change above ACTIVITY_NOISE_FLOOR added up, variance the mean squared
+// deviation from the batch average summed over the axes.
+#define ACTIVITY_NOISE_FLOOR 20
+typedef struct {
+  uint32_t activity;
+  uint32_t variance;
+  uint8_t masked;
+} BatchFeatures;
+
+// One minute of activity - moving is the fraction of batches over LIGHT_ABOVE (0-255) and bursts
+// the number of runs of them that started in the minute. measured is false for a minute with no
+// batches (dozing or skipped), where everything else is zero because nothing was seen.
+typedef struct {
+  uint16_t activity;
+  uint16_t rms;
+  uint8_t bursts;
+  uint8_t moving;
+  bool measured;
+} MinuteFeatures;
+
+// The last FEATURE_MINUTES minutes, indexed by minute number, newest being the latest stored.
+// Only held in memory - it is about what is happening now, not worth the flash writes.
+#define FEATURE_MINUTES 40
+typedef struct {
+  uint32_t newest;
+  MinuteFeatures minutes[FEATURE_MINUTES];
+} FeatureRing;
+
+// Running statistics over the completed segments of the night (everything before highest_entry),
+// kept up to date as points are stored rather than worked out again from all the points. The smart
+// alarm threshold comes from them, and the chart takes when the night in progress went to sleep.
+typedef struct {
+  uint8_t completed;
+  bool sleeping;
+  uint8_t onset;
+  int32_t total;
+  int32_t count;
+} SleepStats;
+
 // Change the CONFIG_VER only if the ConfigData struct changes
 #define CONFIG_VER 42
 typedef struct {
   uint8_t config_ver;
-  bool unusedA;
+  bool quick_alarm;
   bool analogue;
   bool smart;
   bool auto_reset;
@@ -309,12 +524,18 @@ typedef struct {
 ConfigData *get_config_data();
 InternalData *get_internal_data();
 Layer * macro_layer_create(GRect frame, Layer *parent, LayerUpdateProc update_proc);
+SleepStats *get_sleep_stats();
 TextLayer* macro_text_layer_create(GRect frame, Layer *parent, GColor tcolor, GColor bcolor, GFont font, GTextAlignment text_alignment);
+bool accel_batch_deviation(AccelData *data, uint32_t num_samples, uint8_t *guard, uint16_t *biggest, BatchFeatures *features);
 bool get_icon(IconState icon);
+bool get_ignore(const uint8_t *ignore, uint8_t i);
+bool get_minute_features(uint8_t minutes_ago, MinuteFeatures *features);
 bool is_animation_complete();
 bool is_doing_powernap();
 bool is_monitoring_sleep();
 bool is_notice_showing();
+bool smart_alarm_due(uint16_t lead);
+bool sync_outstanding();
 char* am_pm_text(uint8_t hour);
 #ifdef PBL_COLOR
 GColor bar_color(uint16_t height);
@@ -322,7 +543,10 @@ GColor bar_color(uint16_t height);
 int main(void);
 int32_t dirty_checksum(void *data, uint8_t data_size);
 int32_t join_value(int16_t top, int16_t bottom);
+int32_t smart_alarm_threshold();
 uint16_t every_minute_processing();
+uint16_t get_point(const uint8_t *points, uint8_t i);
+uint16_t isqrt(uint32_t value);
 uint8_t twenty_four_to_twelve(uint8_t hour);
 void analogue_minute_tick();
 void analogue_powernap_text(char *text);
@@ -334,6 +558,7 @@ void analogue_window_load(Window *window);
 void analogue_window_unload();
 void bed_visible(bool value);
 void cancel_alarm();
+void close_accel();
 void close_morpheuz();
 #ifndef PBL_PLATFORM_APLITE
 void copy_time_range_into_field(char *field, size_t fsize, uint8_t fromhr, uint8_t frommin, uint8_t tohr, uint8_t tomin);
@@ -342,6 +567,8 @@ void copy_alarm_time_range_into_field(char *field, size_t fsize);
 void fire_alarm();
 void hide_notice_layer(void *data);
 void icon_bar_update_callback(Layer *layer, GContext *ctx);
+void icon_atlas_load();
+void icon_atlas_unload();
 void init_morpheuz();
 void lazarus();
 void macro_bitmap_layer_change_resource(BitmapLayerComp *comp, uint32_t new_resource_id);
@@ -357,20 +584,30 @@ void power_nap_check(uint16_t biggest);
 void power_nap_countdown();
 void power_nap_reset();
 void progress_layer_update_callback(Layer *layer, GContext *ctx);
+void quick_alarm_sample(uint16_t biggest);
 void read_config_data();
 void read_internal_data();
+void redraw_clear();
+void redraw_flush();
+void redraw_hold();
+void redraw_register(RedrawTarget target, Layer *layer);
+void redraw_request(RedrawTarget target);
 void resend_all_data(bool invoked_by_change_of_time);
+void request_sync();
 void reset_sleep_period();
 void revive_clock_on_movement(uint16_t last_movement);
 void save_config_data(void *data);
 void save_internal_data();
 void server_processing(uint16_t biggest);
 void set_icon(bool enabled, IconState icon);
+void set_ignore(uint8_t *ignore, uint8_t i, bool value);
 void set_ignore_on_current_time_segment();
 void set_next_wakeup();
+void set_point(uint8_t *points, uint8_t i, uint16_t value);
 void set_progress();
 void set_smart_status();
 void set_smart_status_on_screen(bool smart_alarm_on, char *special_text);
+void store_minute_features(MinuteFeatures *features);
 void show_alarm_visuals(bool value);
 void show_menu();
 void show_notice(uint32_t resource_id);
@@ -392,12 +629,10 @@ void voice_system_inactive();
 void copy_end_time_into_field(char *field, size_t fsize);
 #endif
 
-#ifdef CACHE_ICONS
-void init_icon_cache();
-void destroy_icon_cache();
+#ifdef CACHE_PROGRESS
+void destroy_progress_cache();
 #else
-#define init_icon_cache() 
-#define destroy_icon_cache() 
+#define destroy_progress_cache()
 #endif
 
 #ifdef ENABLE_CHART_VIEWER
@@ -412,4 +647,64 @@ void destroy_icon_cache();
   #define is_chart_showing() false
 #endif
 
+#ifdef ENABLE_HISTORY
+  void history_store_night();
+#else
+  #define history_store_night()
+#endif
+
+#ifdef ENABLE_RAW_CAPTURE
+  void raw_capture_batch(AccelData *data, uint32_t num_samples);
+  bool is_raw_capturing();
+  void raw_capture_set(bool enabled);
+  uint16_t raw_capture_dropped();
+#else
+  #define raw_capture_batch(data, num_samples)
+  #define is_raw_capturing() false
+  #define raw_capture_set(enabled)
+  #define raw_capture_dropped() 0
+#endif
+
+#ifdef ENABLE_BULK_POINTS
+  void bulk_finish();
+#else
+  #define bulk_finish()
+#endif
+
+#ifdef ENABLE_COUNTERS
+  void count_event(CounterId id);
+  void count_add(CounterId id, uint32_t amount);
+  uint32_t count_clock_ms();
+  void counters_clear();
+  void counters_read();
+  void counters_save();
+  void counters_snapshot(uint32_t *values);
+#else
+  #define count_event(id)
+  #define count_add(id, amount) ((void) (amount))
+  #define count_clock_ms() 0
+  #define counters_clear()
+  #define counters_read()
+  #define counters_save()
+#endif
+
+#ifdef ENABLE_TRACE
+  void trace_event(TraceType type, uint8_t detail, uint16_t value);
+  void trace_acked();
+  void trace_persist(uint32_t key, int written);
+  void trace_read();
+  void trace_save();
+  void trace_checkpoint();
+  uint16_t trace_oldest();
+  uint16_t trace_next();
+  uint8_t trace_copy(uint16_t from, TraceEvent *events, uint8_t max);
+#else
+  #define trace_event(type, detail, value)
+  #define trace_acked()
+  #define trace_persist(key, written)
+  #define trace_read()
+  #define trace_save()
+  #define trace_checkpoint()
+#endif
+
 #endif /* MORPHEUZ_H_ */
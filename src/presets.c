@@ -62,8 +62,11 @@ static PresetData preset_data;
 static void save_preset_data() {
   LOG_DEBUG("save_preset_data (%d)", sizeof(preset_data));
   int written = persist_write_data(PERSIST_PRESET_KEY, &preset_data, sizeof(preset_data));
+  trace_persist(PERSIST_PRESET_KEY, written);
   if (written != sizeof(preset_data)) {
     LOG_ERROR("save_preset_data error (%d)", written);
+  } else {
+    count_add(COUNT_PERSIST_BYTES, written);
   }
 }
 
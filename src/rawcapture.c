@@ -0,0 +1,232 @@
+/*
+ * Morpheuz Sleep Monitor
+ *
+ * Copyright (c) 2013-2016 James Fowler
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "pebble.h"
+#include "morpheuz.h"
+
+#ifdef ENABLE_RAW_CAPTURE
+
+/*
+ * Raw accelerometer capture for research nights. Every batch is written as it arrives into pages
+ * of RAW_PAGE_SIZE which go out as byte array items of a data logging session tagged
+ * RAW_CAPTURE_TAG. If data logging can't take a page (the phone has been away too long) it is held
+ * and retried with the next batch; once RAW_BUFFER_PAGES are held batches are dropped and counted.
+ *
+ * A page starts with its sequence number and the batches dropped so far (uint16 each, little
+ * endian; the sequence starts again at 0 when capture does). The rest of each page carries on a
+ * stream of records, which run over from one page to the next, ended by a zero count:
+ *
+ *   uint8 count, uint8 flags (RAW_FLAG_VIBRATE - a uint32 did_vibrate bitmap follows),
+ *   uint32 seconds and uint16 ms of the first sample, uint16 ms from the first sample to the last,
+ *   int16 x, y, z of the first sample, then for each further sample the difference in x, y and z
+ *   from the one before as zigzag varints.
+ *
+ * The samples of a batch are evenly spaced so their timestamps are spread over the span.
+ */
+
+#define RAW_PAGE_HEADER 4
+#define RAW_FLAG_VIBRATE 1
+
+static DataLoggingSessionRef session = NULL;
+static uint8_t pages[RAW_BUFFER_PAGES][RAW_PAGE_SIZE];
+static uint8_t head;
+static uint8_t held;
+static uint16_t fill;
+static uint16_t seq;
+static uint16_t dropped;
+static uint8_t record[RAW_PAGE_SIZE];
+
+/*
+ * Little endian, as data logging hands it to the phone
+ */
+static uint16_t put_uint(uint8_t *buffer, uint16_t pos, uint32_t value, uint8_t size) {
+  for (uint8_t i = 0; i < size; i++) {
+    buffer[pos++] = value & 0xFF;
+    value >>= 8;
+  }
+  return pos;
+}
+
+/*
+ * Zigzag varint of a difference
+ */
+static uint16_t put_delta(uint8_t *buffer, uint16_t pos, int32_t delta) {
+  uint32_t value = ((uint32_t) delta << 1) ^ (uint32_t) (delta >> 31);
+  do {
+    uint8_t byte = value & 0x7F;
+    value >>= 7;
+    buffer[pos++] = byte | (value != 0 ? 0x80 : 0);
+  } while (value != 0);
+  return pos;
+}
+
+/*
+ * The page being filled sits after the ones held
+ */
+static uint8_t *current_page() {
+  return pages[(head + held) % RAW_BUFFER_PAGES];
+}
+
+/*
+ * Start a fresh page
+ */
+static void open_page() {
+  uint8_t *page = current_page();
+  memset(page, 0, RAW_PAGE_SIZE);
+  fill = put_uint(page, 0, seq++, sizeof(uint16_t));
+  fill = put_uint(page, fill, dropped, sizeof(uint16_t));
+}
+
+/*
+ * Hand held pages to data logging, oldest first, until it won't take any more
+ */
+static void send_held_pages() {
+  while (held > 0) {
+    DataLoggingResult result = data_logging_log(session, pages[head], 1);
+    if (result != DATA_LOGGING_SUCCESS) {
+      LOG_DEBUG("raw_capture log %d (%d held)", result, held);
+      return;
+    }
+    head = (head + 1) % RAW_BUFFER_PAGES;
+    held--;
+  }
+}
+
+/*
+ * Hold the page being filled and try to send it
+ */
+static void close_page() {
+  held++;
+  send_held_pages();
+}
+
+/*
+ * Pack one batch into the record buffer - the worst case is well under a page
+ */
+static uint16_t pack_batch(AccelData *data, uint32_t num_samples) {
+  uint32_t vibrate = 0;
+  for (uint8_t i = 0; i < num_samples; i++) {
+    if (data[i].did_vibrate) {
+      vibrate |= 1u << i;
+    }
+  }
+  uint16_t pos = put_uint(record, 0, num_samples, sizeof(uint8_t));
+  pos = put_uint(record, pos, vibrate != 0 ? RAW_FLAG_VIBRATE : 0, sizeof(uint8_t));
+  if (vibrate != 0) {
+    pos = put_uint(record, pos, vibrate, sizeof(uint32_t));
+  }
+  pos = put_uint(record, pos, data[0].timestamp / 1000, sizeof(uint32_t));
+  pos = put_uint(record, pos, data[0].timestamp % 1000, sizeof(uint16_t));
+  pos = put_uint(record, pos, data[num_samples - 1].timestamp - data[0].timestamp, sizeof(uint16_t));
+  pos = put_uint(record, pos, (uint16_t) data[0].x, sizeof(uint16_t));
+  pos = put_uint(record, pos, (uint16_t) data[0].y, sizeof(uint16_t));
+  pos = put_uint(record, pos, (uint16_t) data[0].z, sizeof(uint16_t));
+  for (uint8_t i = 1; i < num_samples; i++) {
+    pos = put_delta(record, pos, data[i].x - data[i - 1].x);
+    pos = put_delta(record, pos, data[i].y - data[i - 1].y);
+    pos = put_delta(record, pos, data[i].z - data[i - 1].z);
+  }
+  return pos;
+}
+
+/*
+ * Add a batch to the capture, unless the pages that can still be filled won't take it
+ */
+EXTFN void raw_capture_batch(AccelData *data, uint32_t num_samples) {
+  if (session == NULL || num_samples == 0 || num_samples > ACCEL_SAMPLES_PER_UPDATE) {
+    return;
+  }
+
+  send_held_pages();
+
+  uint16_t length = pack_batch(data, num_samples);
+
+  // The last free page can't be filled right up as there would be nowhere to start the next
+  uint16_t room = RAW_PAGE_SIZE - fill + (RAW_BUFFER_PAGES - 1 - held) * (RAW_PAGE_SIZE - RAW_PAGE_HEADER) - 1;
+  if (length > room) {
+    if (dropped < UINT16_MAX) {
+      dropped++;
+    }
+    return;
+  }
+
+  for (uint16_t pos = 0; pos < length;) {
+    uint16_t part = RAW_PAGE_SIZE - fill < length - pos ? RAW_PAGE_SIZE - fill : length - pos;
+    memcpy(current_page() + fill, record + pos, part);
+    fill += part;
+    pos += part;
+    if (fill == RAW_PAGE_SIZE) {
+      close_page();
+      open_page();
+    }
+  }
+}
+
+/*
+ * Whether batches are being captured
+ */
+EXTFN bool is_raw_capturing() {
+  return session != NULL;
+}
+
+/*
+ * Batches dropped since capture started
+ */
+EXTFN uint16_t raw_capture_dropped() {
+  return dropped;
+}
+
+/*
+ * Start or stop capture. Stopping sends what has been captured as far as data logging will take it.
+ */
+EXTFN void raw_capture_set(bool enabled) {
+  if (enabled == (session != NULL)) {
+    return;
+  }
+  if (enabled) {
+    session = data_logging_create(RAW_CAPTURE_TAG, DATA_LOGGING_BYTE_ARRAY, RAW_PAGE_SIZE, true);
+    if (session == NULL) {
+      LOG_ERROR("raw_capture no session");
+      return;
+    }
+    head = 0;
+    held = 0;
+    seq = 0;
+    dropped = 0;
+    open_page();
+    LOG_DEBUG("raw_capture started");
+  } else {
+    // The rest of the page is zeros, which ends the stream
+    if (fill > RAW_PAGE_HEADER) {
+      close_page();
+    } else {
+      send_held_pages();
+    }
+    LOG_DEBUG("raw_capture stopped, %d dropped, %d pages not sent", dropped, held);
+    data_logging_finish(session);
+    session = NULL;
+  }
+}
+
+#endif
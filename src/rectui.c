@@ -155,7 +155,7 @@ EXTFN void morpheuz_load(Window *window) {
 
   ui.text_date_smart_alarm_range_layer = macro_text_layer_create(GRect(0, 86, 144, 31), window_layer, GColorWhite, BACKGROUND_COLOR, fonts_get_system_font(FONT_KEY_GOTHIC_24), GTextAlignmentCenter);
 
-  init_icon_cache();
+  icon_atlas_load();
   ui.icon_bar = macro_layer_create(GRect(26, ICON_TOPS, ICON_BAR_WIDTH, 12), window_layer, &icon_bar_update_callback);
 
   ui.progress_layer = macro_layer_create(GRect(11, 157, 121, 9), window_layer, &progress_layer_update_callback);
@@ -190,21 +190,27 @@ EXTFN void morpheuz_unload(Window *window) {
   tick_timer_service_unsubscribe();
   battery_state_service_unsubscribe();
   bluetooth_connection_service_unsubscribe();
-  accel_data_service_unsubscribe();
+  close_accel();
   
   #endif
 
+  raw_capture_set(false);
+  bulk_finish();
   save_config_data(NULL);
   save_internal_data();
+  counters_save();
+  trace_save();
 
   // Save space by not clearing up on close on aplite. Feels bad, but so do crashes for no heap.
   #ifndef PBL_PLATFORM_APLITE 
   
   analogue_window_unload();
 
+  redraw_clear();
   layer_destroy(ui.progress_layer);
   layer_destroy(ui.icon_bar);
-  destroy_icon_cache();
+  icon_atlas_unload();
+  destroy_progress_cache();
 
   text_layer_destroy(ui.text_time_layer);
   text_layer_destroy(ui.text_date_smart_alarm_range_layer);
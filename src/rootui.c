@@ -26,36 +26,26 @@
 #include "morpheuz.h"
 #include "language.h"
 #include "rootui.h"
+#include "icon_atlas.h"
 
-// Icons in the bitmap cache (if we are doing this)
-typedef enum {
-  BMP_CACHE_BATTERY_ICON,
-  BMP_CACHE_BATTERY_CHARGE,
-  BMP_CACHE_COMMS_ICON,
-  BMP_CACHE_BLUETOOTH_ICON,
-  BMP_CACHE_ICON_RECORD,
-  BMP_CACHE_ALARM_RING_ICON,
-  BMP_CACHE_ALARM_ICON,
-  BMP_CACHE_IGNORE,
-  BMP_CACHE_EXPORT,
-  BMP_CACHE_TOP
-} BmpCache;
-
-// A bitmap cache entry
-typedef struct {
-  GBitmap *bitmap;
-} BmpCacheEntry;
-
-// Only if we are caching icons do we declare this
-#ifdef CACHE_ICONS
-static BmpCacheEntry bmp_cache_entries[BMP_CACHE_TOP];
-#endif
+// The status icons - one bitmap, loaded once, and a view onto whichever icon is being drawn
+static GBitmap *icon_atlas;
+static GBitmap *icon_sprite;
  
 // Private  
 static bool icon_state[MAX_ICON_STATE];
 static uint8_t previous_mday = 255;
 static time_t last_clock_update;
 static char powernap_text[3];
+static Layer *redraw_layers[REDRAW_TARGETS];
+static uint8_t redraw_pending;
+static bool redraw_held;
+
+#ifdef CACHE_PROGRESS
+// The progress bar as last drawn, and what each column held then (0 nothing, else height + 1)
+static GBitmap *progress_cache;
+static uint8_t progress_drawn[LIMIT];
+#endif
 
 // Shared with rootui, rectui, roundui, primary_window with main and notice_font with noticewindows
 UiCommon ui;
@@ -63,60 +53,93 @@ UiCommon ui;
 // Shared with menu, rootui and presets 
 char date_text[DATE_FORMAT_LEN] = "";
 
-#ifdef CACHE_ICONS
 /*
- * Set up the icon cache - make sure NULL for all entries
+ * Load the status icon atlas
  */
-EXTFN void init_icon_cache() {
-  for (uint8_t i=0; i < BMP_CACHE_TOP; i++) {
-    bmp_cache_entries[i].bitmap = NULL;
-  }
+EXTFN void icon_atlas_load() {
+  icon_atlas = gbitmap_create_with_resource(RESOURCE_ID_STATUS_ICONS);
+  icon_sprite = gbitmap_create_as_sub_bitmap(icon_atlas, ATLAS_BATTERY);
 }
 
 /*
- * Get a bitmap from cache, failing that from resources
+ * Let the status icon atlas go
  */
-static GBitmap* gbitmap_create_with_resource_cache(uint32_t resource_id, BmpCache cache_id) {
-  if (bmp_cache_entries[cache_id].bitmap == NULL) {
-    bmp_cache_entries[cache_id].bitmap = gbitmap_create_with_resource(resource_id);
-  }
-  return bmp_cache_entries[cache_id].bitmap;
+EXTFN void icon_atlas_unload() {
+  gbitmap_destroy(icon_sprite);
+  gbitmap_destroy(icon_atlas);
+  icon_sprite = NULL;
+  icon_atlas = NULL;
+}
+
+/*
+ * Say which layer is drawn for a redraw target
+ */
+EXTFN void redraw_register(RedrawTarget target, Layer *layer) {
+  redraw_layers[target] = layer;
+  redraw_pending &= ~(1 << target);
+}
+
+/*
+ * Forget all the layers - they are about to be destroyed
+ */
+EXTFN void redraw_clear() {
+  memset(redraw_layers, 0, sizeof(redraw_layers));
+  redraw_pending = 0;
 }
 
 /*
- * When caching we don't get rid of the bitmap
+ * Hold requests until redraw_flush - several things change in one minute tick and each would
+ * otherwise mark its own layer
  */
-#define gbitmap_destroy_cache(bitmap)
+EXTFN void redraw_hold() {
+  redraw_held = true;
+}
 
 /*
- * Remove all the allocated icons
+ * Mark each layer asked for once. Hidden layers are skipped as they are drawn anyway when shown
+ * and marking them still costs a frame.
  */
-EXTFN void destroy_icon_cache() {
-  for (uint8_t i=0; i < BMP_CACHE_TOP; i++) {
-    if (bmp_cache_entries[i].bitmap != NULL) {
-      gbitmap_destroy(bmp_cache_entries[i].bitmap);
+EXTFN void redraw_flush() {
+  redraw_held = false;
+  for (uint8_t target = 0; target < REDRAW_TARGETS; target++) {
+    Layer *layer = redraw_layers[target];
+    if ((redraw_pending & (1 << target)) && layer != NULL && !layer_get_hidden(layer)) {
+      count_event(COUNT_MARK_ICON_BAR + target);
+      layer_mark_dirty(layer);
     }
   }
+  redraw_pending = 0;
 }
-#else
-#define gbitmap_create_with_resource_cache(resource_id, cache_id) gbitmap_create_with_resource(resource_id)
-#define gbitmap_destroy_cache(bitmap) gbitmap_destroy(bitmap)
-#endif
 
 /*
- * Perform the clock update
+ * Ask for a layer to be redrawn - now, or at the flush if held
+ */
+EXTFN void redraw_request(RedrawTarget target) {
+  count_event(COUNT_REDRAW_REQUESTS);
+  redraw_pending |= 1 << target;
+  if (!redraw_held) {
+    redraw_flush();
+  }
+}
+
+/*
+ * Perform the clock update. Nothing to do if the time shown hasn't changed.
  */
 static void update_clock() {
   static char time_text[6];
-  clock_copy_time_string(time_text, sizeof(time_text));
-  if (time_text[4] == ' ')
-    time_text[4] = '\0';
+  char new_text[6];
+  clock_copy_time_string(new_text, sizeof(new_text));
+  if (new_text[4] == ' ')
+    new_text[4] = '\0';
+  last_clock_update = time(NULL);
+  if (strcmp(new_text, time_text) == 0)
+    return;
+  strcpy(time_text, new_text);
   text_layer_set_text(ui.text_time_layer, time_text);
   #ifdef PBL_COLOR
      text_layer_set_text(ui.text_time_shadow_layer, time_text); 
   #endif
   analogue_minute_tick();
-  last_clock_update = time(NULL);
 }
 
 /*
@@ -211,7 +234,7 @@ EXTFN bool is_animation_complete() {
 EXTFN void post_init_hook(void *data) {
   wakeup_init();
   ui.animation_count = 6; // Make it 6 so we consider is_animation_complete() will return true
-  layer_mark_dirty(ui.icon_bar);
+  redraw_request(REDRAW_ICON_BAR);
  
   // Set click provider
   window_set_click_config_provider(ui.primary_window, (ClickConfigProvider) click_config_provider);
@@ -240,7 +263,7 @@ EXTFN GColor bar_color(uint16_t height) {
 EXTFN void set_icon(bool enabled, IconState icon) {
   if (enabled != icon_state[icon]) {
     icon_state[icon] = enabled;
-    layer_mark_dirty(ui.icon_bar);
+    redraw_request(REDRAW_ICON_BAR);
   }
 }
 
@@ -270,13 +293,12 @@ EXTFN void set_smart_status_on_screen(bool smart_alarm_on, char *special_text) {
 }
 
 /*
- * Build an icon
+ * Draw an icon from the atlas
  */
-static void paint_icon(GContext *ctx, int *running_horizontal, int width, uint32_t resource_id, BmpCache cacheId) {
-  GBitmap *bitmap = gbitmap_create_with_resource_cache(resource_id, cacheId);
+static void paint_icon(GContext *ctx, int *running_horizontal, int width, GRect sprite) {
+  gbitmap_set_bounds(icon_sprite, sprite);
   *running_horizontal -= width + ICON_PAD;
-  graphics_draw_bitmap_in_rect(ctx, bitmap, GRect(*running_horizontal, 0, width, 12));
-  gbitmap_destroy_cache(bitmap);
+  graphics_draw_bitmap_in_rect(ctx, icon_sprite, GRect(*running_horizontal, 0, width, 12));
 }
 
 /*
@@ -291,7 +313,7 @@ static void battery_layer_update_callback(Layer *layer, GContext *ctx, int *runn
   #endif
 
   if (!ui.battery_plugged) {
-    paint_icon(ctx, running_horizontal, 24, RESOURCE_ID_BATTERY_ICON, BMP_CACHE_BATTERY_ICON);
+    paint_icon(ctx, running_horizontal, 24, ATLAS_BATTERY);
     graphics_context_set_stroke_color(ctx, BACKGROUND_COLOR);
     #ifdef PBL_COLOR
       GColor b_color = BATTERY_BAR_COLOR;
@@ -306,7 +328,7 @@ static void battery_layer_update_callback(Layer *layer, GContext *ctx, int *runn
     #endif
     graphics_fill_rect(ctx, GRect(*running_horizontal + 7, 4, ui.battery_level / 9, 4), 0, GCornerNone);
   } else {
-    paint_icon(ctx, running_horizontal, 24, RESOURCE_ID_BATTERY_CHARGE, BMP_CACHE_BATTERY_CHARGE);
+    paint_icon(ctx, running_horizontal, 24, ATLAS_BATTERY_CHARGE);
   }
 }
 
@@ -315,6 +337,8 @@ static void battery_layer_update_callback(Layer *layer, GContext *ctx, int *runn
  */
 EXTFN void icon_bar_update_callback(Layer *layer, GContext *ctx) {
 
+  count_event(COUNT_DRAW_ICON_BAR);
+
   int running_horizontal = ICON_BAR_WIDTH;
 
   graphics_context_set_fill_color(ctx, BACKGROUND_COLOR);
@@ -337,29 +361,27 @@ EXTFN void icon_bar_update_callback(Layer *layer, GContext *ctx) {
 
   // Comms icon / Bluetooth icon
   if (icon_state[IS_COMMS] || icon_state[IS_BLUETOOTH]) {
-    paint_icon(ctx, &running_horizontal, 9, icon_state[IS_COMMS] ? RESOURCE_ID_COMMS_ICON : RESOURCE_ID_BLUETOOTH_ICON,
-               icon_state[IS_COMMS] ? BMP_CACHE_COMMS_ICON : BMP_CACHE_BLUETOOTH_ICON);
+    paint_icon(ctx, &running_horizontal, 9, icon_state[IS_COMMS] ? ATLAS_COMMS : ATLAS_BLUETOOTH);
   }
   
   // Record icon
   if (icon_state[IS_RECORD]) {
-    paint_icon(ctx, &running_horizontal, 10, RESOURCE_ID_ICON_RECORD, BMP_CACHE_ICON_RECORD);
+    paint_icon(ctx, &running_horizontal, 10, ATLAS_RECORD);
   }
 
   // Alarm icon
   if (icon_state[IS_ALARM_RING] || icon_state[IS_ALARM]) {
-    paint_icon(ctx, &running_horizontal, 12, icon_state[IS_ALARM_RING] ? RESOURCE_ID_ALARM_RING_ICON : RESOURCE_ID_ALARM_ICON,
-              icon_state[IS_ALARM_RING] ? BMP_CACHE_ALARM_RING_ICON : BMP_CACHE_ALARM_ICON);
+    paint_icon(ctx, &running_horizontal, 12, icon_state[IS_ALARM_RING] ? ATLAS_ALARM_RING : ATLAS_ALARM);
   }
 
   // Ignore icon
   if (icon_state[IS_IGNORE]) {
-    paint_icon(ctx, &running_horizontal, 9, RESOURCE_ID_IGNORE, BMP_CACHE_IGNORE );
+    paint_icon(ctx, &running_horizontal, 9, ATLAS_IGNORE);
   }
 
   // Export icon
   if (icon_state[IS_EXPORT]) {
-    paint_icon(ctx, &running_horizontal, 9, RESOURCE_ID_EXPORT, BMP_CACHE_EXPORT);
+    paint_icon(ctx, &running_horizontal, 9, ATLAS_EXPORT);
   }
 
 }
@@ -370,46 +392,167 @@ EXTFN void icon_bar_update_callback(Layer *layer, GContext *ctx) {
 static void battery_state_handler(BatteryChargeState charge) {
   ui.battery_level = charge.charge_percent;
   ui.battery_plugged = charge.is_plugged;
-  layer_mark_dirty(ui.icon_bar);
+  redraw_request(REDRAW_ICON_BAR);
 }
 
 /*
- * Progress line
+ * What a progress column shows - 0 nothing, else the bar height + 1. Bars of 8 and over fill the
+ * layer and share a colour, so they all count as 8.
  */
-EXTFN void progress_layer_update_callback(Layer *layer, GContext *ctx) {
-  graphics_context_set_fill_color(ctx, BACKGROUND_COLOR);
-  graphics_fill_rect(ctx, layer_get_bounds(layer), 0, GCornerNone);
-
-  graphics_context_set_fill_color(ctx, BAR_CHART_MARKS);
+static uint8_t progress_column(uint8_t i) {
+  if (i > get_internal_data()->highest_entry || get_ignore(get_internal_data()->ignore, i)) {
+    return 0;
+  }
+  uint16_t height = get_point(get_internal_data()->points, i) / 500;
+  return (height > 8 ? 8 : height) + 1;
+}
 
+/*
+ * Scale marks every 12 pixels between x and x + width - 1
+ */
+static void draw_progress_scale(GContext *ctx, int16_t x, int16_t width) {
   graphics_context_set_stroke_color(ctx, BAR_CHART_MARKS);
-  
-  graphics_context_set_stroke_width(ctx, 2);
-
-  for (uint8_t i = 0; i <= 120; i += 12) {
+  for (int16_t i = (x + 11) / 12 * 12; i < x + width && i <= 120; i += 12) {
     graphics_draw_pixel(ctx, GPoint(i, 8));
     graphics_draw_pixel(ctx, GPoint(i, 7));
   }
+}
 
-  for (uint8_t i = 0; i <= get_internal_data()->highest_entry; i++) {
-    if (!get_internal_data()->ignore[i]) {
-      uint16_t height = get_internal_data()->points[i] / 500;
-      uint8_t i2 = i * 2;
-      #ifdef PBL_COLOR
-          graphics_context_set_stroke_color(ctx, bar_color(height));
-      #endif
-      graphics_draw_line(ctx, GPoint(i2, 8 - height), GPoint(i2, 8));
+/*
+ * One bar, as progress_column describes it
+ */
+static void draw_progress_bar(GContext *ctx, uint8_t i, uint8_t column) {
+  if (column == 0) {
+    return;
+  }
+  uint16_t height = column - 1;
+  uint8_t i2 = i * 2;
+  #ifdef PBL_COLOR
+    graphics_context_set_stroke_color(ctx, bar_color(height));
+  #else
+    graphics_context_set_stroke_color(ctx, BAR_CHART_MARKS);
+  #endif
+  graphics_draw_line(ctx, GPoint(i2, 8 - height), GPoint(i2, 8));
+  count_event(COUNT_PROGRESS_COLUMNS);
+}
+
+#ifdef CACHE_PROGRESS
+/*
+ * Copy the progress bar just drawn out of the frame buffer. Any trouble and the cache goes, so the
+ * next paint draws it all again.
+ */
+static void capture_progress(Layer *layer, GContext *ctx) {
+  GRect frame = layer_get_frame(layer);
+  GBitmap *frame_buffer = graphics_capture_frame_buffer(ctx);
+  if (frame_buffer == NULL) {
+    destroy_progress_cache();
+    return;
+  }
+  GRect screen = gbitmap_get_bounds(frame_buffer);
+  bool whole = frame.origin.y >= 0 && frame.origin.y + frame.size.h <= screen.size.h;
+  if (whole && progress_cache == NULL) {
+    progress_cache = gbitmap_create_blank(frame.size, GBitmapFormat8Bit);
+    whole = progress_cache != NULL;
+  }
+  for (int16_t y = 0; whole && y < frame.size.h; y++) {
+    GBitmapDataRowInfo row = gbitmap_get_data_row_info(frame_buffer, frame.origin.y + y);
+    whole = frame.origin.x >= row.min_x && frame.origin.x + frame.size.w - 1 <= row.max_x;
+    if (whole) {
+      memcpy(gbitmap_get_data(progress_cache) + y * gbitmap_get_bytes_per_row(progress_cache), row.data + frame.origin.x, frame.size.w);
     }
   }
+  graphics_release_frame_buffer(ctx, frame_buffer);
+  if (!whole) {
+    destroy_progress_cache();
+  }
 }
 
+/*
+ * Let the cache go (it comes back on the next paint)
+ */
+EXTFN void destroy_progress_cache() {
+  if (progress_cache != NULL) {
+    gbitmap_destroy(progress_cache);
+    progress_cache = NULL;
+  }
+}
+
+/*
+ * Put back the progress bar as last drawn and repaint only the columns that have changed since.
+ * A bar is two pixels wide on a two pixel pitch, so clearing a column takes a pixel either side -
+ * the scale under it and the neighbours either side go back on top, in the same order as a full
+ * paint. Returns whether anything was repainted.
+ */
+static bool draw_progress_changes(Layer *layer, GContext *ctx) {
+  graphics_context_set_compositing_mode(ctx, GCompOpAssign);
+  graphics_draw_bitmap_in_rect(ctx, progress_cache, layer_get_bounds(layer));
+
+  bool changed = false;
+  for (uint8_t i = 0; i < LIMIT; i++) {
+    uint8_t column = progress_column(i);
+    if (column == progress_drawn[i]) {
+      continue;
+    }
+    progress_drawn[i] = column;
+    changed = true;
+    int16_t x = i * 2 - 1;
+    graphics_context_set_fill_color(ctx, BACKGROUND_COLOR);
+    graphics_fill_rect(ctx, GRect(x, 0, 3, 9), 0, GCornerNone);
+    draw_progress_scale(ctx, x, 3);
+    for (int16_t j = i - 1; j <= i + 1; j++) {
+      if (j >= 0 && j < LIMIT) {
+        draw_progress_bar(ctx, j, progress_drawn[j]);
+      }
+    }
+  }
+  return changed;
+}
+#endif
+
+/*
+ * Progress line. Where there is a cache only the columns that changed are drawn.
+ */
+EXTFN void progress_layer_update_callback(Layer *layer, GContext *ctx) {
+  count_event(COUNT_DRAW_PROGRESS);
 
+  graphics_context_set_stroke_width(ctx, 2);
+
+  #ifdef CACHE_PROGRESS
+    // Antialiased edges would blend again each time a neighbour is repainted
+    graphics_context_set_antialiased(ctx, false);
+    if (progress_cache != NULL) {
+      if (draw_progress_changes(layer, ctx)) {
+        capture_progress(layer, ctx);
+      }
+      return;
+    }
+  #endif
+
+  graphics_context_set_fill_color(ctx, BACKGROUND_COLOR);
+  graphics_fill_rect(ctx, layer_get_bounds(layer), 0, GCornerNone);
+
+  draw_progress_scale(ctx, 0, 121);
+
+  for (uint8_t i = 0; i < LIMIT; i++) {
+    uint8_t column = progress_column(i);
+    draw_progress_bar(ctx, i, column);
+    #ifdef CACHE_PROGRESS
+      progress_drawn[i] = column;
+    #endif
+  }
+
+  #ifdef CACHE_PROGRESS
+    capture_progress(layer, ctx);
+  #endif
+}
 
 /*
  * Process clockface
  */
 static void handle_minute_tick(struct tm *tick_time, TimeUnits units_changed) {
 
+  redraw_hold();
+
   #ifndef TESTING_MEMORY_LEAK
     // Only update the date if the day has changed
     if (tick_time->tm_mday != previous_mday) {
@@ -439,6 +582,8 @@ static void handle_minute_tick(struct tm *tick_time, TimeUnits units_changed) {
   if (last_movement >= CLOCK_UPDATE_THRESHOLD || (tick_time->tm_min % 5 == 0)) {
     update_clock();
   }
+
+  redraw_flush();
 }
 
 /*
@@ -455,14 +600,14 @@ static void bluetooth_state_handler(bool connected) {
  */
 EXTFN void set_progress() {
   if (!get_config_data()->analogue)
-    layer_mark_dirty(ui.progress_layer);
+    redraw_request(REDRAW_PROGRESS);
 }
 
 /*
  * Set the power nap text for the display
  */
 EXTFN void analogue_powernap_text(char *text) {
-  strncpy(powernap_text, text, sizeof(powernap_text));
+  strncpy(powernap_text, text, sizeof(powernap_text) - 1);
   text_layer_set_text(ui.powernap_layer, powernap_text);
 }
 
@@ -479,8 +624,12 @@ EXTFN void show_alarm_visuals(bool value) {
  * Common stuff we always do at the end of setup
  */
 EXTFN void morpheuz_load_standard_postamble() {
+  redraw_register(REDRAW_ICON_BAR, ui.icon_bar);
+  redraw_register(REDRAW_PROGRESS, ui.progress_layer);
+
   read_internal_data();
   read_config_data();
+  counters_read();
   
   // Start clock
   tick_timer_service_subscribe(MINUTE_UNIT, handle_minute_tick);
@@ -41,7 +41,7 @@ VERSION_EXTERNAL;
 // Private
 static BitmapLayerComp round_background;
 static Layer *analogue_time_layer;
-static int current_hour, current_minutes; 
+static GPoint hour_position, minute_position;
 static char version_txt[5];
 
 // Shared with rootui, rectui, roundui, primary_window with main and notice_font with noticewindows
@@ -71,16 +71,6 @@ EXTFN void analogue_visible(bool visible, bool call_post_init) {
 EXTFN void analogue_set_smart_times() {
 }
 
-/*
- * Process analogue clock tick
- */
-EXTFN void analogue_minute_tick() {
-  time_t now = time(NULL);
-  struct tm *t = localtime(&now);
-  current_hour = t->tm_hour;
-  current_minutes = t->tm_min;
-  layer_mark_dirty(analogue_time_layer);
-}
 
 /*
  * Loading of screen complete
@@ -116,24 +106,33 @@ static int32_t get_angle_for_minute(int minute) {
   return (minute * 360) / 60;
 }
 
-static void layer_update_proc(Layer *layer, GContext *ctx) {
-  GRect bounds = layer_get_bounds(layer);
-  GRect frame = grect_inset(bounds, GEdgeInsets(11));
+/*
+ * Process analogue clock tick - the blobbies only move once a minute, so work out where here
+ * rather than on every redraw
+ */
+EXTFN void analogue_minute_tick() {
+  time_t now = time(NULL);
+  struct tm *t = localtime(&now);
+  GRect frame = grect_inset(layer_get_bounds(analogue_time_layer), GEdgeInsets(11));
 
   // 12 hours only, with a minimum size
-  current_hour -= (current_hour > 12) ? 12 : 0;
-  
+  int current_hour = t->tm_hour - ((t->tm_hour > 12) ? 12 : 0);
+
+  hour_position = gpoint_from_polar(frame, GOvalScaleModeFitCircle, DEG_TO_TRIGANGLE(get_angle_for_hour(current_hour, t->tm_min)));
+  minute_position = gpoint_from_polar(frame, GOvalScaleModeFitCircle, DEG_TO_TRIGANGLE(get_angle_for_minute(t->tm_min)));
+  redraw_request(REDRAW_HANDS);
+}
+
+static void layer_update_proc(Layer *layer, GContext *ctx) {
+  count_event(COUNT_DRAW_ROUND_TIME);
+
   // Hour blobby
-  int hour_angle = get_angle_for_hour(current_hour, current_minutes);
-  GPoint posh = gpoint_from_polar(frame, GOvalScaleModeFitCircle, DEG_TO_TRIGANGLE(hour_angle));
   graphics_context_set_fill_color(ctx, HOUR_COLOR);
-  graphics_fill_circle(ctx, posh, HOUR_RADIUS);
+  graphics_fill_circle(ctx, hour_position, HOUR_RADIUS);
   
   // Minute blobby
-  int minute_angle = get_angle_for_minute(current_minutes);
-  GPoint posm = gpoint_from_polar(frame, GOvalScaleModeFitCircle, DEG_TO_TRIGANGLE(minute_angle));
   graphics_context_set_fill_color(ctx, MINUTE_COLOR);
-  graphics_fill_circle(ctx, posm, MINUTE_RADIUS);
+  graphics_fill_circle(ctx, minute_position, MINUTE_RADIUS);
 
 }
 
@@ -172,7 +171,7 @@ EXTFN void morpheuz_load(Window *window) {
   ui.text_time_layer = macro_text_layer_create(GRect(0, 34, width, 44), window_layer, GColorWhite, GColorClear, ui.time_font, GTextAlignmentCenter);
   layer_set_hidden(text_layer_get_layer_jf(ui.text_time_layer), true);
   
-  init_icon_cache();
+  icon_atlas_load();
   ui.icon_bar = macro_layer_create(GRect(47, ICON_TOPS, ICON_BAR_WIDTH, 12), window_layer, &icon_bar_update_callback);
   layer_set_hidden(ui.icon_bar, true);
 
@@ -181,6 +180,7 @@ EXTFN void morpheuz_load(Window *window) {
   
   analogue_time_layer = macro_layer_create(bounds, window_layer, layer_update_proc);
   layer_set_hidden(analogue_time_layer, true);
+  redraw_register(REDRAW_HANDS, analogue_time_layer);
 
   macro_bitmap_layer_create(&ui.alarm_button_top, GRect(138, 39, 30, 30), window_layer, RESOURCE_ID_BUTTON_ALARM_TOP, false);
   macro_bitmap_layer_create(&ui.alarm_button_button, GRect(138, 108, 30, 30), window_layer, RESOURCE_ID_BUTTON_ALARM_BOTTOM, false);
@@ -202,14 +202,20 @@ EXTFN void morpheuz_unload(Window *window) {
   tick_timer_service_unsubscribe();
   battery_state_service_unsubscribe();
   bluetooth_connection_service_unsubscribe();
-  accel_data_service_unsubscribe();
+  close_accel();
 
+  raw_capture_set(false);
+  bulk_finish();
   save_config_data(NULL);
   save_internal_data();
+  counters_save();
+  trace_save();
 
+  redraw_clear();
   layer_destroy(ui.progress_layer);
   layer_destroy(ui.icon_bar);
-  destroy_icon_cache();
+  icon_atlas_unload();
+  destroy_progress_cache();
   
   layer_destroy(analogue_time_layer);
 
@@ -0,0 +1,173 @@
+/*
+ * Morpheuz Sleep Monitor
+ *
+ * Copyright (c) 2013-2016 James Fowler
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include "pebble.h"
+#include "morpheuz.h"
+
+#ifdef ENABLE_TRACE
+
+/*
+ * A ring of the last TRACE_EVENTS things that happened, for working out afterwards why a night went
+ * wrong. Logging an event is a copy into memory. The ring goes to flash on the way out, and with
+ * the internal data if anything out of the ordinary has been logged or TRACE_SAVE_SECONDS have
+ * gone by - the header (next sequence number and how many are held) under PERSIST_TRACE_KEY and
+ * only the pages that have changed under the TRACE_PAGES keys after it - so it survives a restart.
+ */
+typedef struct {
+  uint16_t next;
+  uint16_t held;
+} TraceHeader;
+
+static TraceHeader header;
+static TraceEvent events[TRACE_EVENTS];
+static uint16_t dirty;
+static bool notable;
+static time_t saved;
+
+#define DIRTY_HEADER (1 << TRACE_PAGES)
+
+/*
+ * What happens all night long - not worth a flash write on its own
+ */
+static bool routine(TraceType type, uint8_t detail) {
+  return type == TRACE_SEND || type == TRACE_ACK || type == TRACE_PERSIST || type == TRACE_DOZE
+         || type == TRACE_THRESHOLD || (type == TRACE_SMART && detail == SMART_BELOW);
+}
+
+/*
+ * Log an event
+ */
+EXTFN void trace_event(TraceType type, uint8_t detail, uint16_t value) {
+  uint8_t pos = header.next % TRACE_EVENTS;
+  events[pos].time = time(NULL);
+  events[pos].type = type;
+  events[pos].detail = detail;
+  events[pos].value = value;
+  header.next++;
+  if (header.held < TRACE_EVENTS) {
+    header.held++;
+  }
+  dirty |= DIRTY_HEADER | (1 << (pos / TRACE_PAGE_EVENTS));
+  notable = notable || !routine(type, detail);
+}
+
+/*
+ * A message got to the phone - mark the send if nothing has happened since, saves an event
+ */
+EXTFN void trace_acked() {
+  TraceEvent *last = &events[(uint16_t) (header.next - 1) % TRACE_EVENTS];
+  if (header.held > 0 && last->type == TRACE_SEND && !(last->detail & TRACE_ACKED)) {
+    last->detail |= TRACE_ACKED;
+    dirty |= 1 << (((uint16_t) (header.next - 1) % TRACE_EVENTS) / TRACE_PAGE_EVENTS);
+  } else {
+    trace_event(TRACE_ACK, 0, 0);
+  }
+}
+
+/*
+ * The result of a persist_write_data
+ */
+EXTFN void trace_persist(uint32_t key, int written) {
+  if (written < 0) {
+    trace_event(TRACE_PERSIST_FAIL, 0, key);
+  } else {
+    trace_event(TRACE_PERSIST, written > UINT8_MAX ? UINT8_MAX : written, key);
+  }
+}
+
+/*
+ * Pick up the ring from before a restart (before anything is logged)
+ */
+EXTFN void trace_read() {
+  if (persist_read_data(PERSIST_TRACE_KEY, &header, sizeof(header)) != sizeof(header) || header.held > TRACE_EVENTS) {
+    memset(&header, 0, sizeof(header));
+  }
+  for (uint8_t page = 0; page < TRACE_PAGES; page++) {
+    TraceEvent *from = events + page * TRACE_PAGE_EVENTS;
+    if (persist_read_data(PERSIST_TRACE_KEY + 1 + page, from, TRACE_PAGE_EVENTS * sizeof(TraceEvent)) != TRACE_PAGE_EVENTS * sizeof(TraceEvent)) {
+      memset(from, 0, TRACE_PAGE_EVENTS * sizeof(TraceEvent));
+    }
+  }
+  dirty = 0;
+  saved = time(NULL);
+}
+
+/*
+ * Write what has changed (not traced, or it would never be clean)
+ */
+EXTFN void trace_save() {
+  for (uint8_t page = 0; page < TRACE_PAGES; page++) {
+    if (dirty & (1 << page)) {
+      int written = persist_write_data(PERSIST_TRACE_KEY + 1 + page, events + page * TRACE_PAGE_EVENTS, TRACE_PAGE_EVENTS * sizeof(TraceEvent));
+      if (written != TRACE_PAGE_EVENTS * sizeof(TraceEvent)) {
+        LOG_ERROR("trace_save error (%d)", written);
+        return;
+      }
+      count_add(COUNT_PERSIST_BYTES, written);
+    }
+  }
+  if (dirty & DIRTY_HEADER) {
+    int written = persist_write_data(PERSIST_TRACE_KEY, &header, sizeof(header));
+    if (written != sizeof(header)) {
+      LOG_ERROR("trace_save header error (%d)", written);
+      return;
+    }
+    count_add(COUNT_PERSIST_BYTES, written);
+  }
+  dirty = 0;
+  notable = false;
+  saved = time(NULL);
+}
+
+/*
+ * Save with the internal data, if it's worth it
+ */
+EXTFN void trace_checkpoint() {
+  if (notable || time(NULL) - saved >= TRACE_SAVE_SECONDS) {
+    trace_save();
+  }
+}
+
+/*
+ * Sequence number of the oldest event held and of the next to be logged
+ */
+EXTFN uint16_t trace_oldest() {
+  return header.next - header.held;
+}
+
+EXTFN uint16_t trace_next() {
+  return header.next;
+}
+
+/*
+ * Copy up to max events from sequence number from onwards, oldest first - returns how many
+ */
+EXTFN uint8_t trace_copy(uint16_t from, TraceEvent *to, uint8_t max) {
+  uint8_t count = 0;
+  for (uint16_t seq = from; seq != header.next && count < max; seq++, count++) {
+    to[count] = events[seq % TRACE_EVENTS];
+  }
+  return count;
+}
+
+#endif
@@ -110,6 +110,72 @@ EXTFN int32_t dirty_checksum(void *data, uint8_t data_size) {
   return join_value(xor, sum);
 }
 
+/*
+ * Read a point from a packed array - each pair of 12 bit points shares three bytes
+ */
+EXTFN uint16_t get_point(const uint8_t *points, uint8_t i) {
+  const uint8_t *p = points + (i >> 1) * 3;
+  if (i & 1) {
+    return (p[1] >> 4) | (p[2] << 4);
+  }
+  return p[0] | ((p[1] & 0x0F) << 8);
+}
+
+/*
+ * Write a point into a packed array, capped at POINT_MAX
+ */
+EXTFN void set_point(uint8_t *points, uint8_t i, uint16_t value) {
+  uint8_t *p = points + (i >> 1) * 3;
+  if (value > POINT_MAX) {
+    value = POINT_MAX;
+  }
+  if (i & 1) {
+    p[1] = (p[1] & 0x0F) | ((value & 0x0F) << 4);
+    p[2] = value >> 4;
+  } else {
+    p[0] = value & 0xFF;
+    p[1] = (p[1] & 0xF0) | (value >> 8);
+  }
+}
+
+/*
+ * Read an ignore flag from a bitset
+ */
+EXTFN bool get_ignore(const uint8_t *ignore, uint8_t i) {
+  return (ignore[i >> 3] >> (i & 7)) & 1;
+}
+
+/*
+ * Write an ignore flag into a bitset
+ */
+EXTFN void set_ignore(uint8_t *ignore, uint8_t i, bool value) {
+  if (value) {
+    ignore[i >> 3] |= 1 << (i & 7);
+  } else {
+    ignore[i >> 3] &= ~(1 << (i & 7));
+  }
+}
+
+/*
+ * Integer square root
+ */
+EXTFN uint16_t isqrt(uint32_t value) {
+  uint32_t root = 0;
+  uint32_t bit = 1UL << 30;
+  while (bit > value)
+    bit >>= 2;
+  while (bit != 0) {
+    if (value >= root + bit) {
+      value -= root + bit;
+      root = (root >> 1) + bit;
+    } else {
+      root >>= 1;
+    }
+    bit >>= 2;
+  }
+  return root;
+}
+
 /*
  * Display the times using the settings the user prefers
  */
@@ -29,6 +29,7 @@
   
 AppTimer *auto_shutdown_timer = NULL; 
 static time_t requested_exit;
+static bool launched_for_transmit = false;
 
 /*
  * Build a wakeup entry
@@ -43,6 +44,10 @@ static void build_wakeup_entry(time_t timestamp, int32_t cookie) {
       timestamp += ONE_MINUTE;
     count++;
   }
+#ifdef ENABLE_TRACE
+  uint32_t minutes = timestamp > time(NULL) ? (timestamp - time(NULL)) / ONE_MINUTE : 0;
+  trace_event(TRACE_WAKEUP, cookie | (id < 0 ? TRACE_REJECTED : 0), minutes > UINT16_MAX ? UINT16_MAX : minutes);
+#endif
   if (id < 0) {
     LOG_ERROR("Wakeup for cookie=%ld rejected with %ld", cookie, id);
   } 
@@ -91,7 +96,10 @@ EXTFN void set_next_wakeup() {
 static void wakeup_handler(WakeupId wakeup_id, int32_t cookie) {
   if (cookie == WAKEUP_AUTO_RESTART) {
     reset_sleep_period();
+  } else if (cookie == WAKEUP_FOR_TRANSMIT) {
+    request_sync();
   }
+  count_event(COUNT_WAKEUPS);
 }
 
 /**
@@ -106,15 +114,21 @@ static void close_morpheuz_timer(void *data) {
  */
 EXTFN void wakeup_init() {
   WakeupId wakeup_id;
-  int32_t cookie;
+  int32_t cookie = 0;
   wakeup_service_subscribe(wakeup_handler);
   if (launch_reason() == APP_LAUNCH_WAKEUP) {
     wakeup_get_launch_event(&wakeup_id, &cookie);
+  }
+  trace_event(TRACE_START, launch_reason(), cookie);
+  if (launch_reason() == APP_LAUNCH_WAKEUP) {
     if (cookie == WAKEUP_AUTO_RESTART) {
       reset_sleep_period();
     } else if (cookie == WAKEUP_FOR_TRANSMIT) {
+      launched_for_transmit = true;
+      request_sync();
       auto_shutdown_timer = app_timer_register(get_internal_data()->transmit_sent ? TEN_SECONDS_MS : FIVE_MINUTES_MS, close_morpheuz_timer, NULL);
     }
+    count_event(COUNT_WAKEUPS);
   } else if (launch_reason() == APP_LAUNCH_TIMELINE_ACTION) {
     switch (launch_get_args()) {
       case TIMELINE_LAUNCH_USE:
@@ -157,9 +171,17 @@ EXTFN void lazarus() {
   // We also have a config option on this to ensure it can be disabled if undesirable
   if (get_config_data()->lazarus && is_monitoring_sleep() && (requested_exit + FIVE_SECONDS <= time(NULL))) {
     time_t timestamp = time(NULL) + FIVE_MINUTES;
+    trace_event(TRACE_EXIT, EXIT_LAZARUS, 0);
     build_wakeup_entry(timestamp, WAKEUP_LAZARUS);
     LOG_ERROR("Abnormal exit, reboot in 5 mins");
+  } else if (sync_outstanding() && !launched_for_transmit) {
+    // A deferred sync that hasn't happened yet is done straight after, just the once
+    trace_event(TRACE_EXIT, EXIT_FOR_SYNC, 0);
+    build_wakeup_entry(time(NULL) + ONE_MINUTE, WAKEUP_FOR_TRANSMIT);
+    LOG_ERROR("Requested exit, back to sync in a minute");
   } else {
+    trace_event(TRACE_EXIT, EXIT_REQUESTED, 0);
     LOG_ERROR("Requested exit");
   }
+  trace_save();
 }
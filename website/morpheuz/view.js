@@ -477,6 +477,9 @@ $("document").ready(function() {
   var exptime = getParameterByName("exptime");
   var usage = getParameterByName("usage");
   var lazarus = getParameterByName("lazarus");
+  var quickAlarm = getParameterByName("quickalarm");
+  var rawCapture = getParameterByName("rawcapture");
+  var deferSync = getParameterByName("defersync");
   var hueip = getParameterByName("hueip");
   var hueusername = getParameterByName("hueuser");
   var hueid = getParameterByName("hueid");
@@ -524,6 +527,9 @@ $("document").ready(function() {
   $("#hueuser").val(hueusername);
   $("#hueid").val(hueid);
   $("#lazarus").prop("checked", lazarus !== "N");
+  $("#quickalarm").prop("checked", quickAlarm === "Y");
+  $("#rawcapture").prop("checked", rawCapture === "Y");
+  $("#defersync").prop("checked", deferSync === "Y");
   $("#ifkey").val(ifkey);
   $("#ifserver").val(ifserver);
   $("#ifstat").text(ifstat);
@@ -595,6 +601,27 @@ $("document").ready(function() {
     $("#lilazarus").addClass("blue");
   }
 
+  // Set the quick alarm bullet to indicate active or not
+  if (quickAlarm === "Y") {
+    $("#liquickalarm").addClass("green");
+  } else {
+    $("#liquickalarm").addClass("blue");
+  }
+
+  // Set the raw capture bullet to indicate active or not
+  if (rawCapture === "Y") {
+    $("#lirawcapture").addClass("green");
+  } else {
+    $("#lirawcapture").addClass("blue");
+  }
+
+  // Set the deferred sync bullet to indicate active or not
+  if (deferSync === "Y") {
+    $("#lidefersync").addClass("green");
+  } else {
+    $("#lidefersync").addClass("blue");
+  }
+
   // Set the status bullets for pushover
   if (ifstat === "OK") {
     $("#liif").addClass("green");
@@ -838,7 +865,11 @@ $("document").ready(function() {
       hueuser : safeTrim($("#hueuser").val()),
       hueid : safeTrim($("#hueid").val()),
       lazarus : $("#lazarus").is(':checked') ? "Y" : "N",
+      quickalarm : $("#quickalarm").is(':checked') ? "Y" : "N",
+      rawcapture : $("#rawcapture").is(':checked') ? "Y" : "N",
+      defersync : $("#defersync").is(':checked') ? "Y" : "N",
       testsettings : $("#testsettings").is(':checked') ? "Y" : "N",
+      tracedump : $("#tracedump").is(':checked') ? "Y" : "N",
       ifkey : safeTrim($("#ifkey").val()),
       ifserver : safeTrim($("#ifserver").val()),
       age : safeTrim($("#age").val()),